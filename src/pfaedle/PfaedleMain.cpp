@@ -15,6 +15,7 @@
 #include <vector>
 #include "ad/cppgtfs/Parser.h"
 #include "ad/cppgtfs/Writer.h"
+#include "pfaedle/_config.h"
 #include "pfaedle/config/ConfigReader.h"
 #include "pfaedle/config/MotConfig.h"
 #include "pfaedle/config/MotConfigReader.h"
@@ -22,10 +23,16 @@
 #include "pfaedle/gtfs/Feed.h"
 #include "pfaedle/gtfs/Writer.h"
 #include "pfaedle/netgraph/Graph.h"
+#include "pfaedle/osm/GraphCache.h"
 #include "pfaedle/osm/OsmIdSet.h"
+#include "pfaedle/osm/PbfReader.h"
+#include "pfaedle/router/Manifest.h"
 #include "pfaedle/router/ShapeBuilder.h"
 #include "pfaedle/trgraph/Graph.h"
 #include "pfaedle/trgraph/StatGroup.h"
+#include "util/Counter.h"
+#include "util/Profiler.h"
+#include "util/String.h"
 #include "util/geo/output/GeoGraphJsonOutput.h"
 #include "util/geo/output/GeoJsonOutput.h"
 #include "util/json/Writer.h"
@@ -45,9 +52,11 @@
 using pfaedle::router::MOTs;
 using pfaedle::osm::BBoxIdx;
 using pfaedle::osm::OsmBuilder;
+using pfaedle::osm::OsmIdSet;
 using pfaedle::config::MotConfig;
 using pfaedle::config::Config;
 using pfaedle::router::ShapeBuilder;
+using pfaedle::router::Manifest;
 using configparser::ParseFileExc;
 using pfaedle::config::MotConfigReader;
 using pfaedle::config::ConfigReader;
@@ -68,6 +77,14 @@ enum class RetCode {
 
 std::string getFileNameMotStr(const MOTs& mots);
 std::vector<std::string> getCfgPaths(const Config& cfg);
+void buildGraphs(const Config& cfg, const std::vector<const MotConfig*>& mCfgs,
+                 const BBoxIdx& box,
+                 const std::vector<pfaedle::trgraph::Graph*>& gs,
+                 const std::vector<pfaedle::router::FeedStops*>& fss,
+                 const std::vector<pfaedle::osm::Restrictor*>& ress);
+void addPhaseMs(const std::string& phase, double ms);
+void writeStats(const Config& cfg);
+void writeProfile(const Config& cfg);
 
 // _____________________________________________________________________________
 int main(int argc, char** argv) {
@@ -83,6 +100,11 @@ int main(int argc, char** argv) {
   ConfigReader cr;
   cr.read(&cfg, argc, argv);
 
+  if (cfg.osmIdSet == "mem")
+    OsmIdSet::DEFAULT_BACKEND = pfaedle::osm::OSMIDSET_MEM;
+  else if (cfg.osmIdSet == "disk")
+    OsmIdSet::DEFAULT_BACKEND = pfaedle::osm::OSMIDSET_DISK;
+
   std::vector<pfaedle::gtfs::Feed> gtfs(cfg.feedPaths.size());
   // feed containing the shapes in memory for evaluation
   ad::cppgtfs::gtfs::Feed evalFeed;
@@ -112,6 +134,7 @@ int main(int argc, char** argv) {
     if (cfg.inPlace) cfg.outputPath = cfg.feedPaths[0];
     if (!cfg.writeOverpass)
       LOG(INFO) << "Reading " << cfg.feedPaths[0] << " ...";
+    util::Profiler::Scope readGtfs("read_gtfs");
     try {
       ad::cppgtfs::Parser p;
       p.parse(&gtfs[0], cfg.feedPaths[0]);
@@ -124,6 +147,7 @@ int main(int argc, char** argv) {
       std::cerr << ex.what() << std::endl;
       exit(static_cast<int>(RetCode::GTFS_PARSE_ERR));
     }
+    addPhaseMs("read_gtfs", readGtfs.stop());
     if (!cfg.writeOverpass) LOG(INFO) << "Done.";
   } else if (cfg.writeOsm.size() || cfg.writeOverpass) {
     for (size_t i = 0; i < cfg.feedPaths.size(); i++) {
@@ -182,6 +206,10 @@ int main(int argc, char** argv) {
       LOG(ERROR) << "Could not parse OSM data, reason was:";
       std::cerr << ex.what() << std::endl;
       exit(static_cast<int>(RetCode::OSM_PARSE_ERR));
+    } catch (const pfaedle::osm::PbfParseExc& ex) {
+      LOG(ERROR) << "Could not parse OSM data, reason was:";
+      std::cerr << ex.what() << std::endl;
+      exit(static_cast<int>(RetCode::OSM_PARSE_ERR));
     }
     exit(static_cast<int>(RetCode::SUCCESS));
   } else if (cfg.writeOverpass) {
@@ -205,17 +233,63 @@ int main(int argc, char** argv) {
     exit(static_cast<int>(RetCode::NO_INPUT_FEED));
   }
 
+  // fingerprints and shapes of the previous run, for incremental reshaping
+  Manifest prevManifest, nextManifest;
+  ad::cppgtfs::gtfs::Feed prevFeed;
+  bool incremental = false;
+  if (cfg.prevOutputPath.size() && cfg.manifestPath.empty()) {
+    LOG(WARN) << "--prev-output given without --manifest, ignoring it";
+  } else if (cfg.prevOutputPath.size()) {
+    if (prevManifest.read(cfg.manifestPath)) {
+      LOG(INFO) << "Reading shapes of previous run from "
+                << cfg.prevOutputPath << " ...";
+      try {
+        ad::cppgtfs::Parser p;
+        p.parseShapes(&prevFeed, cfg.prevOutputPath);
+        incremental = true;
+        LOG(INFO) << "Done, " << prevManifest.size()
+                  << " clusters in manifest.";
+      } catch (const ad::cppgtfs::ParserException& ex) {
+        LOG(WARN) << "Could not parse previous output feed, reshaping all "
+                     "trips. Reason was: "
+                  << ex.what();
+      }
+    } else {
+      LOG(WARN) << "Could not read manifest " << cfg.manifestPath
+                << ", reshaping all trips";
+    }
+  }
+
   std::vector<double> dfBins;
   auto dfBinStrings = util::split(std::string(cfg.evalDfBins), ',');
   for (auto st : dfBinStrings) dfBins.push_back(atof(st.c_str()));
-  Collector ecoll(cfg.evalPath, dfBins);
+  Collector ecoll(cfg.evalPath, dfBins, cfg.evalTrips);
 
+  std::vector<const MotConfig*> motCfgs;
+  std::vector<MOTs> usedMotsLst;
   for (const auto& motCfg : motCfgReader.getConfigs()) {
-    std::string filePost;
     auto usedMots = pfaedle::router::motISect(motCfg.mots, cmdCfgMots);
     if (!usedMots.size()) continue;
     if (singleTrip && !usedMots.count(singleTrip->getRoute()->getType()))
       continue;
+    motCfgs.push_back(&motCfg);
+    usedMotsLst.push_back(usedMots);
+  }
+
+  std::vector<pfaedle::trgraph::Graph*> graphs(motCfgs.size(), 0);
+  std::vector<pfaedle::router::FeedStops*> fStopsLst(motCfgs.size(), 0);
+  std::vector<pfaedle::osm::Restrictor*> restrs(motCfgs.size(), 0);
+
+  pfaedle::osm::BBoxIdx box(BOX_PADDING);
+  if (motCfgs.size()) {
+    ShapeBuilder::getGtfsBox(&gtfs[0], cmdCfgMots, cfg.shapeTripId,
+                             cfg.dropShapes, &box);
+  }
+
+  for (size_t i = 0; i < motCfgs.size(); i++) {
+    const MotConfig& motCfg = *motCfgs[i];
+    const MOTs& usedMots = usedMotsLst[i];
+    std::string filePost;
     if (motCfgReader.getConfigs().size() > 1)
       filePost = getFileNameMotStr(usedMots);
 
@@ -223,20 +297,35 @@ int main(int argc, char** argv) {
     LOG(INFO) << "Calculating shapes for mots " << motStr;
 
     try {
-      pfaedle::router::FeedStops fStops =
-          pfaedle::router::writeMotStops(&gtfs[0], usedMots, cfg.shapeTripId);
-
-      pfaedle::osm::Restrictor restr;
-      pfaedle::trgraph::Graph graph;
-      pfaedle::osm::OsmBuilder osmBuilder;
+      if (!graphs[i]) {
+        // build the graph for this config, or for all remaining configs at
+        // once in a single pass over the OSM file
+        size_t end = cfg.singleOsmPass ? motCfgs.size() : i + 1;
+        for (size_t j = i; j < end; j++) {
+          graphs[j] = new pfaedle::trgraph::Graph();
+          restrs[j] = new pfaedle::osm::Restrictor();
+          fStopsLst[j] = new pfaedle::router::FeedStops(
+              pfaedle::router::writeMotStops(&gtfs[0], usedMotsLst[j],
+                                             cfg.shapeTripId));
+        }
 
-      pfaedle::osm::BBoxIdx box(BOX_PADDING);
-      ShapeBuilder::getGtfsBox(&gtfs[0], cmdCfgMots, cfg.shapeTripId,
-                               cfg.dropShapes, &box);
+        util::Profiler::Scope buildGraph("build_graph");
+        buildGraphs(cfg,
+                    std::vector<const MotConfig*>(motCfgs.begin() + i,
+                                                  motCfgs.begin() + end),
+                    box,
+                    std::vector<pfaedle::trgraph::Graph*>(
+                        graphs.begin() + i, graphs.begin() + end),
+                    std::vector<pfaedle::router::FeedStops*>(
+                        fStopsLst.begin() + i, fStopsLst.begin() + end),
+                    std::vector<pfaedle::osm::Restrictor*>(
+                        restrs.begin() + i, restrs.begin() + end));
+        addPhaseMs("build_graph", buildGraph.stop());
+      }
 
-      if (fStops.size())
-        osmBuilder.read(cfg.osmPath, motCfg.osmBuildOpts, &graph, box,
-                        cfg.gridSize, &fStops, &restr);
+      pfaedle::router::FeedStops& fStops = *fStopsLst[i];
+      pfaedle::osm::Restrictor& restr = *restrs[i];
+      pfaedle::trgraph::Graph& graph = *graphs[i];
 
       // TODO(patrick): move this somewhere else
       for (auto& feedStop : fStops) {
@@ -249,8 +338,15 @@ int main(int argc, char** argv) {
         }
       }
 
+      util::Profiler::Scope prepare("prepare");
       ShapeBuilder shapeBuilder(&gtfs[0], &evalFeed, cmdCfgMots, motCfg, &ecoll,
                                 &graph, &fStops, &restr, cfg);
+      if (cfg.manifestPath.size()) {
+        shapeBuilder.setIncremental(incremental ? &prevManifest : 0,
+                                    incremental ? &prevFeed : 0,
+                                    &nextManifest);
+      }
+      addPhaseMs("prepare", prepare.stop());
 
       if (cfg.writeGraph) {
         LOG(INFO) << "Outputting graph.json...";
@@ -275,11 +371,15 @@ int main(int argc, char** argv) {
         o.flush();
         pstr.close();
 
+        writeStats(cfg);
+        writeProfile(cfg);
         exit(static_cast<int>(RetCode::SUCCESS));
       }
 
       pfaedle::netgraph::Graph ng;
+      util::Profiler::Scope shape("shape");
       shapeBuilder.shape(&ng);
+      addPhaseMs("shape", shape.stop());
 
       if (cfg.buildTransitGraph) {
         util::geo::output::GeoGraphJsonOutput out;
@@ -293,17 +393,38 @@ int main(int argc, char** argv) {
       LOG(ERROR) << "Could not parse OSM data, reason was:";
       std::cerr << ex.what() << std::endl;
       exit(static_cast<int>(RetCode::OSM_PARSE_ERR));
+    } catch (const pfaedle::osm::PbfParseExc& ex) {
+      LOG(ERROR) << "Could not parse OSM data, reason was:";
+      std::cerr << ex.what() << std::endl;
+      exit(static_cast<int>(RetCode::OSM_PARSE_ERR));
     }
+
+    delete graphs[i];
+    delete restrs[i];
+    delete fStopsLst[i];
   }
 
-  if (cfg.evaluate) ecoll.printStats(&std::cout);
+  if (cfg.evaluate) {
+    util::Profiler::Scope evalStats("eval_stats");
+    ecoll.finish();
+    ecoll.printStats(&std::cout);
+  }
 
   if (cfg.feedPaths.size()) {
     try {
       mkdir(cfg.outputPath.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
       LOG(INFO) << "Writing output GTFS to " << cfg.outputPath << " ...";
-      pfaedle::gtfs::Writer w;
+      util::Profiler::Scope writeGtfs("write_gtfs");
+      pfaedle::gtfs::Writer w(cfg.copyUnchanged);
       w.write(&gtfs[0], cfg.outputPath);
+      addPhaseMs("write_gtfs", writeGtfs.stop());
+
+      // only valid together with the feed just written
+      if (cfg.manifestPath.size()) {
+        LOG(INFO) << "Writing manifest of " << nextManifest.size()
+                  << " clusters to " << cfg.manifestPath << " ...";
+        nextManifest.write(cfg.manifestPath);
+      }
     } catch (const ad::cppgtfs::WriterException& ex) {
       LOG(ERROR) << "Could not write final GTFS feed, reason was:";
       std::cerr << ex.what() << std::endl;
@@ -311,9 +432,51 @@ int main(int argc, char** argv) {
     }
   }
 
+  writeStats(cfg);
+  writeProfile(cfg);
+
   return static_cast<int>(RetCode::SUCCESS);
 }
 
+// _____________________________________________________________________________
+void addPhaseMs(const std::string& phase, double ms) {
+  util::Counter::named("phase_ms", "Wall time spent per phase, in ms",
+                       "phase", phase) += static_cast<size_t>(ms);
+}
+
+// _____________________________________________________________________________
+void writeStats(const Config& cfg) {
+  LOG(INFO) << "Run counters:";
+  for (const auto& c : util::Counter::snapshot()) {
+    LOG(INFO) << "  " << c.first << " = " << c.second;
+  }
+
+  if (cfg.statsOut.empty()) return;
+
+  LOG(INFO) << "Writing run counters to " << cfg.statsOut << " ...";
+  std::ofstream fstr(cfg.statsOut);
+  if (cfg.statsFormat == "prometheus") {
+    util::Counter::writePrometheus(&fstr, "pfaedle_");
+  } else {
+    util::Counter::writeJson(&fstr);
+  }
+  fstr.close();
+}
+
+// _____________________________________________________________________________
+void writeProfile(const Config& cfg) {
+  if (cfg.profileOut.empty()) return;
+
+  LOG(INFO) << "Writing profile to " << cfg.profileOut << " ...";
+  std::ofstream fstr(cfg.profileOut);
+  util::Profiler::writeJson(
+      &fstr, {{"version", VERSION_FULL},
+              {"feed", util::implode(cfg.feedPaths, ",")},
+              {"osm", cfg.osmPath},
+              {"method", cfg.solveMethod}});
+  fstr.close();
+}
+
 // _____________________________________________________________________________
 std::string getFileNameMotStr(const MOTs& mots) {
   std::string motStr;
@@ -376,3 +539,65 @@ std::vector<std::string> getCfgPaths(const Config& cfg) {
 
   return ret;
 }
+
+// _____________________________________________________________________________
+void buildGraphs(const Config& cfg, const std::vector<const MotConfig*>& mCfgs,
+                 const BBoxIdx& box,
+                 const std::vector<pfaedle::trgraph::Graph*>& gs,
+                 const std::vector<pfaedle::router::FeedStops*>& fss,
+                 const std::vector<pfaedle::osm::Restrictor*>& ress) {
+  pfaedle::osm::GraphCache gCache(cfg.graphCachePath);
+
+  // configs for which the graph has to be read from the OSM file
+  std::vector<const pfaedle::osm::OsmReadOpts*> opts;
+  std::vector<pfaedle::trgraph::Graph*> readGs;
+  std::vector<pfaedle::router::FeedStops*> readFss;
+  std::vector<pfaedle::osm::Restrictor*> readRess;
+  std::vector<uint64_t> keys;
+
+  // the OSM file is hashed only once, on the first lookup
+  bool hashed = false;
+  uint64_t osmHash = 0;
+
+  for (size_t i = 0; i < mCfgs.size(); i++) {
+    if (!fss[i]->size()) continue;
+
+    uint64_t key = 0;
+    if (cfg.graphCachePath.size()) {
+      if (!hashed) {
+        osmHash = pfaedle::osm::GraphCache::hashOsm(cfg.osmPath);
+        hashed = true;
+      }
+      key = pfaedle::osm::GraphCache::getKey(
+          osmHash, mCfgs[i]->osmBuildOpts, box, cfg.gridSize, *fss[i]);
+
+      if (gCache.read(key, gs[i], fss[i], ress[i])) {
+        LOG(INFO) << "Read graph snapshot for " << cfg.osmPath << " from "
+                  << cfg.graphCachePath;
+        continue;
+      }
+    }
+
+    opts.push_back(&mCfgs[i]->osmBuildOpts);
+    readGs.push_back(gs[i]);
+    readFss.push_back(fss[i]);
+    readRess.push_back(ress[i]);
+    keys.push_back(key);
+  }
+
+  if (!opts.size()) return;
+
+  OsmBuilder osmBuilder;
+  osmBuilder.read(cfg.osmPath, opts, readGs, box, cfg.gridSize, readFss,
+                  readRess);
+
+  if (!cfg.graphCachePath.size()) return;
+
+  for (size_t i = 0; i < opts.size(); i++) {
+    try {
+      gCache.write(keys[i], *readGs[i], *readFss[i], *readRess[i]);
+    } catch (const std::runtime_error& ex) {
+      LOG(WARN) << ex.what();
+    }
+  }
+}
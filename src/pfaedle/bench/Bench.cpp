@@ -0,0 +1,478 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+// Benchmark harness for the router. Generates a synthetic transit graph
+// (grid, radial or corridor topology), draws random candidate routes on it
+// or replays a recorded workload, routes them with route(), routeGreedy()
+// and routeGreedy2() and reports hops/sec, iterations/hop and heap
+// allocations/hop. Workloads can be recorded to a file, which also stores
+// the graph parameters, to compare router changes reproducibly.
+
+#include <getopt.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/Landmarks.h"
+#include "pfaedle/router/Router.h"
+#include "pfaedle/trgraph/CsrGraph.h"
+#include "pfaedle/trgraph/Graph.h"
+#include "util/graph/Dijkstra.h"
+#include "util/graph/EDijkstra.h"
+
+using pfaedle::osm::Restrictor;
+using pfaedle::router::EdgeListHops;
+using pfaedle::router::HopMemo;
+using pfaedle::router::Landmarks;
+using pfaedle::router::NodeCand;
+using pfaedle::router::NodeCandGroup;
+using pfaedle::router::NodeCandRoute;
+using pfaedle::router::Router;
+using pfaedle::router::RoutingAttrs;
+using pfaedle::router::RoutingOpts;
+using pfaedle::trgraph::Component;
+using pfaedle::trgraph::CsrGraph;
+using pfaedle::trgraph::Edge;
+using pfaedle::trgraph::Graph;
+using pfaedle::trgraph::Node;
+using pfaedle::trgraph::NodePL;
+using pfaedle::trgraph::TransitEdgeLine;
+using util::graph::Dijkstra;
+using util::graph::EDijkstra;
+
+static std::atomic<size_t> ALLOCS(0);
+
+struct BenchOpts {
+  BenchOpts()
+      : topo("grid"),
+        size(100),
+        routes(200),
+        stops(12),
+        cands(3),
+        restrDensity(0),
+        landmarks(0),
+        hopMemo(0),
+        seed(42) {}
+  std::string topo;
+  size_t size;
+  size_t routes;
+  size_t stops;
+  size_t cands;
+  double restrDensity;
+  size_t landmarks;
+  size_t hopMemo;
+  size_t seed;
+  std::string record;
+  std::string replay;
+};
+
+// _____________________________________________________________________________
+void* operator new(size_t size) {
+  ALLOCS++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+// _____________________________________________________________________________
+void operator delete(void* p) noexcept { free(p); }
+
+// _____________________________________________________________________________
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// _____________________________________________________________________________
+void usage(const char* bin) {
+  std::cout
+      << "Usage: " << bin << " [options]\n\n"
+      << std::left << std::setw(28) << "  --topo arg (=grid)"
+      << "graph topology, one of grid, radial, corridor\n"
+      << std::setw(28) << "  --size arg (=100)"
+      << "graph size, about sqrt(number of nodes)\n"
+      << std::setw(28) << "  --routes arg (=200)"
+      << "number of candidate routes\n"
+      << std::setw(28) << "  --stops arg (=12)"
+      << "number of stops per route\n"
+      << std::setw(28) << "  --cands arg (=3)"
+      << "number of candidates per stop\n"
+      << std::setw(28) << "  --restr arg (=0)"
+      << "fraction of nodes with a turn restriction\n"
+      << std::setw(28) << "  --landmarks arg (=0)"
+      << "number of ALT landmarks, 0 disables\n"
+      << std::setw(28) << "  --hop-memo arg (=0)"
+      << "size of the stop pair memo in MB, 0 disables\n"
+      << std::setw(28) << "  --seed arg (=42)"
+      << "random seed\n"
+      << std::setw(28) << "  --record arg"
+      << "write the graph parameters and routes to <arg>\n"
+      << std::setw(28) << "  --replay arg"
+      << "replay a workload written with --record\n";
+}
+
+// _____________________________________________________________________________
+void readOpts(BenchOpts* opts, int argc, char** argv) {
+  struct option ops[] = {{"topo", required_argument, 0, 1},
+                         {"size", required_argument, 0, 2},
+                         {"routes", required_argument, 0, 3},
+                         {"stops", required_argument, 0, 4},
+                         {"cands", required_argument, 0, 5},
+                         {"restr", required_argument, 0, 6},
+                         {"landmarks", required_argument, 0, 7},
+                         {"seed", required_argument, 0, 8},
+                         {"record", required_argument, 0, 9},
+                         {"replay", required_argument, 0, 10},
+                         {"hop-memo", required_argument, 0, 11},
+                         {"help", no_argument, 0, 'h'},
+                         {0, 0, 0, 0}};
+
+  int c;
+  while ((c = getopt_long(argc, argv, "h", ops, 0)) != -1) {
+    switch (c) {
+      case 1:
+        opts->topo = optarg;
+        break;
+      case 2:
+        opts->size = atol(optarg);
+        break;
+      case 3:
+        opts->routes = atol(optarg);
+        break;
+      case 4:
+        opts->stops = atol(optarg);
+        break;
+      case 5:
+        opts->cands = atol(optarg);
+        break;
+      case 6:
+        opts->restrDensity = atof(optarg);
+        break;
+      case 7:
+        opts->landmarks = atol(optarg);
+        break;
+      case 8:
+        opts->seed = atol(optarg);
+        break;
+      case 9:
+        opts->record = optarg;
+        break;
+      case 10:
+        opts->replay = optarg;
+        break;
+      case 11:
+        opts->hopMemo = atol(optarg);
+        break;
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if (opts->topo != "grid" && opts->topo != "radial" &&
+      opts->topo != "corridor") {
+    std::cerr << "Unknown topology " << opts->topo
+              << ", must be one of grid, radial, corridor" << std::endl;
+    exit(1);
+  }
+  if (opts->stops < 2 || opts->cands < 1 || opts->size < 2) {
+    std::cerr << "Need at least 2 stops, 1 candidate and size 2" << std::endl;
+    exit(1);
+  }
+}
+
+// _____________________________________________________________________________
+void buildGraph(const BenchOpts& opts, Graph* g, std::vector<Node*>* nds,
+                Restrictor* rest) {
+  std::mt19937 rng(opts.seed);
+  auto* comp = new Component{0};
+  std::vector<TransitEdgeLine*> lines;
+  for (size_t i = 0; i < 16; i++) {
+    lines.push_back(new TransitEdgeLine{"from" + std::to_string(i),
+                                        "to" + std::to_string(i),
+                                        std::to_string(i % 4)});
+  }
+
+  auto addNd = [&](double x, double y) {
+    nds->push_back(g->addNd(NodePL(POINT(x + rng() % 30, y + rng() % 30))));
+    nds->back()->pl().setComp(comp);
+  };
+
+  // add edges in both directions between nodes a and b
+  auto addEdgs = [&](size_t a, size_t b) {
+    double len = util::geo::dist(*(*nds)[a]->pl().getGeom(),
+                                 *(*nds)[b]->pl().getGeom());
+    for (size_t i = 0; i < 2; i++) {
+      Node* from = (*nds)[i ? b : a];
+      Node* to = (*nds)[i ? a : b];
+      auto* e = g->addEdg(from, to);
+      e->pl().addPoint(*from->pl().getGeom());
+      e->pl().addPoint(*to->pl().getGeom());
+      e->pl().setLength(len * (1 + (rng() % 100) / 100.0));
+      e->pl().setLvl(rng() % 4);
+      if (rng() % 3 == 0) e->pl().addLine(lines[rng() % lines.size()]);
+    }
+  };
+
+  size_t n = opts.size;
+
+  if (opts.topo == "grid") {
+    // n x n nodes, each connected to its four neighbors
+    for (size_t i = 0; i < n * n; i++) addNd((i % n) * 100.0, (i / n) * 100.0);
+    for (size_t i = 0; i < n * n; i++) {
+      if (i % n + 1 < n) addEdgs(i, i + 1);
+      if (i / n + 1 < n) addEdgs(i, i + n);
+    }
+  } else if (opts.topo == "radial") {
+    // a center node, n rings and 2n spokes
+    size_t spokes = 2 * n;
+    addNd(0, 0);
+    for (size_t r = 1; r <= n; r++) {
+      for (size_t s = 0; s < spokes; s++) {
+        double a = 2 * M_PI * s / spokes;
+        addNd(cos(a) * r * 200.0, sin(a) * r * 200.0);
+      }
+    }
+    for (size_t r = 1; r <= n; r++) {
+      for (size_t s = 0; s < spokes; s++) {
+        size_t cur = 1 + (r - 1) * spokes + s;
+        addEdgs(cur, 1 + (r - 1) * spokes + (s + 1) % spokes);
+        addEdgs(cur, r == 1 ? 0 : cur - spokes);
+      }
+    }
+  } else {
+    // 4 parallel tracks of length n * n / 4 with a crossover about every
+    // 5 nodes
+    size_t len = std::max<size_t>(2, n * n / 4);
+    for (size_t t = 0; t < 4; t++) {
+      for (size_t i = 0; i < len; i++) addNd(i * 100.0, t * 40.0);
+    }
+    for (size_t t = 0; t < 4; t++) {
+      for (size_t i = 0; i + 1 < len; i++) {
+        addEdgs(t * len + i, t * len + i + 1);
+        if (t + 1 < 4 && rng() % 5 == 0) {
+          addEdgs(t * len + i, (t + 1) * len + i + 1);
+        }
+      }
+    }
+  }
+
+  // forbid a random turn at a fraction of the nodes
+  for (auto* nd : *nds) {
+    if (rng() % 10000 >= opts.restrDensity * 10000) continue;
+    if (nd->getAdjListIn().empty() || nd->getAdjListOut().size() < 2) continue;
+    const Edge* from = nd->getAdjListIn()[rng() % nd->getAdjListIn().size()];
+    const Edge* to = nd->getAdjListOut()[rng() % nd->getAdjListOut().size()];
+    rest->addRule(nd, {from, to}, false);
+  }
+}
+
+// _____________________________________________________________________________
+size_t walk(const std::vector<Node*>& nds, size_t cur, size_t steps,
+            const std::map<const Node*, size_t>& idx, std::mt19937* rng) {
+  const Node* prev = 0;
+  for (size_t i = 0; i < steps; i++) {
+    const auto& adj = nds[cur]->getAdjListOut();
+    if (adj.empty()) break;
+    const Node* next = adj[(*rng)() % adj.size()]->getTo();
+    // avoid going back if there is another way
+    if (next == prev && adj.size() > 1) {
+      next = adj[(*rng)() % adj.size()]->getTo();
+    }
+    prev = nds[cur];
+    cur = idx.find(next)->second;
+  }
+  return cur;
+}
+
+// _____________________________________________________________________________
+std::vector<NodeCandRoute> randRoutes(const BenchOpts& opts,
+                                      const std::vector<Node*>& nds) {
+  // routes are drawn with their own generator, such that the same graph
+  // can be used with different workloads
+  std::mt19937 rng(opts.seed + 1);
+  std::map<const Node*, size_t> idx;
+  for (size_t i = 0; i < nds.size(); i++) idx[nds[i]] = i;
+
+  std::vector<NodeCandRoute> ret;
+  for (size_t i = 0; i < opts.routes; i++) {
+    ret.push_back(NodeCandRoute());
+    size_t cur = rng() % nds.size();
+    for (size_t j = 0; j < opts.stops; j++) {
+      cur = walk(nds, cur, 2 + rng() % 5, idx, &rng);
+      ret.back().push_back(NodeCandGroup());
+      ret.back().back().push_back(NodeCand{nds[cur], 0});
+      for (size_t k = 1; k < opts.cands; k++) {
+        size_t cand = walk(nds, cur, 1 + rng() % 2, idx, &rng);
+        ret.back().back().push_back(NodeCand{nds[cand], k * 10.0});
+      }
+    }
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+void record(const std::string& path, const BenchOpts& opts,
+            const std::vector<Node*>& nds,
+            const std::vector<NodeCandRoute>& routes) {
+  std::map<const Node*, size_t> idx;
+  for (size_t i = 0; i < nds.size(); i++) idx[nds[i]] = i;
+
+  std::ofstream out(path);
+  out << "graph " << opts.topo << " " << opts.size << " " << opts.seed << " "
+      << opts.restrDensity << "\n";
+  for (const auto& r : routes) {
+    out << "route " << r.size() << "\n";
+    for (const auto& grp : r) {
+      for (size_t i = 0; i < grp.size(); i++) {
+        out << (i ? " " : "") << idx[grp[i].nd] << ":" << grp[i].pen;
+      }
+      out << "\n";
+    }
+  }
+}
+
+// _____________________________________________________________________________
+std::vector<NodeCandRoute> replay(const std::string& path, BenchOpts* opts,
+                                  Graph* g, std::vector<Node*>* nds,
+                                  Restrictor* rest) {
+  std::ifstream in(path);
+  if (!in.good()) {
+    std::cerr << "Could not open " << path << std::endl;
+    exit(1);
+  }
+
+  std::string tok;
+  in >> tok >> opts->topo >> opts->size >> opts->seed >> opts->restrDensity;
+  if (tok != "graph") {
+    std::cerr << path << " is not a recorded workload" << std::endl;
+    exit(1);
+  }
+
+  buildGraph(*opts, g, nds, rest);
+
+  std::vector<NodeCandRoute> ret;
+  size_t num;
+  while (in >> tok >> num) {
+    ret.push_back(NodeCandRoute(num));
+    std::string line;
+    std::getline(in, line);
+    for (size_t i = 0; i < num && std::getline(in, line); i++) {
+      std::stringstream ss(line);
+      std::string cand;
+      while (ss >> cand) {
+        size_t sep = cand.find(':');
+        size_t nd = atol(cand.substr(0, sep).c_str());
+        if (nd >= nds->size()) {
+          std::cerr << "Node " << nd << " not in graph" << std::endl;
+          exit(1);
+        }
+        ret.back()[i].push_back(
+            NodeCand{(*nds)[nd], atof(cand.substr(sep + 1).c_str())});
+      }
+    }
+  }
+
+  opts->routes = ret.size();
+  return ret;
+}
+
+// _____________________________________________________________________________
+int main(int argc, char** argv) {
+  BenchOpts opts;
+  readOpts(&opts, argc, argv);
+
+  Graph g;
+  std::vector<Node*> nds;
+  Restrictor rest;
+  std::vector<NodeCandRoute> routes;
+
+  if (opts.replay.size()) {
+    routes = replay(opts.replay, &opts, &g, &nds, &rest);
+  } else {
+    buildGraph(opts, &g, &nds, &rest);
+    routes = randRoutes(opts, nds);
+  }
+
+  if (opts.record.size()) record(opts.record, opts, nds, routes);
+
+  size_t hops = 0;
+  for (const auto& r : routes) hops += r.size() ? r.size() - 1 : 0;
+  if (!hops) {
+    std::cerr << "No hops to route" << std::endl;
+    exit(1);
+  }
+
+  RoutingAttrs rAttrs;
+  rAttrs.shortName = "1";
+  RoutingOpts rOpts;
+  rOpts.nonOsmPen = 0;
+  // level factors of at least 1, as in the default configuration
+  for (size_t i = 0; i < 8; i++) rOpts.levelPunish[i] = 1 + i * 0.5;
+
+  CsrGraph csr(g);
+  Landmarks* lms = 0;
+  if (opts.landmarks) lms = new Landmarks(g, rOpts, opts.landmarks, 0);
+
+  size_t numEdgs = 0;
+  for (auto* nd : nds) numEdgs += nd->getAdjListOut().size();
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << opts.topo << " graph, " << nds.size() << " nodes, " << numEdgs
+            << " edges, " << rest.getNegRules().size()
+            << " restricted nodes, " << routes.size() << " routes, " << hops
+            << " hops" << std::endl;
+
+  const char* names[3] = {"route", "routeGreedy", "routeGreedy2"};
+
+  for (size_t useCsr = 0; useCsr < 2; useCsr++) {
+    for (size_t mode = 0; mode < 3; mode++) {
+      // a fresh router and memo per run, such that runs are independent
+      Router router(1, false, 0);
+      if (useCsr) router.setCsrGraph(&csr);
+      if (lms) router.setLandmarks(lms);
+      HopMemo memo(opts.hopMemo * 1024 * 1024, 1);
+      if (opts.hopMemo) router.setHopMemo(&memo);
+
+      size_t allocs = ALLOCS;
+      // the greedy methods search on nodes, the global one on edges
+      size_t iters = EDijkstra::ITERS + Dijkstra::ITERS;
+      auto t = std::chrono::steady_clock::now();
+
+      for (const auto& r : routes) {
+        EdgeListHops res;
+        if (mode == 0) res = router.route(r, rAttrs, rOpts, rest);
+        if (mode == 1) res = router.routeGreedy(r, rAttrs, rOpts, rest);
+        if (mode == 2) res = router.routeGreedy2(r, rAttrs, rOpts, rest);
+      }
+
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - t)
+                      .count();
+
+      std::cout << std::left << std::setw(11)
+                << (useCsr ? "workspace" : "generic") << std::setw(14)
+                << names[mode] << std::right << std::setw(12)
+                << hops / (ms / 1000) << " hops/s" << std::setw(12)
+                << static_cast<double>(EDijkstra::ITERS + Dijkstra::ITERS -
+                                       iters) /
+                       hops
+                << " iters/hop" << std::setw(10)
+                << static_cast<double>(ALLOCS - allocs) / hops
+                << " allocs/hop" << std::endl;
+    }
+  }
+
+  delete lms;
+}
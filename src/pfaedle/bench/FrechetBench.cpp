@@ -0,0 +1,341 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+// Benchmark for the Fréchet kernels used by the evaluation. Reads the shapes
+// of a GTFS shapes.txt and pairs each with the shape of the same id in a
+// second shapes.txt (e.g. the output of a run with --inplace), or, without
+// a second file, with a jittered copy of itself. Computes the accumulated
+// Fréchet distance of each pair with the full distance matrix, with two
+// rows, banded and bounded, and reports time and peak heap memory.
+
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "pfaedle/Def.h"
+#include "util/geo/Geo.h"
+
+using util::geo::accFrechetDistC;
+using util::geo::accFrechetDistCBand;
+using util::geo::densify;
+using util::geo::latLngToWebMerc;
+
+static size_t LIVE_BYTES = 0;
+static size_t PEAK_BYTES = 0;
+
+struct FrechetBenchOpts {
+  FrechetBenchOpts()
+      : dist(5), band(200), bound(0), maxMatrixMb(2048), seed(42) {}
+  double dist;
+  size_t band;
+  double bound;
+  size_t maxMatrixMb;
+  size_t seed;
+  std::string shapesA;
+  std::string shapesB;
+};
+
+// _____________________________________________________________________________
+void* operator new(size_t size) {
+  // remember the size in front of the block to track the live heap size
+  size_t* p = static_cast<size_t*>(malloc(size + sizeof(size_t) * 2));
+  if (!p) throw std::bad_alloc();
+  *p = size;
+  LIVE_BYTES += size;
+  PEAK_BYTES = std::max(PEAK_BYTES, LIVE_BYTES);
+  return p + 2;
+}
+
+// _____________________________________________________________________________
+void operator delete(void* p) noexcept {
+  if (!p) return;
+  size_t* s = static_cast<size_t*>(p) - 2;
+  LIVE_BYTES -= *s;
+  free(s);
+}
+
+// _____________________________________________________________________________
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+// _____________________________________________________________________________
+template <typename T>
+double fullMatrixAccFrechet(const util::geo::Line<T>& a,
+                            const util::geo::Line<T>& b, double d) {
+  // the kernel as it was before it kept only two rows, as the reference
+  auto p = densify(a, d);
+  auto q = densify(b, d);
+
+  std::vector<std::vector<double>> ca(p.size(),
+                                      std::vector<double>(q.size(), 0));
+
+  for (size_t i = 0; i < p.size(); i++)
+    ca[i][0] = std::numeric_limits<double>::infinity();
+  for (size_t j = 0; j < q.size(); j++)
+    ca[0][j] = std::numeric_limits<double>::infinity();
+  ca[0][0] = 0;
+
+  for (size_t i = 1; i < p.size(); i++) {
+    for (size_t j = 1; j < q.size(); j++) {
+      double d = util::geo::dist(p[i], q[j]) * util::geo::dist(p[i], p[i - 1]);
+      ca[i][j] =
+          d + std::min(ca[i - 1][j], std::min(ca[i][j - 1], ca[i - 1][j - 1]));
+    }
+  }
+
+  return ca[p.size() - 1][q.size() - 1];
+}
+
+// _____________________________________________________________________________
+void usage(const char* bin) {
+  std::cout << "Usage: " << bin
+            << " [options] <shapes.txt> [<shapes.txt to compare with>]\n\n"
+            << std::left << std::setw(28) << "  --dist arg (=5)"
+            << "densification distance in meters\n"
+            << std::setw(28) << "  --band arg (=200)"
+            << "band width in points for the banded kernel\n"
+            << std::setw(28) << "  --bound arg (=0)"
+            << "upper bound in meters per meter of shape for\n"
+            << std::setw(28) << " "
+            << "the bounded kernel, 0 skips it\n"
+            << std::setw(28) << "  --max-matrix arg (=2048)"
+            << "skip the full matrix above this size in MB\n"
+            << std::setw(28) << "  --seed arg (=42)"
+            << "random seed for the jitter\n";
+}
+
+// _____________________________________________________________________________
+void readOpts(FrechetBenchOpts* opts, int argc, char** argv) {
+  struct option ops[] = {{"dist", required_argument, 0, 1},
+                         {"band", required_argument, 0, 2},
+                         {"bound", required_argument, 0, 3},
+                         {"max-matrix", required_argument, 0, 4},
+                         {"seed", required_argument, 0, 5},
+                         {"help", no_argument, 0, 'h'},
+                         {0, 0, 0, 0}};
+
+  int c;
+  while ((c = getopt_long(argc, argv, "h", ops, 0)) != -1) {
+    switch (c) {
+      case 1:
+        opts->dist = atof(optarg);
+        break;
+      case 2:
+        opts->band = atol(optarg);
+        break;
+      case 3:
+        opts->bound = atof(optarg);
+        break;
+      case 4:
+        opts->maxMatrixMb = atol(optarg);
+        break;
+      case 5:
+        opts->seed = atol(optarg);
+        break;
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if (optind == argc) {
+    usage(argv[0]);
+    exit(1);
+  }
+  opts->shapesA = argv[optind];
+  if (optind + 1 < argc) opts->shapesB = argv[optind + 1];
+
+  if (opts->dist <= 0) {
+    std::cerr << "Densification distance must be positive" << std::endl;
+    exit(1);
+  }
+}
+
+// _____________________________________________________________________________
+std::vector<std::string> splitCsv(const std::string& line) {
+  std::vector<std::string> ret(1);
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    if (c == '"' && quoted && i + 1 < line.size() && line[i + 1] == '"') {
+      ret.back() += '"';
+      i++;
+    } else if (c == '"') {
+      quoted = !quoted;
+    } else if (c == ',' && !quoted) {
+      ret.push_back("");
+    } else if (c != '\r') {
+      ret.back() += c;
+    }
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+std::map<std::string, LINE> readShapes(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.good()) {
+    std::cerr << "Could not open " << path << std::endl;
+    exit(1);
+  }
+
+  std::string line;
+  std::getline(in, line);
+  auto hdr = splitCsv(line);
+  size_t cols[4] = {0, 0, 0, 0};
+  const char* names[4] = {"shape_id", "shape_pt_lat", "shape_pt_lon",
+                          "shape_pt_sequence"};
+  for (size_t c = 0; c < 4; c++) {
+    auto i = std::find_if(hdr.begin(), hdr.end(), [&](const std::string& h) {
+      return h.find(names[c]) != std::string::npos;
+    });
+    if (i == hdr.end()) {
+      std::cerr << path << " has no column " << names[c] << std::endl;
+      exit(1);
+    }
+    cols[c] = i - hdr.begin();
+  }
+
+  std::map<std::string, std::vector<std::pair<size_t, POINT>>> pts;
+  while (std::getline(in, line)) {
+    auto f = splitCsv(line);
+    if (f.size() <= *std::max_element(cols, cols + 4)) continue;
+    pts[f[cols[0]]].push_back(
+        {atol(f[cols[3]].c_str()),
+         latLngToWebMerc<PFAEDLE_PRECISION>(atof(f[cols[1]].c_str()),
+                                            atof(f[cols[2]].c_str()))});
+  }
+
+  std::map<std::string, LINE> ret;
+  for (auto& s : pts) {
+    std::sort(s.second.begin(), s.second.end(),
+              [](const std::pair<size_t, POINT>& a,
+                 const std::pair<size_t, POINT>& b) {
+                return a.first < b.first;
+              });
+    LINE& l = ret[s.first];
+    for (const auto& p : s.second) l.push_back(p.second);
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+int main(int argc, char** argv) {
+  FrechetBenchOpts opts;
+  readOpts(&opts, argc, argv);
+
+  auto shapesA = readShapes(opts.shapesA);
+  std::map<std::string, LINE> shapesB;
+  if (opts.shapesB.size()) shapesB = readShapes(opts.shapesB);
+
+  // pairs of shapes, and the web mercator scale factor near them
+  std::vector<std::pair<LINE, LINE>> pairs;
+  std::vector<double> facs;
+  std::mt19937 rng(opts.seed);
+  std::normal_distribution<double> jitter(0, 3);
+
+  for (const auto& s : shapesA) {
+    if (s.second.size() < 2) continue;
+    LINE b;
+    if (opts.shapesB.size()) {
+      auto i = shapesB.find(s.first);
+      if (i == shapesB.end() || i->second.size() < 2) continue;
+      b = i->second;
+    } else {
+      for (const auto& p : s.second) {
+        b.push_back(POINT(p.getX() + jitter(rng), p.getY() + jitter(rng)));
+      }
+    }
+    pairs.push_back({s.second, b});
+    // same as the evaluation
+    facs.push_back(cos(2 * atan(exp((s.second.front().getY() +
+                                     s.second.back().getY()) /
+                                    6378137.0)) -
+                       1.5707965));
+  }
+
+  if (!pairs.size()) {
+    std::cerr << "No shape pairs to compare" << std::endl;
+    exit(1);
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << pairs.size() << " shape pairs, densified every " << opts.dist
+            << " m" << std::endl;
+
+  const char* modes[4] = {"full matrix", "two rows", "banded", "bounded"};
+  std::vector<double> ref(pairs.size(), -1);
+
+  for (size_t mode = 0; mode < 4; mode++) {
+    if (mode == 3 && opts.bound <= 0) continue;
+
+    double ms = 0;
+    size_t peak = 0, done = 0, aborted = 0;
+    double maxErr = 0;
+
+    for (size_t i = 0; i < pairs.size(); i++) {
+      double d = opts.dist / facs[i];
+      const LINE& a = pairs[i].first;
+      const LINE& b = pairs[i].second;
+
+      if (mode == 0) {
+        double n = util::geo::len(a) / d + a.size();
+        double m = util::geo::len(b) / d + b.size();
+        if (n * m * sizeof(double) > opts.maxMatrixMb * 1024.0 * 1024.0) {
+          continue;
+        }
+      }
+
+      size_t live = LIVE_BYTES;
+      PEAK_BYTES = live;
+      auto t = std::chrono::steady_clock::now();
+
+      double fd = 0;
+      if (mode == 0) fd = fullMatrixAccFrechet(a, b, d);
+      if (mode == 1) fd = accFrechetDistC(a, b, d);
+      if (mode == 2) {
+        fd = accFrechetDistCBand(a, b, d, opts.band,
+                                 std::numeric_limits<double>::infinity());
+      }
+      if (mode == 3) {
+        fd = accFrechetDistC(a, b, d,
+                             opts.bound * util::geo::len(a) / facs[i]);
+      }
+
+      ms += std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - t)
+                .count();
+      peak = std::max(peak, PEAK_BYTES - live);
+      done++;
+
+      if (std::isinf(fd)) {
+        aborted++;
+      } else if (mode == 1) {
+        ref[i] = fd;
+      } else if (ref[i] > 0) {
+        maxErr = std::max(maxErr, fabs(fd - ref[i]) / ref[i]);
+      }
+    }
+
+    std::cout << std::left << std::setw(13) << modes[mode] << std::right
+              << std::setw(7) << done << " pairs" << std::setw(12) << ms
+              << " ms" << std::setw(12) << peak / (1024.0 * 1024.0)
+              << " MB peak" << std::setw(8) << aborted << " aborted"
+              << std::setw(10) << maxErr * 100 << "% max. error"
+              << std::endl;
+  }
+}
@@ -0,0 +1,311 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+// Benchmark for the name normalizer. Normalizes a corpus of station names
+// with a normalization chain of a MOT config, once with the plain regex
+// chain (every rule through std::regex_replace, cache behind a single
+// mutex) and once with the Normalizer, both with an empty cache and with a
+// warm cache shared by several threads. Also checks that both produce the
+// same names.
+
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pfaedle/config/MotConfigReader.h"
+#include "pfaedle/trgraph/Normalizer.h"
+
+using pfaedle::config::MotConfigReader;
+using pfaedle::trgraph::Normalizer;
+using pfaedle::trgraph::ReplRules;
+
+struct NormBenchOpts {
+  NormBenchOpts()
+      : config("pfaedle.cfg"), chain("station"), threads(4), rounds(10) {}
+  std::string config;
+  std::string chain;
+  size_t threads;
+  size_t rounds;
+  std::string names;
+};
+
+/*
+ * The normalization as done before the Normalizer compiled its rules, as
+ * the reference for speed and output
+ */
+class RegexChain {
+ public:
+  explicit RegexChain(const ReplRules& rules) {
+    for (const auto& r : rules) {
+      _rules.push_back({std::regex(r.first, std::regex::ECMAScript |
+                                                std::regex::icase |
+                                                std::regex::optimize),
+                        r.second});
+    }
+  }
+
+  std::string norm(const std::string& sn) const {
+    std::string ret = sn;
+    for (const auto& rule : _rules) {
+      std::string tmp;
+      std::regex_replace(std::back_inserter(tmp), ret.begin(), ret.end(),
+                         rule.first, rule.second,
+                         std::regex_constants::format_sed);
+      std::swap(ret, tmp);
+    }
+    std::transform(ret.begin(), ret.end(), ret.begin(), ::tolower);
+    return ret;
+  }
+
+  std::string normTS(const std::string& sn) const {
+    std::lock_guard<std::mutex> lock(_m);
+    auto i = _cache.find(sn);
+    if (i != _cache.end()) return i->second;
+    return _cache[sn] = norm(sn);
+  }
+
+ private:
+  std::vector<std::pair<std::regex, std::string>> _rules;
+  mutable std::unordered_map<std::string, std::string> _cache;
+  mutable std::mutex _m;
+};
+
+// _____________________________________________________________________________
+void usage(const char* bin) {
+  std::cout << "Usage: " << bin << " [options] <names file>\n\n"
+            << "<names file> holds one name per line, or is a GTFS "
+               "stops.txt\n\n"
+            << std::left << std::setw(28) << "  --config arg (=pfaedle.cfg)"
+            << "MOT config file, the first config is used\n"
+            << std::setw(28) << "  --chain arg (=station)"
+            << "normalization chain, one of station, line,\n"
+            << std::setw(28) << " "
+            << "track\n"
+            << std::setw(28) << "  --threads arg (=4)"
+            << "threads for the warm cache runs\n"
+            << std::setw(28) << "  --rounds arg (=10)"
+            << "passes over the corpus per thread in warm runs\n";
+}
+
+// _____________________________________________________________________________
+void readOpts(NormBenchOpts* opts, int argc, char** argv) {
+  struct option ops[] = {{"config", required_argument, 0, 1},
+                         {"chain", required_argument, 0, 2},
+                         {"threads", required_argument, 0, 3},
+                         {"rounds", required_argument, 0, 4},
+                         {"help", no_argument, 0, 'h'},
+                         {0, 0, 0, 0}};
+
+  int c;
+  while ((c = getopt_long(argc, argv, "h", ops, 0)) != -1) {
+    switch (c) {
+      case 1:
+        opts->config = optarg;
+        break;
+      case 2:
+        opts->chain = optarg;
+        break;
+      case 3:
+        opts->threads = atol(optarg);
+        break;
+      case 4:
+        opts->rounds = atol(optarg);
+        break;
+      case 'h':
+        usage(argv[0]);
+        exit(0);
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if (optind == argc) {
+    usage(argv[0]);
+    exit(1);
+  }
+  opts->names = argv[optind];
+
+  if (opts->chain != "station" && opts->chain != "line" &&
+      opts->chain != "track") {
+    std::cerr << "Unknown chain " << opts->chain
+              << ", must be one of station, line, track" << std::endl;
+    exit(1);
+  }
+  if (!opts->threads || !opts->rounds) {
+    std::cerr << "Need at least 1 thread and 1 round" << std::endl;
+    exit(1);
+  }
+}
+
+// _____________________________________________________________________________
+std::vector<std::string> splitCsv(const std::string& line) {
+  std::vector<std::string> ret(1);
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    if (c == '"' && quoted && i + 1 < line.size() && line[i + 1] == '"') {
+      ret.back() += '"';
+      i++;
+    } else if (c == '"') {
+      quoted = !quoted;
+    } else if (c == ',' && !quoted) {
+      ret.push_back("");
+    } else if (c != '\r') {
+      ret.back() += c;
+    }
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+std::vector<std::string> readNames(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.good()) {
+    std::cerr << "Could not open " << path << std::endl;
+    exit(1);
+  }
+
+  std::vector<std::string> ret;
+  std::string line;
+  size_t col = 0;
+  bool csv = false;
+
+  if (std::getline(in, line)) {
+    auto hdr = splitCsv(line);
+    for (size_t i = 0; i < hdr.size(); i++) {
+      // skip a leading UTF-8 byte order mark
+      if (hdr[i] == "stop_name" || hdr[i] == "\xEF\xBB\xBFstop_name") {
+        col = i;
+        csv = true;
+      }
+    }
+    if (!csv) ret.push_back(line);
+  }
+
+  while (std::getline(in, line)) {
+    if (!csv) {
+      ret.push_back(line);
+      continue;
+    }
+    auto fields = splitCsv(line);
+    if (col < fields.size()) ret.push_back(fields[col]);
+  }
+
+  return ret;
+}
+
+// _____________________________________________________________________________
+template <typename F>
+double timeMs(F f) {
+  auto t = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - t)
+      .count();
+}
+
+// _____________________________________________________________________________
+template <typename F>
+double timeThreads(size_t n, F f) {
+  return timeMs([&]() {
+    std::vector<std::thread> thrds;
+    for (size_t i = 0; i < n; i++) thrds.push_back(std::thread(f));
+    for (auto& t : thrds) t.join();
+  });
+}
+
+// _____________________________________________________________________________
+int main(int argc, char** argv) {
+  NormBenchOpts opts;
+  readOpts(&opts, argc, argv);
+
+  MotConfigReader reader;
+  reader.parse({opts.config});
+  if (!reader.getConfigs().size()) {
+    std::cerr << "No MOT config found in " << opts.config << std::endl;
+    exit(1);
+  }
+
+  const auto& osmOpts = reader.getConfigs().front().osmBuildOpts;
+  ReplRules rules = osmOpts.statNormzer.getRules();
+  if (opts.chain == "line") rules = osmOpts.lineNormzer.getRules();
+  if (opts.chain == "track") rules = osmOpts.trackNormzer.getRules();
+
+  const auto& names = readNames(opts.names);
+  std::set<std::string> uniq(names.begin(), names.end());
+  std::vector<std::string> corpus(uniq.begin(), uniq.end());
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << names.size() << " names, " << corpus.size() << " unique, "
+            << rules.size() << " " << opts.chain << " rules" << std::endl;
+
+  RegexChain ref(rules);
+  Normalizer normzer(rules);
+
+  std::vector<std::string> refOut(corpus.size()), normOut(corpus.size());
+
+  // cold: every name is normalized once, nothing is cached
+  double refMs = timeMs([&]() {
+    for (size_t i = 0; i < corpus.size(); i++) refOut[i] = ref.norm(corpus[i]);
+  });
+  double normMs = timeMs([&]() {
+    for (size_t i = 0; i < corpus.size(); i++) {
+      normOut[i] = normzer.norm(corpus[i]);
+    }
+  });
+
+  size_t diffs = 0;
+  for (size_t i = 0; i < corpus.size(); i++) {
+    if (refOut[i] == normOut[i]) continue;
+    if (diffs++ < 10) {
+      std::cout << "  differs: '" << corpus[i] << "' -> '" << refOut[i]
+                << "' vs. '" << normOut[i] << "'" << std::endl;
+    }
+  }
+
+  // warm: all threads normalize the whole corpus repeatedly
+  for (const auto& n : corpus) ref.normTS(n);
+  size_t lookups = opts.threads * opts.rounds * names.size();
+  double refWarmMs = timeThreads(opts.threads, [&]() {
+    for (size_t r = 0; r < opts.rounds; r++) {
+      for (const auto& n : names) ref.normTS(n);
+    }
+  });
+  double normWarmMs = timeThreads(opts.threads, [&]() {
+    for (size_t r = 0; r < opts.rounds; r++) {
+      for (const auto& n : names) normzer.norm(n);
+    }
+  });
+
+  std::cout << std::left << std::setw(12) << "regex chain" << std::setw(7)
+            << "cold" << std::right << std::setw(14)
+            << corpus.size() / (refMs / 1000) << " names/s" << std::endl;
+  std::cout << std::left << std::setw(12) << "normalizer" << std::setw(7)
+            << "cold" << std::right << std::setw(14)
+            << corpus.size() / (normMs / 1000) << " names/s" << std::endl;
+  std::cout << std::left << std::setw(12) << "regex chain" << std::setw(7)
+            << "warm" << std::right << std::setw(14)
+            << lookups / (refWarmMs / 1000) << " names/s (" << opts.threads
+            << " threads)" << std::endl;
+  std::cout << std::left << std::setw(12) << "normalizer" << std::setw(7)
+            << "warm" << std::right << std::setw(14)
+            << lookups / (normWarmMs / 1000) << " names/s (" << opts.threads
+            << " threads)" << std::endl;
+  std::cout << diffs << " of " << corpus.size() << " names differ"
+            << std::endl;
+
+  return diffs ? 1 : 0;
+}
@@ -72,6 +72,10 @@ void ConfigReader::help(const char* bin) {
             << "  written to <arg>\n"
             << std::setw(35) << "  --inplace"
             << "overwrite input GTFS feed with output feed\n"
+            << std::setw(35) << "  --copy-unchanged"
+            << "copy GTFS files not changed by pfaedle\n"
+            << std::setw(35) << " "
+            << "  byte-for-byte instead of rewriting them\n"
             << "\nDebug Output:\n"
             << std::setw(35) << "  -d [ --dbg-path ] arg (=.)"
             << "output path for debug files\n"
@@ -103,6 +107,10 @@ void ConfigReader::help(const char* bin) {
             << "bins to use for d_f histogram, comma sep.\n"
             << std::setw(35) << " "
             << "  (e.g. 10,20,30,40)\n"
+            << std::setw(35) << "  --eval-no-trips"
+            << "do not write a GeoJSON file per evaluated\n"
+            << std::setw(35) << " "
+            << "  trip to <eval-path>\n"
             << "\nMisc:\n"
             << std::setw(35) << "  -T [ --trip-id ] arg"
             << "Do routing only for trip <arg>, write result \n"
@@ -115,7 +123,49 @@ void ConfigReader::help(const char* bin) {
             << std::setw(35) << "  --use-route-cache"
             << "(experimental) cache intermediate routing\n"
             << std::setw(35) << " "
-            << "  results\n";
+            << "  results, shared between all threads\n"
+            << std::setw(35) << "  --route-cache-size arg (=1024)"
+            << "max. size of the route cache in MB\n"
+            << std::setw(35) << "  --hop-memo-size arg (=256)"
+            << "max. size in MB of the memo of stop pairs\n"
+            << std::setw(35) << " "
+            << "  already routed for other trips, 0 disables\n"
+            << std::setw(35) << "  --graph-cache arg"
+            << "directory for graph snapshots, re-used on\n"
+            << std::setw(35) << " "
+            << "  runs with unchanged OSM data and config\n"
+            << std::setw(35) << "  --single-osm-pass"
+            << "read the OSM file only once for all MOT\n"
+            << std::setw(35) << " "
+            << "  configs, keeps all graphs in memory\n"
+            << std::setw(35) << "  --osm-id-set arg (=auto)"
+            << "storage of OSM id sets during reading, one\n"
+            << std::setw(35) << " "
+            << "  of auto, mem, disk. auto keeps them in\n"
+            << std::setw(35) << " "
+            << "  memory while RAM allows\n"
+            << std::setw(35) << "  --landmarks arg (=0)"
+            << "number of ALT landmarks per graph component\n"
+            << std::setw(35) << " "
+            << "  used to guide hop routing, 0 disables\n"
+            << std::setw(35) << "  --stats-out arg"
+            << "write run counters (hops, cache hits, time\n"
+            << std::setw(35) << " "
+            << "  per phase, ...) to file <arg>\n"
+            << std::setw(35) << "  --stats-format arg (=json)"
+            << "format of --stats-out, json or prometheus\n"
+            << std::setw(35) << "  --profile-out arg"
+            << "write wall time, CPU time and peak memory\n"
+            << std::setw(35) << " "
+            << "  per phase as JSON to file <arg>\n"
+            << std::setw(35) << "  --manifest arg"
+            << "cluster fingerprints of the previous run,\n"
+            << std::setw(35) << " "
+            << "  rewritten for the next run\n"
+            << std::setw(35) << "  --prev-output arg"
+            << "output feed of the previous run, unchanged\n"
+            << std::setw(35) << " "
+            << "  clusters keep their shape (needs --manifest)\n";
 }
 
 // _____________________________________________________________________________
@@ -145,6 +195,19 @@ void ConfigReader::read(Config* cfg, int argc, char** argv) {
                          {"help", no_argument, 0, 'h'},
                          {"inplace", no_argument, 0, 9},
                          {"use-route-cache", no_argument, 0, 8},
+                         {"route-cache-size", required_argument, 0, 10},
+                         {"graph-cache", required_argument, 0, 11},
+                         {"single-osm-pass", no_argument, 0, 12},
+                         {"osm-id-set", required_argument, 0, 13},
+                         {"landmarks", required_argument, 0, 14},
+                         {"stats-out", required_argument, 0, 15},
+                         {"stats-format", required_argument, 0, 16},
+                         {"profile-out", required_argument, 0, 17},
+                         {"hop-memo-size", required_argument, 0, 18},
+                         {"prev-output", required_argument, 0, 19},
+                         {"manifest", required_argument, 0, 20},
+                         {"eval-no-trips", no_argument, 0, 21},
+                         {"copy-unchanged", no_argument, 0, 22},
                          {0, 0, 0, 0}};
 
   char c;
@@ -211,6 +274,56 @@ void ConfigReader::read(Config* cfg, int argc, char** argv) {
       case 9:
         cfg->inPlace = true;
         break;
+      case 10:
+        cfg->routeCacheSize = atol(optarg);
+        break;
+      case 11:
+        cfg->graphCachePath = optarg;
+        break;
+      case 12:
+        cfg->singleOsmPass = true;
+        break;
+      case 13:
+        cfg->osmIdSet = optarg;
+        if (cfg->osmIdSet != "auto" && cfg->osmIdSet != "mem" &&
+            cfg->osmIdSet != "disk") {
+          std::cerr << "Unknown OSM id set storage " << cfg->osmIdSet
+                    << ", must be one of auto, mem, disk" << std::endl;
+          exit(1);
+        }
+        break;
+      case 14:
+        cfg->landmarks = atol(optarg);
+        break;
+      case 15:
+        cfg->statsOut = optarg;
+        break;
+      case 16:
+        cfg->statsFormat = optarg;
+        if (cfg->statsFormat != "json" && cfg->statsFormat != "prometheus") {
+          std::cerr << "Unknown stats format " << cfg->statsFormat
+                    << ", must be one of json, prometheus" << std::endl;
+          exit(1);
+        }
+        break;
+      case 17:
+        cfg->profileOut = optarg;
+        break;
+      case 18:
+        cfg->hopMemoSize = atol(optarg);
+        break;
+      case 19:
+        cfg->prevOutputPath = optarg;
+        break;
+      case 20:
+        cfg->manifestPath = optarg;
+        break;
+      case 21:
+        cfg->evalTrips = false;
+        break;
+      case 22:
+        cfg->copyUnchanged = true;
+        break;
       case 'v':
         std::cout << "pfaedle " << VERSION_FULL << " (built " << __DATE__ << " "
                   << __TIME__ << " with geometry precision <"
@@ -22,16 +22,24 @@ struct Config {
         solveMethod("global"),
         evalPath("."),
         outputPath("gtfs-out"),
+        osmIdSet("auto"),
+        statsFormat("json"),
         dropShapes(false),
         useHMM(false),
         writeGraph(false),
         writeCombGraph(false),
         evaluate(false),
+        evalTrips(true),
         buildTransitGraph(false),
         useCaching(false),
         writeOverpass(false),
         inPlace(false),
-        gridSize(2000) {}
+        copyUnchanged(false),
+        singleOsmPass(false),
+        gridSize(2000),
+        routeCacheSize(1024),
+        hopMemoSize(256),
+        landmarks(0) {}
   std::string dbgOutputPath;
   std::string solveMethod;
   std::string evalPath;
@@ -40,6 +48,13 @@ struct Config {
   std::string writeOsm;
   std::string osmPath;
   std::string evalDfBins;
+  std::string graphCachePath;
+  std::string osmIdSet;
+  std::string statsOut;
+  std::string statsFormat;
+  std::string profileOut;
+  std::string prevOutputPath;
+  std::string manifestPath;
   std::vector<std::string> feedPaths;
   std::vector<std::string> configPaths;
   std::set<Route::TYPE> mots;
@@ -48,11 +63,17 @@ struct Config {
   bool writeGraph;
   bool writeCombGraph;
   bool evaluate;
+  bool evalTrips;
   bool buildTransitGraph;
   bool useCaching;
   bool writeOverpass;
   bool inPlace;
+  bool copyUnchanged;
+  bool singleOsmPass;
   double gridSize;
+  size_t routeCacheSize;
+  size_t hopMemoSize;
+  size_t landmarks;
 
   std::string toString() {
     std::stringstream ss;
@@ -60,6 +81,7 @@ struct Config {
        << "output-path: " << outputPath << "\n"
        << "write-osm-path: " << writeOsm << "\n"
        << "read-osm-path: " << osmPath << "\n"
+       << "graph-cache-path: " << graphCachePath << "\n"
        << "debug-output-path: " << dbgOutputPath << "\n"
        << "drop-shapes: " << dropShapes << "\n"
        << "use-hmm: " << useHMM << "\n"
@@ -67,7 +89,19 @@ struct Config {
        << "write-cgraph: " << writeCombGraph << "\n"
        << "grid-size: " << gridSize << "\n"
        << "use-cache: " << useCaching << "\n"
+       << "route-cache-size: " << routeCacheSize << "\n"
+       << "hop-memo-size: " << hopMemoSize << "\n"
        << "write-overpass: " << writeOverpass << "\n"
+       << "single-osm-pass: " << singleOsmPass << "\n"
+       << "osm-id-set: " << osmIdSet << "\n"
+       << "landmarks: " << landmarks << "\n"
+       << "stats-out: " << statsOut << "\n"
+       << "stats-format: " << statsFormat << "\n"
+       << "profile-out: " << profileOut << "\n"
+       << "prev-output: " << prevOutputPath << "\n"
+       << "manifest: " << manifestPath << "\n"
+       << "eval-trips: " << evalTrips << "\n"
+       << "copy-unchanged: " << copyUnchanged << "\n"
        << "feed-paths: ";
 
     for (const auto& p : feedPaths) {
@@ -2,8 +2,15 @@
 // Chair of Algorithms and Data Structures.
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_thread_num() 0
+#endif
+
 #include <csignal>
 #include <fstream>
+#include <mutex>
 #include <set>
 #include <string>
 #include <utility>
@@ -11,6 +18,7 @@
 #include "pfaedle/Def.h"
 #include "pfaedle/eval/Collector.h"
 #include "pfaedle/eval/Result.h"
+#include "util/Profiler.h"
 #include "util/geo/Geo.h"
 #include "util/geo/PolyLine.h"
 #include "util/geo/output/GeoJsonOutput.h"
@@ -24,11 +32,18 @@ using pfaedle::eval::Collector;
 using pfaedle::eval::Result;
 using util::geo::output::GeoJsonOutput;
 
+// _____________________________________________________________________________
+Collector::~Collector() { finish(); }
+
 // _____________________________________________________________________________
 double Collector::add(const Trip* t, const Shape* oldS, const Shape& newS,
                       const std::vector<double>& newTripDists) {
+  util::Profiler::Scope prof("eval");
+  Buffer& buf = _bufs[omp_get_thread_num() % _bufs.size()];
+
   if (!oldS) {
-    _noOrigShp++;
+    std::lock_guard<std::mutex> lock(buf.m);
+    buf.noOrigShp++;
     return 0;
   }
 
@@ -36,7 +51,8 @@ double Collector::add(const Trip* t, const Shape* oldS, const Shape& newS,
     if (st.getShapeDistanceTravelled() < 0) {
       // we cannot safely compare trips without shape dist travelled
       // info
-      _noOrigShp++;
+      std::lock_guard<std::mutex> lock(buf.m);
+      buf.noOrigShp++;
       return 0;
     }
   }
@@ -53,9 +69,6 @@ double Collector::add(const Trip* t, const Shape* oldS, const Shape& newS,
   std::vector<double> newDists;
   LINE newL = getWebMercLine(&newS, -1, -1, &newDists);
 
-  std::ofstream fstr(_evalOutPath + "/trip-" + t->getId() + ".json");
-  GeoJsonOutput gjout(fstr);
-
   auto oldSegs = segmentize(t, oldL, oldDists, 0);
   auto newSegs = segmentize(t, newL, newDists, &newTripDists);
 
@@ -107,69 +120,163 @@ double Collector::add(const Trip* t, const Shape* oldS, const Shape& newS,
   LINE newLCut;
 
   for (auto oldL : oldSegs) {
-    gjout.printLatLng(oldL, util::json::Dict{{"ver", "old"}});
     oldLCut.insert(oldLCut.end(), oldL.begin(), oldL.end());
   }
 
   for (auto newL : newSegs) {
-    gjout.printLatLng(newL, util::json::Dict{{"ver", "new"}});
     newLCut.insert(newLCut.end(), newL.begin(), newL.end());
   }
 
-  gjout.flush();
-  fstr.close();
-
   double fac = cos(2 * atan(exp((oldSegs.front().front().getY() +
                                  oldSegs.back().back().getY()) /
                                 6378137.0)) -
                    1.5707965);
 
-  if (_dCache.count(oldS) && _dCache.find(oldS)->second.count(newS.getId())) {
-    fd = _dCache[oldS][newS.getId()];
-  } else {
+  // the distances are computed outside of the lock, two threads may
+  // compute the same pair concurrently
+  bool cachedD, cachedDA;
+  {
+    std::lock_guard<std::mutex> lock(_cacheM);
+    auto i = _dCache.find(oldS);
+    cachedD = i != _dCache.end() && i->second.count(newS.getId());
+    if (cachedD) fd = i->second.find(newS.getId())->second;
+
+    auto j = _dACache.find(oldS);
+    cachedDA = j != _dACache.end() && j->second.count(newS.getId());
+    if (cachedDA) {
+      unmatchedSegments = j->second.find(newS.getId())->second.first;
+      unmatchedSegmentsLength = j->second.find(newS.getId())->second.second;
+    }
+  }
+
+  if (!cachedD) {
     fd = util::geo::accFrechetDistC(oldLCut, newLCut, 5 / fac) * fac;
+    std::lock_guard<std::mutex> lock(_cacheM);
     _dCache[oldS][newS.getId()] = fd;
   }
 
-  if (_dACache.count(oldS) && _dACache.find(oldS)->second.count(newS.getId())) {
-    unmatchedSegments = _dACache[oldS][newS.getId()].first;
-    unmatchedSegmentsLength = _dACache[oldS][newS.getId()].second;
-  } else {
+  if (!cachedDA) {
     auto dA = getDa(oldSegs, newSegs);
-    _dACache[oldS][newS.getId()] = dA;
     unmatchedSegments = dA.first;
     unmatchedSegmentsLength = dA.second;
+    std::lock_guard<std::mutex> lock(_cacheM);
+    _dACache[oldS][newS.getId()] = dA;
   }
 
   double totL = 0;
   for (auto l : oldSegs) totL += util::geo::len(l) * fac;
 
-  // filter out shapes with a lenght of under 5 meters - they are most likely
-  // artifacts
-  if (totL < 5) {
-    _noOrigShp++;
-    return 0;
+  size_t numSegs = oldSegs.size();
+  if (_writeTrips) {
+    queueTrip(TripGeom{_evalOutPath + "/trip-" + t->getId() + ".json",
+                       std::move(oldSegs), std::move(newSegs)});
   }
 
-  _fdSum += fd / totL;
-  _unmatchedSegSum += unmatchedSegments;
-  _unmatchedSegLengthSum += unmatchedSegmentsLength;
-  _results.insert(Result(t, fd / totL));
-  _resultsAN.insert(Result(t, static_cast<double>(unmatchedSegments) /
-                                  static_cast<double>(oldSegs.size())));
-  _resultsAL.insert(Result(t, unmatchedSegmentsLength / totL));
+  {
+    std::lock_guard<std::mutex> lock(buf.m);
+
+    // filter out shapes with a lenght of under 5 meters - they are most likely
+    // artifacts
+    if (totL < 5) {
+      buf.noOrigShp++;
+      return 0;
+    }
+
+    buf.unmatchedSegSum += unmatchedSegments;
+    buf.unmatchedSegLengthSum += unmatchedSegmentsLength;
+    buf.results.insert(Result(t, fd / totL));
+    buf.resultsAN.insert(Result(t, static_cast<double>(unmatchedSegments) /
+                                       static_cast<double>(numSegs)));
+    buf.resultsAL.insert(Result(t, unmatchedSegmentsLength / totL));
+  }
 
   LOG(DEBUG) << "This result (" << t->getId()
-             << "): A_N/N = " << unmatchedSegments << "/" << oldSegs.size()
+             << "): A_N/N = " << unmatchedSegments << "/" << numSegs
              << " = "
              << static_cast<double>(unmatchedSegments) /
-                    static_cast<double>(oldSegs.size())
+                    static_cast<double>(numSegs)
              << " A_L/L = " << unmatchedSegmentsLength << "/" << totL << " = "
              << unmatchedSegmentsLength / totL << " d_f = " << fd;
 
   return fd;
 }
 
+// _____________________________________________________________________________
+void Collector::finish() {
+  {
+    std::lock_guard<std::mutex> lock(_writeM);
+    _done = true;
+  }
+  _writeNew.notify_all();
+  if (_writer.joinable()) _writer.join();
+
+  // merge in buffer order, the sets are ordered anyway
+  for (auto& buf : _bufs) {
+    std::lock_guard<std::mutex> lock(buf.m);
+    _results.insert(buf.results.begin(), buf.results.end());
+    _resultsAN.insert(buf.resultsAN.begin(), buf.resultsAN.end());
+    _resultsAL.insert(buf.resultsAL.begin(), buf.resultsAL.end());
+    _noOrigShp += buf.noOrigShp;
+    _unmatchedSegSum += buf.unmatchedSegSum;
+    _unmatchedSegLengthSum += buf.unmatchedSegLengthSum;
+    buf.results.clear();
+    buf.resultsAN.clear();
+    buf.resultsAL.clear();
+    buf.noOrigShp = 0;
+    buf.unmatchedSegSum = 0;
+    buf.unmatchedSegLengthSum = 0;
+  }
+
+  // summed up in result order, independent of the thread schedule
+  _fdSum = 0;
+  for (const auto& r : _results) _fdSum += r.getDist();
+}
+
+// _____________________________________________________________________________
+void Collector::queueTrip(TripGeom geom) {
+  std::unique_lock<std::mutex> lock(_writeM);
+  if (!_writing) {
+    _writing = true;
+    _done = false;
+    _writer = std::thread(&Collector::writeTrips, this);
+  }
+
+  // block if the writer falls behind, to bound the memory of the queue
+  _writeFree.wait(lock,
+                  [this] { return _writeQueue.size() < EVAL_WRITE_QUEUE; });
+  _writeQueue.push_back(std::move(geom));
+  lock.unlock();
+  _writeNew.notify_one();
+}
+
+// _____________________________________________________________________________
+void Collector::writeTrips() {
+  while (true) {
+    TripGeom geom;
+    {
+      std::unique_lock<std::mutex> lock(_writeM);
+      _writeNew.wait(lock, [this] { return _done || !_writeQueue.empty(); });
+      if (_writeQueue.empty()) {
+        _writing = false;
+        return;
+      }
+      geom = std::move(_writeQueue.front());
+      _writeQueue.pop_front();
+    }
+    _writeFree.notify_one();
+
+    std::ofstream fstr(geom.path);
+    GeoJsonOutput gjout(fstr);
+    for (const auto& l : geom.oldSegs) {
+      gjout.printLatLng(l, util::json::Dict{{"ver", "old"}});
+    }
+    for (const auto& l : geom.newSegs) {
+      gjout.printLatLng(l, util::json::Dict{{"ver", "new"}});
+    }
+    gjout.flush();
+  }
+}
+
 // _____________________________________________________________________________
 std::vector<LINE> Collector::segmentize(
     const Trip* t, const LINE& shape, const std::vector<double>& dists,
@@ -406,7 +513,8 @@ std::pair<size_t, double> Collector::getDa(const std::vector<LINE>& a,
           1.5707965);
 
   for (size_t i = 0; i < a.size(); i++) {
-    double fd = util::geo::frechetDist(a[i], b[i], 3 / fac) * fac;
+    // only whether the distance reaches 20 m matters, stop once it does
+    double fd = util::geo::frechetDist(a[i], b[i], 3 / fac, 20 / fac) * fac;
     if (fd >= 20) {
       ret.first++;
       ret.second += util::geo::len(a[i]) * fac;
@@ -5,10 +5,14 @@
 #ifndef PFAEDLE_EVAL_COLLECTOR_H_
 #define PFAEDLE_EVAL_COLLECTOR_H_
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "ad/cppgtfs/gtfs/Feed.h"
@@ -23,24 +27,49 @@ using ad::cppgtfs::gtfs::Shape;
 namespace pfaedle {
 namespace eval {
 
+// number of result buffers, threads are mapped to buffers by their OpenMP
+// thread number
+static const size_t EVAL_BUFFERS = 64;
+
+// max. number of trip GeoJSON files waiting to be written
+static const size_t EVAL_WRITE_QUEUE = 256;
+
 /*
- * Collects routing results for evaluation
+ * Collects routing results for evaluation. add() may be called from many
+ * threads at once, each thread collects into its own buffer. The per-trip
+ * GeoJSON files are written by a background thread.
  */
 class Collector {
  public:
   Collector(const std::string& evalOutPath, const std::vector<double>& dfBins)
+      : Collector(evalOutPath, dfBins, true) {}
+  Collector(const std::string& evalOutPath, const std::vector<double>& dfBins,
+            bool writeTrips)
       : _noOrigShp(0),
         _fdSum(0),
         _unmatchedSegSum(0),
         _unmatchedSegLengthSum(0),
         _evalOutPath(evalOutPath),
-        _dfBins(dfBins) {}
+        _dfBins(dfBins),
+        _bufs(EVAL_BUFFERS),
+        _writeTrips(writeTrips),
+        _writing(false),
+        _done(false) {}
+  ~Collector();
+
+  Collector(const Collector&) = delete;
+  Collector& operator=(const Collector&) = delete;
 
   // Add a shape found by our tool newS for a trip t with newly calculated
-  // station dist values with the old shape oldS
+  // station dist values with the old shape oldS, thread safe
   double add(const Trip* t, const Shape* oldS, const Shape& newS,
              const std::vector<double>& newDists);
 
+  // Wait for all trip files to be written and merge the results of all
+  // threads. Must be called after the last add() and before the results
+  // are read.
+  void finish();
+
   // Return the set of all Result objects
   const std::set<Result>& getResults() const;
 
@@ -63,9 +92,30 @@ class Collector {
                              std::vector<double>* dists);
 
  private:
+  // results collected by the threads mapped to this buffer
+  struct Buffer {
+    Buffer() : noOrigShp(0), unmatchedSegSum(0), unmatchedSegLengthSum(0) {}
+    std::mutex m;
+    std::set<Result> results;
+    std::set<Result> resultsAN;
+    std::set<Result> resultsAL;
+    size_t noOrigShp;
+    size_t unmatchedSegSum;
+    double unmatchedSegLengthSum;
+  };
+
+  // old and new segments of a trip, to be written to path
+  struct TripGeom {
+    std::string path;
+    std::vector<LINE> oldSegs;
+    std::vector<LINE> newSegs;
+  };
+
   std::set<Result> _results;
   std::set<Result> _resultsAN;
   std::set<Result> _resultsAL;
+
+  std::mutex _cacheM;
   std::map<const Shape*, std::map<std::string, double> > _dCache;
   std::map<const Shape*, std::map<std::string, std::pair<size_t, double> > >
       _dACache;
@@ -79,6 +129,23 @@ class Collector {
 
   std::vector<double> _dfBins;
 
+  std::vector<Buffer> _bufs;
+
+  bool _writeTrips;
+
+  // queue of trip files for the writer thread, which is started on the
+  // first queued file
+  std::mutex _writeM;
+  std::condition_variable _writeNew;
+  std::condition_variable _writeFree;
+  std::deque<TripGeom> _writeQueue;
+  std::thread _writer;
+  bool _writing;
+  bool _done;
+
+  void queueTrip(TripGeom geom);
+  void writeTrips();
+
   static std::pair<size_t, double> getDa(const std::vector<LINE>& a,
                                          const std::vector<LINE>& b);
 
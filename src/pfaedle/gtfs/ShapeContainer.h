@@ -5,12 +5,18 @@
 #ifndef PFAEDLE_GTFS_SHAPECONTAINER_H_
 #define PFAEDLE_GTFS_SHAPECONTAINER_H_
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
-#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <functional>
 #include <iostream>
-#include <set>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "ad/cppgtfs/gtfs/Shape.h"
 #include "ad/cppgtfs/gtfs/flat/Shape.h"
 #include "pfaedle/Def.h"
@@ -35,6 +41,29 @@ struct Shape {
   std::string id;
 };
 
+// number of append buffers of a shape container, threads are mapped to
+// buffers by their id
+static const size_t SHAPE_BUFFERS = 64;
+
+// shape points an append buffer holds before they are written to its file
+static const size_t SHAPE_BUFFER_RECS = 1 << 16;
+
+// a stored shape point, id and sequence number follow from its position
+struct ShapeRec {
+  double lat;
+  double lng;
+  double travelDist;
+};
+
+/*
+ * Holds the ids of all shapes of a feed and the points of the shapes added
+ * during matching, which are only needed again when the feed is written.
+ * The points are stored as fixed size binary records. Each thread appends
+ * to its own buffer, which is spilled to an unlinked temporary file when
+ * full. For writing, the files are mapped into memory.
+ *
+ * All methods except open() and nextStoragePt() are thread safe.
+ */
 template <typename T>
 class ShapeContainer {
  public:
@@ -55,12 +84,39 @@ class ShapeContainer {
   bool nextStoragePt(ad::cppgtfs::gtfs::flat::ShapePoint* ret);
 
  private:
-  std::set<std::string> _ids;
-  std::fstream _storage;
+  // points of the shapes added by the threads mapped to this buffer
+  struct AppendBuf {
+    AppendBuf() : fd(-1), written(0), map(0) {}
+    std::mutex m;
+    std::vector<ShapeRec> recs;
+    int fd;
+    // number of records already written to fd
+    size_t written;
+    const ShapeRec* map;
+  };
+
+  // location of the points of a stored shape
+  struct ShapeLoc {
+    std::string id;
+    size_t buf;
+    size_t first;
+    size_t size;
+  };
+
+  // marks ids without stored points, e.g. of shapes read from the input
+  static const size_t NO_LOC = -1;
+
+  mutable std::mutex _m;
+  // ids of all shapes, mapped to their position in _locs
+  std::unordered_map<std::string, size_t> _ids;
+  std::vector<ShapeLoc> _locs;
+  std::vector<AppendBuf> _bufs;
+
+  // read position, the current shape in _locs and the point in it
   size_t _ptr;
-  size_t _max;
-  std::string _curId;
-  std::stringstream _writeBuffer;
+  size_t _pt;
+
+  void flush(AppendBuf* buf);
 };
 
 #include "ShapeContainer.tpp"
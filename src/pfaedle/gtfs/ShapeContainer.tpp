@@ -6,36 +6,35 @@
 
 // ____________________________________________________________________________
 template <typename T>
-ShapeContainer<T>::ShapeContainer() {
-  std::string f = pfaedle::getTmpFName("", "");
-  _storage.open(f, std::fstream::in | std::fstream::out | std::fstream::trunc);
+const size_t ShapeContainer<T>::NO_LOC;
 
-  // immediately unlink
-  unlink(f.c_str());
-
-  if (!_storage.good()) {
-    std::cerr << "Could not open temporary file " << f
-              << std::endl;
-    exit(1);
-  }
-}
+// ____________________________________________________________________________
+template <typename T>
+ShapeContainer<T>::ShapeContainer() : _bufs(SHAPE_BUFFERS), _ptr(0), _pt(0) {}
 
 // ____________________________________________________________________________
 template <typename T>
 ShapeContainer<T>::~ShapeContainer() {
-  _storage.close();
+  for (auto& buf : _bufs) {
+    if (buf.map) {
+      munmap(const_cast<ShapeRec*>(buf.map), buf.written * sizeof(ShapeRec));
+    }
+    if (buf.fd >= 0) ::close(buf.fd);
+  }
 }
 
 // ____________________________________________________________________________
 template <typename T>
 T* ShapeContainer<T>::add(const T& ent) {
-  _ids.insert(ent.getId());
+  std::lock_guard<std::mutex> lock(_m);
+  _ids.insert({ent.getId(), NO_LOC});
   return reinterpret_cast<T*>(1);
 }
 
 // ____________________________________________________________________________
 template <typename T>
 bool ShapeContainer<T>::remove(const std::string& id) {
+  std::lock_guard<std::mutex> lock(_m);
   _ids.erase(id);
   return true;
 }
@@ -57,75 +56,136 @@ const T* ShapeContainer<T>::get(const std::string& id) const {
 // ____________________________________________________________________________
 template <typename T>
 bool ShapeContainer<T>::has(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(_m);
   return _ids.count(id);
 }
 
 // ____________________________________________________________________________
 template <typename T>
 size_t ShapeContainer<T>::size() const {
+  std::lock_guard<std::mutex> lock(_m);
   return _ids.size();
 }
 
 // ____________________________________________________________________________
 template <typename T>
 std::string ShapeContainer<T>::add(const ad::cppgtfs::gtfs::Shape& s) {
-  if (has(s.getId())) return s.getId();
-  _ids.insert(s.getId());
-
-  _writeBuffer << s.getId() << '\t' << s.getPoints().size();
-  _writeBuffer << std::setprecision(11);
-  for (auto p : s.getPoints()) {
-    _writeBuffer << " " << p.lat << " " << p.lng << " " << p.travelDist;
+  size_t b = std::hash<std::thread::id>()(std::this_thread::get_id()) %
+             _bufs.size();
+  AppendBuf& buf = _bufs[b];
+
+  // the buffer lock is taken first, so the records of this shape are
+  // appended exactly where its location says
+  std::lock_guard<std::mutex> bufLock(buf.m);
+  {
+    std::lock_guard<std::mutex> lock(_m);
+    if (_ids.count(s.getId())) return s.getId();
+    _ids[s.getId()] = _locs.size();
+    _locs.push_back(ShapeLoc{s.getId(), b, buf.written + buf.recs.size(),
+                             s.getPoints().size()});
   }
-  // entries are newline separated
-  _writeBuffer << '\n';
 
-  if (_writeBuffer.tellp() > 1000 * 5000) {
-    _storage << _writeBuffer.rdbuf();
-    _writeBuffer.clear();
+  for (const auto& p : s.getPoints()) {
+    buf.recs.push_back(ShapeRec{p.lat, p.lng, p.travelDist});
   }
 
+  if (buf.recs.size() >= SHAPE_BUFFER_RECS) flush(&buf);
+
   return s.getId();
 }
 
+// ____________________________________________________________________________
+template <typename T>
+void ShapeContainer<T>::flush(AppendBuf* buf) {
+  if (buf->recs.empty()) return;
+
+  if (buf->fd < 0) {
+    while (true) {
+      std::string f = pfaedle::getTmpFName("", "shapes");
+      buf->fd = ::open(f.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if (buf->fd >= 0) {
+        // immediately unlink
+        unlink(f.c_str());
+        break;
+      }
+      // another thread or process took this name
+      if (errno == EEXIST) continue;
+      std::cerr << "Could not open temporary file " << f << std::endl;
+      exit(1);
+    }
+  }
+
+  const char* data = reinterpret_cast<const char*>(buf->recs.data());
+  size_t left = buf->recs.size() * sizeof(ShapeRec);
+  while (left) {
+    ssize_t w = ::write(buf->fd, data, left);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) {
+      std::cerr << "Could not write shapes to temporary file: "
+                << strerror(errno) << std::endl;
+      exit(1);
+    }
+    data += w;
+    left -= w;
+  }
+
+  buf->written += buf->recs.size();
+  buf->recs.clear();
+}
+
 // ____________________________________________________________________________
 template <typename T>
 void ShapeContainer<T>::open() {
-  _storage << _writeBuffer.rdbuf();
-  _writeBuffer.clear();
+  for (auto& buf : _bufs) {
+    std::lock_guard<std::mutex> lock(buf.m);
+    if (buf.map) {
+      munmap(const_cast<ShapeRec*>(buf.map), buf.written * sizeof(ShapeRec));
+      buf.map = 0;
+    }
+
+    flush(&buf);
+    if (!buf.written) continue;
+
+    void* map = mmap(0, buf.written * sizeof(ShapeRec), PROT_READ, MAP_PRIVATE,
+                     buf.fd, 0);
+    if (map == MAP_FAILED) {
+      std::cerr << "Could not map temporary shape file: " << strerror(errno)
+                << std::endl;
+      exit(1);
+    }
+    madvise(map, buf.written * sizeof(ShapeRec), MADV_WILLNEED);
+    buf.map = reinterpret_cast<const ShapeRec*>(map);
+  }
 
   _ptr = 0;
-  _max = 0;
-  _storage.clear();
-  _storage.seekg(0, std::ios::beg);
+  _pt = 0;
 }
 
 // ____________________________________________________________________________
 template <typename T>
 bool ShapeContainer<T>::nextStoragePt(
     ad::cppgtfs::gtfs::flat::ShapePoint* ret) {
-  while (_storage.good() && !_storage.fail()) {
-    if (!_ptr) {
-      _storage >> _curId;
-      _storage >> _max;
-    }
+  // shapes are returned in the order they were added
+  while (_ptr < _locs.size()) {
+    const ShapeLoc& loc = _locs[_ptr];
 
-    if (!_storage.good() || _storage.fail()) return false;
-
-    _storage >> ret->lat;
-    _storage >> ret->lng;
-    _storage >> ret->travelDist;
-    ret->seq = _ptr + 1;
-    ret->id = _curId;
-
-    if (_ptr + 1 == _max)
-      _ptr = 0;
-    else
+    // skip removed shapes, and shapes stored again under the same id
+    if (_pt == loc.size ||
+        (!_pt && (!_ids.count(loc.id) || _ids.find(loc.id)->second != _ptr))) {
       _ptr++;
+      _pt = 0;
+      continue;
+    }
 
-    if (!_storage.good() || _storage.fail()) return false;
+    const ShapeRec& r = _bufs[loc.buf].map[loc.first + _pt];
+    ret->id = loc.id;
+    ret->lat = r.lat;
+    ret->lng = r.lng;
+    ret->travelDist = r.travelDist;
+    ret->seq = _pt + 1;
+    _pt++;
 
-    if (has(ret->id)) return true;
+    return true;
   }
 
   return false;
@@ -2,11 +2,33 @@
 // Chair of Algorithms and Data Structures.
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_num_procs() 1
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <utility>
+#include <vector>
 #include "ad/cppgtfs/Parser.h"
 #include "ad/cppgtfs/Writer.h"
 #include "ad/cppgtfs/gtfs/flat/Agency.h"
@@ -18,156 +40,232 @@ using ad::cppgtfs::Parser;
 using pfaedle::gtfs::Writer;
 using pfaedle::getTmpFName;
 
-// ____________________________________________________________________________
-bool Writer::write(gtfs::Feed* sourceFeed, const std::string& path) const {
-  std::ofstream fs;
-  std::ifstream is;
-  std::string gtfsPath(path);
-  std::string curFile;
-  std::string curFileTg;
-
-  curFile = getTmpFName(gtfsPath, "agency.txt");
-  curFileTg = gtfsPath + "/agency.txt";
-  fs.open(curFile.c_str());
-  if (!fs.good()) cannotWrite(curFile, curFileTg);
-  writeAgency(sourceFeed, &fs);
-  fs.close();
-  if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
-
-  curFile = getTmpFName(gtfsPath, "stops.txt");
-  curFileTg = gtfsPath + "/stops.txt";
-  fs.open(curFile.c_str());
-  if (!fs.good()) cannotWrite(curFile, curFileTg);
-  writeStops(sourceFeed, &fs);
-  fs.close();
-  if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
+namespace {
+
+/*
+ * Read buffer over a header string followed by a (mmap'ed) byte range,
+ * without copying either
+ */
+class ChunkInBuf : public std::streambuf {
+ public:
+  ChunkInBuf(const std::string& hdr, const char* begin, const char* end)
+      : _begin(begin), _end(end), _inHdr(true) {
+    char* h = const_cast<char*>(hdr.data());
+    setg(h, h, h + hdr.size());
+  }
 
-  curFile = getTmpFName(gtfsPath, "routes.txt");
-  curFileTg = gtfsPath + "/routes.txt";
-  fs.open(curFile.c_str());
-  if (!fs.good()) cannotWrite(curFile, curFileTg);
-  writeRoutes(sourceFeed, &fs);
-  fs.close();
-  if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
+ protected:
+  int_type underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (!_inHdr || _begin == _end) return traits_type::eof();
+    _inHdr = false;
+    char* b = const_cast<char*>(_begin);
+    setg(b, b, const_cast<char*>(_end));
+    return traits_type::to_int_type(*gptr());
+  }
 
-  is.open((sourceFeed->getPath() + "/calendar.txt").c_str());
-  if (is.good()) {
-    is.close();
-    curFile = getTmpFName(gtfsPath, "calendar.txt");
-    curFileTg = gtfsPath + "/calendar.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeCalendar(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+ private:
+  const char* _begin;
+  const char* _end;
+  bool _inHdr;
+};
+
+/*
+ * Write buffer appending to a string, which can be taken without a copy
+ */
+class StrOutBuf : public std::streambuf {
+ public:
+  std::string& str() { return _str; }
+
+ protected:
+  int_type overflow(int_type c) {
+    if (c != traits_type::eof()) _str += traits_type::to_char_type(c);
+    return c;
   }
 
-  is.open((sourceFeed->getPath() + "/calendar_dates.txt").c_str());
-  if (is.good()) {
-    is.close();
-    curFile = getTmpFName(gtfsPath, "calendar_dates.txt");
-    curFileTg = gtfsPath + "/calendar_dates.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeCalendarDates(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+  std::streamsize xsputn(const char* s, std::streamsize n) {
+    _str.append(s, n);
+    return n;
   }
 
-  is.open((sourceFeed->getPath() + "/transfers.txt").c_str());
-  if (is.good()) {
-    is.close();
-    curFile = getTmpFName(gtfsPath, "transfers.txt");
-    curFileTg = gtfsPath + "/transfers.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeTransfers(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+ private:
+  std::string _str;
+};
+
+}  // namespace
+
+// ____________________________________________________________________________
+bool Writer::write(gtfs::Feed* sourceFeed, const std::string& path) const {
+  // the files changed by pfaedle are written by their own threads, the
+  // stop times are additionally rewritten in parallel chunks
+  bool hasFreqs = false;
+  std::exception_ptr shapesExc, tripsExc;
+
+  std::thread shapes([&]() {
+    try {
+      writeFile(path, "shapes.txt",
+                [&](std::ostream* os) { writeShapes(sourceFeed, os); });
+    } catch (...) {
+      shapesExc = std::current_exception();
+    }
+  });
+
+  std::thread trips([&]() {
+    try {
+      writeFile(path, "trips.txt", [&](std::ostream* os) {
+        hasFreqs = writeTrips(sourceFeed, os);
+      });
+    } catch (...) {
+      tripsExc = std::current_exception();
+    }
+  });
+
+  try {
+    // unchanged files, and whether they are required
+    typedef bool (Writer::*WriteFn)(gtfs::Feed*, std::ostream*) const;
+    const std::vector<std::tuple<std::string, WriteFn, bool>> files = {
+        std::make_tuple("agency.txt", &Writer::writeAgency, true),
+        std::make_tuple("stops.txt", &Writer::writeStops, true),
+        std::make_tuple("routes.txt", &Writer::writeRoutes, true),
+        std::make_tuple("calendar.txt", &Writer::writeCalendar, false),
+        std::make_tuple("calendar_dates.txt", &Writer::writeCalendarDates,
+                        false),
+        std::make_tuple("transfers.txt", &Writer::writeTransfers, false),
+        std::make_tuple("fare_attributes.txt", &Writer::writeFares, false),
+        std::make_tuple("fare_rules.txt", &Writer::writeFareRules, false)};
+
+    for (const auto& file : files) {
+      const std::string& name = std::get<0>(file);
+      WriteFn fn = std::get<1>(file);
+      if (!std::get<2>(file) && !hasFile(sourceFeed, name)) continue;
+
+      if (_copyUnchanged && hasFile(sourceFeed, name)) {
+        copyFile(sourceFeed, path, name);
+      } else {
+        writeFile(path, name,
+                  [&](std::ostream* os) { (this->*fn)(sourceFeed, os); });
+      }
+    }
+
+    writeFile(path, "stop_times.txt",
+              [&](std::ostream* os) { writeStopTimes(sourceFeed, os); });
+  } catch (...) {
+    shapes.join();
+    trips.join();
+    throw;
   }
 
-  is.open((sourceFeed->getPath() + "/fare_attributes.txt").c_str());
-  if (is.good()) {
-    is.close();
-    curFile = getTmpFName(gtfsPath, "fare_attributes.txt");
-    curFileTg = gtfsPath + "/fare_attributes.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeFares(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+  shapes.join();
+  trips.join();
+  if (shapesExc) std::rethrow_exception(shapesExc);
+  if (tripsExc) std::rethrow_exception(tripsExc);
+
+  if (hasFreqs && hasFile(sourceFeed, "frequencies.txt")) {
+    if (_copyUnchanged) {
+      copyFile(sourceFeed, path, "frequencies.txt");
+    } else {
+      writeFile(path, "frequencies.txt", [&](std::ostream* os) {
+        writeFrequencies(sourceFeed, os);
+      });
+    }
   }
 
-  is.open((sourceFeed->getPath() + "/fare_rules.txt").c_str());
-  if (is.good()) {
-    is.close();
-    curFile = getTmpFName(gtfsPath, "fare_rules.txt");
-    curFileTg = gtfsPath + "/fare_rules.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeFareRules(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+  if (_copyUnchanged && hasFile(sourceFeed, "feed_info.txt")) {
+    copyFile(sourceFeed, path, "feed_info.txt");
+  } else if (!sourceFeed->getPublisherUrl().empty() &&
+             !sourceFeed->getPublisherName().empty()) {
+    writeFile(path, "feed_info.txt",
+              [&](std::ostream* os) { writeFeedInfo(sourceFeed, os); });
   }
 
-  is.close();
-  curFile = getTmpFName(gtfsPath, "shapes.txt");
-  curFileTg = gtfsPath + "/shapes.txt";
-  fs.open(curFile.c_str());
-  if (!fs.good()) cannotWrite(curFile, curFileTg);
-  writeShapes(sourceFeed, &fs);
-  fs.close();
-  if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
+  return true;
+}
+
+// ____________________________________________________________________________
+void Writer::writeFile(const std::string& path, const std::string& name,
+                       const std::function<void(std::ostream*)>& f) const {
+  std::string curFile = getTmpFName(path, name);
+  std::string curFileTg = path + "/" + name;
 
-  is.close();
-  curFile = getTmpFName(gtfsPath, "trips.txt");
-  curFileTg = gtfsPath + "/trips.txt";
-  fs.open(curFile.c_str());
+  std::ofstream fs(curFile.c_str());
   if (!fs.good()) cannotWrite(curFile, curFileTg);
-  bool hasFreqs = writeTrips(sourceFeed, &fs);
+  f(&fs);
   fs.close();
+  if (fs.fail()) cannotWrite(curFile, curFileTg);
   if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
+}
+
+// ____________________________________________________________________________
+bool Writer::hasFile(gtfs::Feed* f, const std::string& name) {
+  return access((f->getPath() + "/" + name).c_str(), R_OK) == 0;
+}
 
-  is.open((sourceFeed->getPath() + "/frequencies.txt").c_str());
-  if (hasFreqs && is.good()) {
-    is.close();
-    curFile = getTmpFName(gtfsPath, "frequencies.txt");
-    curFileTg = gtfsPath + "/frequencies.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeFrequencies(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+// ____________________________________________________________________________
+void Writer::copyFile(gtfs::Feed* f, const std::string& path,
+                      const std::string& name) const {
+  std::string src = f->getPath() + "/" + name;
+  std::string curFileTg = path + "/" + name;
+
+  int in = ::open(src.c_str(), O_RDONLY);
+  if (in < 0) cannotWrite(curFileTg);
+
+  struct stat st, tgSt;
+  if (fstat(in, &st)) {
+    ::close(in);
+    cannotWrite(curFileTg);
   }
 
-  is.close();
-  curFile = getTmpFName(gtfsPath, "stop_times.txt");
-  curFileTg = gtfsPath + "/stop_times.txt";
-  fs.open(curFile.c_str());
-  if (!fs.good()) cannotWrite(curFile, curFileTg);
-  writeStopTimes(sourceFeed, &fs);
-  fs.close();
-  if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
+  // in place, the file is already there
+  if (!stat(curFileTg.c_str(), &tgSt) && st.st_dev == tgSt.st_dev &&
+      st.st_ino == tgSt.st_ino) {
+    ::close(in);
+    return;
+  }
 
-  if (!sourceFeed->getPublisherUrl().empty() &&
-      !sourceFeed->getPublisherName().empty()) {
-    curFile = getTmpFName(gtfsPath, "feed_info.txt");
-    curFileTg = gtfsPath + "/feed_info.txt";
-    fs.open(curFile.c_str());
-    if (!fs.good()) cannotWrite(curFile, curFileTg);
-    writeFeedInfo(sourceFeed, &fs);
-    fs.close();
-    if (std::rename(curFile.c_str(), curFileTg.c_str()))
-      cannotWrite(curFileTg);
+  std::string curFile = getTmpFName(path, name);
+  int out = ::open(curFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out < 0) {
+    ::close(in);
+    cannotWrite(curFile, curFileTg);
   }
 
-  return true;
+  // let the kernel copy the file, fall back to sendfile and then to a plain
+  // read/write loop if the file systems do not support it
+  size_t left = st.st_size;
+  int method = 0;
+  std::vector<char> buf;
+  while (left) {
+    ssize_t n = -1;
+#ifdef SYS_copy_file_range
+    if (method == 0) n = syscall(SYS_copy_file_range, in, 0, out, 0, left, 0);
+#else
+    if (method == 0) method = 1;
+#endif
+    if (method == 1) n = sendfile(out, in, 0, left);
+    if (method == 2) {
+      buf.resize(1 << 20);
+      n = ::read(in, buf.data(), std::min(left, buf.size()));
+      if (n > 0 && ::write(out, buf.data(), n) != n) n = -1;
+    }
+
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && method < 2 && (errno == ENOSYS || errno == EXDEV ||
+                                errno == EINVAL || errno == EOPNOTSUPP)) {
+      method++;
+      continue;
+    }
+    if (n <= 0) {
+      ::close(in);
+      ::close(out);
+      ::unlink(curFile.c_str());
+      cannotWrite(curFile, curFileTg);
+    }
+    left -= n;
+  }
+
+  ::close(in);
+  if (::close(out)) cannotWrite(curFile, curFileTg);
+  if (std::rename(curFile.c_str(), curFileTg.c_str())) cannotWrite(curFileTg);
 }
 
 // ____________________________________________________________________________
@@ -461,10 +559,162 @@ bool Writer::writeTrips(gtfs::Feed* sourceFeed, std::ostream* os) const {
 
 // ____________________________________________________________________________
 bool Writer::writeStopTimes(gtfs::Feed* sourceFeed, std::ostream* os) const {
-  std::ifstream fs;
-  fs.open((sourceFeed->getPath() + "/stop_times.txt").c_str());
+  const StopTimeDists& dists = getStopTimeDists(sourceFeed);
+
+  std::string src = sourceFeed->getPath() + "/stop_times.txt";
+  int fd = ::open(src.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+    if (fd >= 0) ::close(fd);
+    std::ifstream fs(src.c_str());
+    return writeStopTimes(dists, &fs, os);
+  }
 
-  CsvParser csvp(&fs);
+  size_t size = st.st_size;
+  void* map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::ifstream fs(src.c_str());
+    return writeStopTimes(dists, &fs, os);
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+  const char* data = reinterpret_cast<const char*>(map);
+
+  // cut the file into chunks at line ends outside of quoted fields, the
+  // first chunk is the header
+  std::vector<size_t> offs{0};
+  bool quoted = false;
+  size_t i = 0;
+  while (true) {
+    size_t target = offs.size() == 1 ? 0 : offs.back() + STOP_TIMES_CHUNK;
+    if (target >= size) break;
+
+    while (i < target) {
+      const char* q =
+          reinterpret_cast<const char*>(memchr(data + i, '"', target - i));
+      if (!q) {
+        i = target;
+        break;
+      }
+      quoted = !quoted;
+      i = q - data + 1;
+    }
+
+    while (i < size && (data[i] != '\n' || quoted)) {
+      if (data[i] == '"') quoted = !quoted;
+      i++;
+    }
+    if (i + 1 >= size) break;
+    offs.push_back(++i);
+  }
+  offs.push_back(size);
+
+  std::string hdr(data, offs[1]);
+  if (hdr.back() != '\n') hdr += '\n';
+
+  // each chunk is parsed and written together with the header, which is
+  // dropped again from all but the first chunk. The chunks in flight are
+  // limited by a memory budget for their output.
+  size_t chunks = std::max<size_t>(offs.size() - 2, 1);
+  size_t inFlight = std::max<size_t>(1, STOP_TIMES_BUDGET / STOP_TIMES_CHUNK);
+  size_t threads = std::max<size_t>(1, omp_get_num_procs());
+  threads = std::min(threads, inFlight);
+  std::exception_ptr exc;
+
+  for (size_t w = 0; w < chunks; w += inFlight) {
+    size_t n = std::min(inFlight, chunks - w);
+    std::vector<std::string> out(n);
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+    for (size_t k = 0; k < n; k++) {
+      try {
+        const char* begin = data + size;
+        const char* end = data + size;
+        if (offs.size() > 2) {
+          begin = data + offs[w + k + 1];
+          end = data + offs[w + k + 2];
+        }
+        ChunkInBuf inBuf(hdr, begin, end);
+        std::istream is(&inBuf);
+        StrOutBuf outBuf;
+        std::ostream os(&outBuf);
+        writeStopTimes(dists, &is, &os);
+        os.flush();
+        out[k].swap(outBuf.str());
+      } catch (...) {
+#pragma omp critical
+        exc = std::current_exception();
+      }
+    }
+
+    if (exc) {
+      munmap(map, size);
+      std::rethrow_exception(exc);
+    }
+
+    for (size_t k = 0; k < n; k++) {
+      size_t start = 0;
+      if (w + k) start = out[k].find('\n') + 1;
+      os->write(out[k].data() + start, out[k].size() - start);
+      std::string().swap(out[k]);
+    }
+  }
+
+  munmap(map, size);
+  return true;
+}
+
+// ____________________________________________________________________________
+Writer::StopTimeDists Writer::getStopTimeDists(gtfs::Feed* f) {
+  StopTimeDists ret;
+  ret.reserve(f->getTrips().size());
+
+  for (const auto& t : f->getTrips()) {
+    const auto& sts = t.getStopTimes();
+    if (sts.empty()) continue;
+
+    // stop times are ordered by their sequence number
+    TripDists& td = ret[t.getId()];
+    td.minSeq = sts.begin()->getSeq();
+    size_t range = (--sts.end())->getSeq() - td.minSeq + 1;
+
+    if (range <= 4 * sts.size() + 16) {
+      td.dense.assign(range, std::numeric_limits<float>::quiet_NaN());
+      for (const auto& st : sts) {
+        td.dense[st.getSeq() - td.minSeq] = st.getShapeDistanceTravelled();
+      }
+    } else {
+      for (const auto& st : sts) {
+        td.sparse.push_back({st.getSeq(), st.getShapeDistanceTravelled()});
+      }
+    }
+  }
+
+  return ret;
+}
+
+// ____________________________________________________________________________
+bool Writer::getDist(const TripDists& td, uint32_t seq, float* dist) {
+  if (td.dense.size()) {
+    if (seq < td.minSeq || seq - td.minSeq >= td.dense.size()) return false;
+    *dist = td.dense[seq - td.minSeq];
+    return !std::isnan(*dist);
+  }
+
+  auto i = std::lower_bound(
+      td.sparse.begin(), td.sparse.end(), seq,
+      [](const std::pair<uint32_t, float>& a, uint32_t b) {
+        return a.first < b;
+      });
+  if (i == td.sparse.end() || i->first != seq) return false;
+  *dist = i->second;
+  return true;
+}
+
+// ____________________________________________________________________________
+bool Writer::writeStopTimes(const StopTimeDists& dists, std::istream* is,
+                            std::ostream* os) const {
+  CsvParser csvp(is);
   Parser p;
   ad::cppgtfs::Writer w;
 
@@ -474,23 +724,25 @@ bool Writer::writeStopTimes(gtfs::Feed* sourceFeed, std::ostream* os) const {
   ad::cppgtfs::gtfs::flat::StopTime st;
   auto flds = Parser::getStopTimeFlds(&csvp);
 
+  // the input does not have to be sorted, a trip change only costs a lookup
   std::string curTripId;
-  Trip* cur = 0;
+  const TripDists* cur = 0;
+  float dist;
 
   while (p.nextStopTime(&csvp, &st, flds)) {
-    // we may have changed to distance field
     if (curTripId != st.trip) {
-      cur = sourceFeed->getTrips().get(st.trip);
+      auto i = dists.find(st.trip);
+      cur = i == dists.end() ? 0 : &i->second;
       curTripId = st.trip;
     }
-    for (const auto& stN : cur->getStopTimes()) {
-      if (stN.getSeq() == st.sequence)
-        st.shapeDistTravelled = stN.getShapeDistanceTravelled();
+
+    // we may have changed to distance field
+    if (cur && getDist(*cur, st.sequence, &dist)) {
+      st.shapeDistTravelled = dist;
     }
 
     w.writeStopTime(st, &csvw);
   }
-  fs.close();
 
   return true;
 }
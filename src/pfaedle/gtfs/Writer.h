@@ -5,20 +5,64 @@
 #ifndef PFAEDLE_GTFS_WRITER_H_
 #define PFAEDLE_GTFS_WRITER_H_
 
+#include <functional>
+#include <iostream>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "ad/cppgtfs/Writer.h"
 #include "Feed.h"
 
 namespace pfaedle {
 namespace gtfs {
 
+// bytes of stop_times.txt rewritten per parallel chunk
+static const size_t STOP_TIMES_CHUNK = 1 << 24;
+
+// max. bytes of rewritten stop_times.txt chunks held in memory at once
+static const size_t STOP_TIMES_BUDGET = 1 << 29;
+
+/*
+ * Writes a feed to a directory. Only shapes, trips and stop times are
+ * changed by pfaedle, these are written concurrently. All other files are
+ * either rewritten from the source feed, or copied byte-for-byte.
+ */
 class Writer {
  public:
-  Writer() {}
+  Writer() : Writer(false) {}
+  explicit Writer(bool copyUnchanged) : _copyUnchanged(copyUnchanged) {}
 
   bool write(Feed* sourceFeed, const std::string& path) const;
 
  private:
+  // shape_dist_traveled of the stop times of a trip by sequence number,
+  // in a dense array starting at minSeq (NaN for unused numbers) or, if
+  // the numbers are too sparse, in a sorted list
+  struct TripDists {
+    uint32_t minSeq;
+    std::vector<float> dense;
+    std::vector<std::pair<uint32_t, float>> sparse;
+  };
+
+  typedef std::unordered_map<std::string, TripDists> StopTimeDists;
+
+  bool _copyUnchanged;
+
+  static StopTimeDists getStopTimeDists(Feed* f);
+  static bool getDist(const TripDists& td, uint32_t seq, float* dist);
+
+  // write file name to path via a temporary file, the content is written
+  // by f
+  void writeFile(const std::string& path, const std::string& name,
+                 const std::function<void(std::ostream*)>& f) const;
+
+  // copy file name of the source feed to path without parsing it
+  void copyFile(Feed* f, const std::string& path,
+                const std::string& name) const;
+
+  static bool hasFile(Feed* f, const std::string& name);
+
   bool writeFeedInfo(Feed* f, std::ostream* os) const;
   bool writeAgency(Feed* f, std::ostream* os) const;
   bool writeStops(Feed* f, std::ostream* os) const;
@@ -32,6 +76,8 @@ class Writer {
   bool writeShapes(Feed* f, std::ostream* os) const;
   bool writeTrips(Feed* f, std::ostream* os) const;
   bool writeStopTimes(Feed* f, std::ostream* os) const;
+  bool writeStopTimes(const StopTimeDists& dists, std::istream* is,
+                      std::ostream* os) const;
 
   static void cannotWrite(const std::string& file, const std::string& file2);
   static void cannotWrite(const std::string& file);
@@ -0,0 +1,733 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pfaedle/Def.h"
+#include "pfaedle/osm/GraphCache.h"
+#include "pfaedle/trgraph/StatGroup.h"
+#include "util/log/Log.h"
+
+using pfaedle::osm::BBoxIdx;
+using pfaedle::osm::DeepAttrLst;
+using pfaedle::osm::GraphCache;
+using pfaedle::osm::MultAttrMap;
+using pfaedle::osm::OsmReadOpts;
+using pfaedle::osm::Restrictor;
+using pfaedle::osm::RulePair;
+using pfaedle::osm::Rules;
+using pfaedle::trgraph::Component;
+using pfaedle::trgraph::Edge;
+using pfaedle::trgraph::EdgePL;
+using pfaedle::trgraph::Graph;
+using pfaedle::trgraph::Node;
+using pfaedle::trgraph::NodePL;
+using pfaedle::trgraph::Normalizer;
+using pfaedle::trgraph::StatGroup;
+using pfaedle::trgraph::StatInfo;
+using pfaedle::trgraph::TransitEdgeLine;
+using ad::cppgtfs::gtfs::Stop;
+
+namespace {
+
+const char MAGIC[8] = {'P', 'F', 'G', 'R', 'A', 'P', 'H', 0};
+const uint64_t FNV_OFFS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// restriction rules may still point to edges deleted during graph
+// construction, these are mapped to an edge address that never matches
+const char DELETED_EDGE = 0;
+
+// unmaps a mapped snapshot on scope exit
+struct MapGuard {
+  void* map;
+  size_t size;
+  ~MapGuard() { munmap(map, size); }
+};
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t pad;
+  uint64_t key;
+  uint64_t size;
+  uint64_t hash;
+};
+
+// _____________________________________________________________________________
+inline uint64_t fnv(const char* b, size_t n, uint64_t h) {
+  for (size_t i = 0; i < n; i++) {
+    h ^= static_cast<unsigned char>(b[i]);
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+/*
+ * Buffered binary writer which keeps track of the size and hash of all
+ * bytes written so far
+ */
+class SnapshotWriter {
+ public:
+  explicit SnapshotWriter(std::ofstream* os)
+      : _os(os), _size(0), _hash(FNV_OFFS) {}
+  ~SnapshotWriter() { flush(); }
+
+  template <typename T>
+  void put(const T& v) {
+    putBytes(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  void putStr(const std::string& s) {
+    put<uint32_t>(s.size());
+    putBytes(s.c_str(), s.size());
+  }
+
+  void putBytes(const char* b, size_t n) {
+    _buf.append(b, n);
+    _size += n;
+    _hash = fnv(b, n, _hash);
+    if (_buf.size() > (1 << 20)) flush();
+  }
+
+  void flush() {
+    _os->write(_buf.c_str(), _buf.size());
+    _buf.clear();
+  }
+
+  uint64_t size() const { return _size; }
+  uint64_t hash() const { return _hash; }
+
+ private:
+  std::ofstream* _os;
+  std::string _buf;
+  uint64_t _size;
+  uint64_t _hash;
+};
+
+/*
+ * Reader over a (mmap'ed) snapshot buffer
+ */
+class SnapshotReader {
+ public:
+  SnapshotReader(const char* buf, size_t size) : _c(buf), _end(buf + size) {}
+
+  template <typename T>
+  T get() {
+    T ret;
+    check(sizeof(T));
+    memcpy(&ret, _c, sizeof(T));
+    _c += sizeof(T);
+    return ret;
+  }
+
+  std::string getStr() {
+    uint32_t n = get<uint32_t>();
+    check(n);
+    std::string ret(_c, n);
+    _c += n;
+    return ret;
+  }
+
+  void skip(size_t n) {
+    check(n);
+    _c += n;
+  }
+
+  void skipStr() { skip(get<uint32_t>()); }
+
+ private:
+  const char* _c;
+  const char* _end;
+
+  void check(size_t n) const {
+    if (static_cast<size_t>(_end - _c) < n)
+      throw std::runtime_error("graph snapshot is truncated");
+  }
+};
+
+// _____________________________________________________________________________
+void fpAttrs(std::ostream* os, const MultAttrMap& m) {
+  std::map<std::string, std::map<std::string, uint64_t>> sorted(m.begin(),
+                                                                m.end());
+  *os << sorted.size() << '|';
+  for (const auto& kv : sorted) {
+    *os << kv.first << '|' << kv.second.size() << '|';
+    for (const auto& val : kv.second)
+      *os << val.first << '|' << val.second << '|';
+  }
+}
+
+// _____________________________________________________________________________
+void fpDeep(std::ostream* os, const DeepAttrLst& l) {
+  *os << l.size() << '|';
+  for (const auto& r : l) {
+    *os << r.attr << '|' << r.relRule.kv.first << '|' << r.relRule.kv.second
+        << '|' << r.relRule.flags.size() << '|';
+    for (const auto& f : r.relRule.flags) *os << f << '|';
+  }
+}
+
+// _____________________________________________________________________________
+void fpStrs(std::ostream* os, const std::vector<std::string>& l) {
+  *os << l.size() << '|';
+  for (const auto& s : l) *os << s << '|';
+}
+
+// _____________________________________________________________________________
+void fpNorm(std::ostream* os, const Normalizer& n) {
+  *os << n.getRules().size() << '|';
+  for (const auto& r : n.getRules()) *os << r.first << '|' << r.second << '|';
+}
+
+// _____________________________________________________________________________
+void writeRules(SnapshotWriter* w, const Rules& rules,
+                const std::unordered_map<const Node*, uint32_t>& nids,
+                const std::unordered_map<const Edge*, uint32_t>& eids) {
+  std::vector<std::pair<uint32_t, const std::vector<RulePair>*>> vias;
+  for (const auto& kv : rules) {
+    auto i = nids.find(kv.first);
+    if (i == nids.end()) continue;  // via node was deleted
+    vias.push_back({i->second, &kv.second});
+  }
+
+  // edge ids are shifted by 2: 0 is the null edge, 1 a deleted edge
+  w->put<uint32_t>(vias.size());
+  for (const auto& via : vias) {
+    w->put<uint32_t>(via.first);
+    w->put<uint32_t>(via.second->size());
+    for (const auto& r : *via.second) {
+      for (const Edge* e : {r.first, r.second}) {
+        if (!e) {
+          w->put<uint32_t>(0);
+        } else if (!eids.count(e)) {
+          w->put<uint32_t>(1);
+        } else {
+          w->put<uint32_t>(eids.find(e)->second + 2);
+        }
+      }
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void readRules(SnapshotReader* r, const std::vector<Node*>& nds,
+               const std::vector<Edge*>& edgs, bool pos, Restrictor* res) {
+  uint32_t nVias = r->get<uint32_t>();
+  for (uint32_t i = 0; i < nVias; i++) {
+    const Node* via = nds.at(r->get<uint32_t>());
+    uint32_t nRules = r->get<uint32_t>();
+    for (uint32_t j = 0; j < nRules; j++) {
+      const Edge* e[2];
+      for (size_t k = 0; k < 2; k++) {
+        uint32_t id = r->get<uint32_t>();
+        if (id == 0) {
+          e[k] = 0;
+        } else if (id == 1) {
+          e[k] = reinterpret_cast<const Edge*>(&DELETED_EDGE);
+        } else {
+          e[k] = edgs.at(id - 2);
+        }
+      }
+      res->addRule(via, RulePair(e[0], e[1]), pos);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void checkIdx(uint64_t id, uint64_t size) {
+  if (id >= size) throw std::runtime_error("graph snapshot index out of range");
+}
+
+// _____________________________________________________________________________
+void validateRules(SnapshotReader* r, uint32_t nNds, uint32_t nEdgs) {
+  uint32_t nVias = r->get<uint32_t>();
+  for (uint32_t i = 0; i < nVias; i++) {
+    checkIdx(r->get<uint32_t>(), nNds);
+    uint32_t nRules = r->get<uint32_t>();
+    for (uint32_t j = 0; j < 2 * nRules; j++) {
+      uint32_t id = r->get<uint32_t>();
+      if (id > 1) checkIdx(id - 2, nEdgs);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void validate(SnapshotReader r,
+              const std::unordered_map<std::string, const Stop*>& stops) {
+  // walks the snapshot exactly like GraphCache::read(), without building
+  // anything, and throws on everything read() could fail on
+  uint32_t nComps = r.get<uint32_t>();
+  r.skip(nComps * sizeof(uint8_t));
+
+  uint32_t nGrps = r.get<uint32_t>();
+  for (uint32_t g = 0; g < nGrps; g++) {
+    uint32_t nStops = r.get<uint32_t>();
+    for (uint32_t i = 0; i < nStops; i++) {
+      if (!stops.count(r.getStr()))
+        throw std::runtime_error("graph snapshot references unknown stop");
+    }
+  }
+
+  uint32_t nLines = r.get<uint32_t>();
+  for (uint32_t l = 0; l < nLines; l++) {
+    r.skipStr();
+    r.skipStr();
+    r.skipStr();
+  }
+
+  uint32_t nNds = r.get<uint32_t>();
+  for (uint32_t n = 0; n < nNds; n++) {
+    r.skip(2 * sizeof(double));
+    uint32_t cid = r.get<uint32_t>();
+    if (cid) checkIdx(cid - 1, nComps);
+    if (r.get<uint8_t>() == 1) {
+      r.skipStr();
+      r.skipStr();
+      r.skip(sizeof(uint8_t));
+      uint32_t nAlt = r.get<uint32_t>();
+      for (uint32_t i = 0; i < nAlt; i++) r.skipStr();
+      uint32_t gid = r.get<uint32_t>();
+      if (gid) checkIdx(gid - 1, nGrps);
+#ifdef PFAEDLE_STATION_IDS
+      r.skipStr();
+#endif
+    }
+  }
+
+  for (uint32_t g = 0; g < nGrps; g++) {
+    uint32_t n = r.get<uint32_t>();
+    for (uint32_t i = 0; i < n; i++) checkIdx(r.get<uint32_t>(), nNds);
+  }
+
+  uint32_t nEdgs = r.get<uint32_t>();
+  for (uint32_t e = 0; e < nEdgs; e++) {
+    checkIdx(r.get<uint32_t>(), nNds);
+    checkIdx(r.get<uint32_t>(), nNds);
+    r.skip(sizeof(float) + 4 * sizeof(uint8_t));
+    uint32_t nPts = r.get<uint32_t>();
+    r.skip(static_cast<size_t>(nPts) * 2 * sizeof(double));
+    uint32_t n = r.get<uint32_t>();
+    for (uint32_t i = 0; i < n; i++) checkIdx(r.get<uint32_t>(), nLines);
+  }
+
+  validateRules(&r, nNds, nEdgs);
+  validateRules(&r, nNds, nEdgs);
+
+  uint32_t nFs = r.get<uint32_t>();
+  for (uint32_t i = 0; i < nFs; i++) {
+    r.skipStr();
+    uint32_t nid = r.get<uint32_t>();
+    if (nid) checkIdx(nid - 1, nNds);
+  }
+}
+
+}  // namespace
+
+// _____________________________________________________________________________
+GraphCache::GraphCache(const std::string& dir) : _dir(dir) {}
+
+// _____________________________________________________________________________
+std::string GraphCache::getPath(uint64_t key) const {
+  std::stringstream ss;
+  ss << _dir;
+  if (_dir.size() && _dir.back() != '/') ss << "/";
+  ss << "pfaedle-graph-" << std::hex << std::setw(16) << std::setfill('0')
+     << key << ".bin";
+  return ss.str();
+}
+
+// _____________________________________________________________________________
+uint64_t GraphCache::hashOsm(const std::string& osmPath) {
+  uint64_t h = FNV_OFFS;
+
+  // an unreadable file is reported later by the OSM reader
+  std::ifstream is(osmPath, std::ios::binary);
+  std::vector<char> buf(1 << 20);
+  while (is) {
+    is.read(&buf[0], buf.size());
+    h = fnv(&buf[0], is.gcount(), h);
+  }
+
+  return h;
+}
+
+// _____________________________________________________________________________
+uint64_t GraphCache::getKey(uint64_t osmHash, const OsmReadOpts& opts,
+                            const BBoxIdx& box, double gridSize,
+                            const router::FeedStops& fs) {
+  std::stringstream ss;
+  ss << std::setprecision(17) << VERSION << '|' << PFAEDLE_PRECISION_STR
+     << '|';
+
+  // read options
+  fpAttrs(&ss, opts.noHupFilter);
+  fpAttrs(&ss, opts.keepFilter);
+  for (size_t i = 0; i < 8; i++) fpAttrs(&ss, opts.levelFilters[i]);
+  fpAttrs(&ss, opts.dropFilter);
+  fpAttrs(&ss, opts.oneWayFilter);
+  fpAttrs(&ss, opts.oneWayFilterRev);
+  fpAttrs(&ss, opts.twoWayFilter);
+  fpAttrs(&ss, opts.stationFilter);
+  fpAttrs(&ss, opts.stationBlockerFilter);
+  fpAttrs(&ss, opts.restrPosRestr);
+  fpAttrs(&ss, opts.restrNegRestr);
+  fpAttrs(&ss, opts.noRestrFilter);
+
+  ss << opts.statGroupNAttrRules.size() << '|';
+  for (const auto& r : opts.statGroupNAttrRules) {
+    fpDeep(&ss, DeepAttrLst{r.attr});
+    ss << r.maxDist << '|';
+  }
+
+  fpNorm(&ss, opts.statNormzer);
+  fpNorm(&ss, opts.lineNormzer);
+  fpNorm(&ss, opts.trackNormzer);
+  fpNorm(&ss, opts.idNormzer);
+
+  fpStrs(&ss, opts.relLinerules.sNameRule);
+  fpStrs(&ss, opts.relLinerules.fromNameRule);
+  fpStrs(&ss, opts.relLinerules.toNameRule);
+
+  fpDeep(&ss, opts.statAttrRules.nameRule);
+  fpDeep(&ss, opts.statAttrRules.platformRule);
+  fpDeep(&ss, opts.statAttrRules.idRule);
+  fpDeep(&ss, opts.edgePlatformRules);
+
+  ss << static_cast<int>(opts.maxSnapLevel) << '|' << opts.maxAngleSnapReach
+     << '|' << opts.maxSnapFallbackHeurDistance << '|'
+     << opts.maxBlockDistance << '|' << opts.maxOsmStationDistance << '|'
+     << opts.fullTurnAngle << '|';
+  for (auto d : opts.maxSnapDistances) ss << d << '|';
+  ss << '|';
+  for (size_t i = 0; i < 7; i++) ss << opts.levelSnapPunishFac[i] << '|';
+
+  // bounding box and grid
+  for (const auto& b : box.getLeafs()) {
+    ss << b.getLowerLeft().getX() << '|' << b.getLowerLeft().getY() << '|'
+       << b.getUpperRight().getX() << '|' << b.getUpperRight().getY() << '|';
+  }
+  ss << gridSize << '|';
+
+  // feed stops, they are snapped into the graph
+  std::map<std::string, const Stop*> stops;
+  for (const auto& kv : fs) stops[kv.first->getId()] = kv.first;
+  for (const auto& kv : stops) {
+    const Stop* s = kv.second;
+    ss << s->getId() << '|' << s->getName() << '|' << s->getPlatformCode()
+       << '|' << s->getLat() << '|' << s->getLng() << '|'
+       << (s->getParentStation() ? s->getParentStation()->getId() : "")
+       << '|';
+  }
+
+  const std::string& fp = ss.str();
+  return fnv(fp.c_str(), fp.size(), osmHash);
+}
+
+// _____________________________________________________________________________
+void GraphCache::write(uint64_t key, const Graph& g,
+                       const router::FeedStops& fs,
+                       const Restrictor& res) const {
+  std::string path = getPath(key);
+  std::string tmpPath = getTmpFName(_dir, "graph");
+
+  std::ofstream os(tmpPath, std::ios::binary);
+  if (!os.good()) {
+    throw std::runtime_error("Could not open " + tmpPath + " for writing");
+  }
+
+  SnapshotHeader head;
+  memset(&head, 0, sizeof(head));
+  memcpy(head.magic, MAGIC, sizeof(MAGIC));
+  head.version = VERSION;
+  head.key = key;
+  os.write(reinterpret_cast<const char*>(&head), sizeof(head));
+
+  std::unordered_map<const Node*, uint32_t> nids;
+  std::unordered_map<const Edge*, uint32_t> eids;
+  std::unordered_map<const Component*, uint32_t> cids;
+  std::unordered_map<const StatGroup*, uint32_t> gids;
+  std::unordered_map<const TransitEdgeLine*, uint32_t> lids;
+  std::vector<const Component*> comps;
+  std::vector<const StatGroup*> grps;
+  std::vector<const TransitEdgeLine*> lines;
+
+  for (const auto* n : g.getNds()) {
+    uint32_t nid = nids.size();
+    nids[n] = nid;
+    const Component* c = n->pl().getComp();
+    if (c && !cids.count(c)) {
+      cids[c] = comps.size();
+      comps.push_back(c);
+    }
+    const StatInfo* si = n->pl().getSI();
+    if (si && si->getGroup() && !gids.count(si->getGroup())) {
+      gids[si->getGroup()] = grps.size();
+      grps.push_back(si->getGroup());
+    }
+    for (const auto* e : n->getAdjListOut()) {
+      uint32_t eid = eids.size();
+      eids[e] = eid;
+      for (const auto* l : e->pl().getLines()) {
+        if (lids.count(l)) continue;
+        lids[l] = lines.size();
+        lines.push_back(l);
+      }
+    }
+  }
+
+  {
+    SnapshotWriter w(&os);
+
+    w.put<uint32_t>(comps.size());
+    for (const auto* c : comps) w.put<uint8_t>(c->minEdgeLvl);
+
+    w.put<uint32_t>(grps.size());
+    for (const auto* grp : grps) {
+      w.put<uint32_t>(grp->getStops().size());
+      for (const auto* s : grp->getStops()) w.putStr(s->getId());
+    }
+
+    w.put<uint32_t>(lines.size());
+    for (const auto* l : lines) {
+      w.putStr(l->fromStr);
+      w.putStr(l->toStr);
+      w.putStr(l->shortName);
+    }
+
+    w.put<uint32_t>(nids.size());
+    for (const auto* n : g.getNds()) {
+      const NodePL& pl = n->pl();
+      w.put<double>(pl.getGeom()->getX());
+      w.put<double>(pl.getGeom()->getY());
+      w.put<uint32_t>(pl.getComp() ? cids[pl.getComp()] + 1 : 0);
+
+      if (pl.isBlocker()) {
+        w.put<uint8_t>(2);
+      } else if (pl.getSI()) {
+        const StatInfo* si = pl.getSI();
+        w.put<uint8_t>(1);
+        w.putStr(si->getName());
+        w.putStr(si->getTrack());
+        w.put<uint8_t>(si->isFromOsm());
+        w.put<uint32_t>(si->getAltNames().size());
+        for (const auto& an : si->getAltNames()) w.putStr(an);
+        w.put<uint32_t>(si->getGroup() ? gids[si->getGroup()] + 1 : 0);
+#ifdef PFAEDLE_STATION_IDS
+        w.putStr(si->getId());
+#endif
+      } else {
+        w.put<uint8_t>(0);
+      }
+    }
+
+    // group nodes
+    for (const auto* grp : grps) {
+      w.put<uint32_t>(grp->getNodes().size());
+      for (const auto* n : grp->getNodes()) w.put<uint32_t>(nids.at(n));
+    }
+
+    w.put<uint32_t>(eids.size());
+    for (const auto* n : g.getNds()) {
+      for (const auto* e : n->getAdjListOut()) {
+        const EdgePL& pl = e->pl();
+        w.put<uint32_t>(nids[e->getFrom()]);
+        w.put<uint32_t>(nids[e->getTo()]);
+        w.put<float>(pl.getLength());
+        w.put<uint8_t>(pl.oneWay());
+        w.put<uint8_t>(pl.isRestricted());
+        w.put<uint8_t>(pl.isRev());
+        w.put<uint8_t>(pl.lvl());
+        w.put<uint32_t>(pl.getGeom()->size());
+        for (const auto& p : *pl.getGeom()) {
+          w.put<double>(p.getX());
+          w.put<double>(p.getY());
+        }
+        w.put<uint32_t>(pl.getLines().size());
+        for (const auto* l : pl.getLines()) w.put<uint32_t>(lids[l]);
+      }
+    }
+
+    writeRules(&w, res.getPosRules(), nids, eids);
+    writeRules(&w, res.getNegRules(), nids, eids);
+
+    w.put<uint32_t>(fs.size());
+    for (const auto& kv : fs) {
+      w.putStr(kv.first->getId());
+      w.put<uint32_t>(kv.second ? nids.at(kv.second) + 1 : 0);
+    }
+
+    w.flush();
+    head.size = w.size();
+    head.hash = w.hash();
+  }
+
+  os.seekp(0);
+  os.write(reinterpret_cast<const char*>(&head), sizeof(head));
+  os.close();
+
+  if (!os.good() || std::rename(tmpPath.c_str(), path.c_str())) {
+    std::remove(tmpPath.c_str());
+    throw std::runtime_error("Could not write graph snapshot " + path);
+  }
+}
+
+// _____________________________________________________________________________
+bool GraphCache::read(uint64_t key, Graph* g, router::FeedStops* fs,
+                      Restrictor* res) const {
+  std::string path = getPath(key);
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) ||
+      static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void* map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  MapGuard guard{map, size};
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  const char* buf = reinterpret_cast<const char*>(map);
+  SnapshotHeader head;
+  memcpy(&head, buf, sizeof(head));
+  const char* payload = buf + sizeof(head);
+
+  if (memcmp(head.magic, MAGIC, sizeof(MAGIC)) || head.version != VERSION ||
+      head.key != key || head.size != size - sizeof(head) ||
+      fnv(payload, head.size, FNV_OFFS) != head.hash) {
+    LOG(WARN) << "Ignoring invalid graph snapshot " << path;
+    return false;
+  }
+
+  std::unordered_map<std::string, const Stop*> stops;
+  for (const auto& kv : *fs) stops[kv.first->getId()] = kv.first;
+
+  SnapshotReader r(payload, head.size);
+
+  // nothing below may fail once g has been touched, a half-read graph
+  // could not be cleaned up
+  try {
+    validate(r, stops);
+  } catch (const std::runtime_error& ex) {
+    LOG(WARN) << "Ignoring invalid graph snapshot " << path << ": "
+              << ex.what();
+    return false;
+  }
+
+  std::vector<Component*> comps(r.get<uint32_t>());
+  for (auto& c : comps) {
+    c = new Component();
+    c->minEdgeLvl = r.get<uint8_t>();
+  }
+
+  std::vector<StatGroup*> grps(r.get<uint32_t>());
+  for (auto& grp : grps) {
+    grp = new StatGroup();
+    uint32_t nStops = r.get<uint32_t>();
+    for (uint32_t i = 0; i < nStops; i++) {
+      auto s = stops.find(r.getStr());
+      if (s == stops.end())
+        throw std::runtime_error("graph snapshot references unknown stop");
+      grp->addStop(s->second);
+    }
+  }
+
+  std::vector<TransitEdgeLine*> lines(r.get<uint32_t>());
+  for (auto& l : lines) {
+    l = new TransitEdgeLine();
+    l->fromStr = r.getStr();
+    l->toStr = r.getStr();
+    l->shortName = r.getStr();
+  }
+
+  std::vector<Node*> nds(r.get<uint32_t>());
+  for (auto& n : nds) {
+    double x = r.get<double>();
+    double y = r.get<double>();
+    n = g->addNd(NodePL(POINT(x, y)));
+    uint32_t cid = r.get<uint32_t>();
+    if (cid) n->pl().setComp(comps[cid - 1]);
+
+    uint8_t type = r.get<uint8_t>();
+    if (type == 2) {
+      n->pl().setBlocker();
+    } else if (type == 1) {
+      std::string name = r.getStr();
+      std::string track = r.getStr();
+      bool fromOsm = r.get<uint8_t>();
+      StatInfo si(name, track, fromOsm);
+      uint32_t nAlt = r.get<uint32_t>();
+      for (uint32_t i = 0; i < nAlt; i++) si.addAltName(r.getStr());
+      uint32_t gid = r.get<uint32_t>();
+      if (gid) si.setGroup(grps[gid - 1]);
+#ifdef PFAEDLE_STATION_IDS
+      si.setId(r.getStr());
+#endif
+      n->pl().setSI(si);
+    }
+  }
+
+  for (auto* grp : grps) {
+    uint32_t nNds = r.get<uint32_t>();
+    for (uint32_t i = 0; i < nNds; i++) grp->addNode(nds.at(r.get<uint32_t>()));
+  }
+
+  std::vector<Edge*> edgs(r.get<uint32_t>());
+  for (auto& e : edgs) {
+    Node* from = nds.at(r.get<uint32_t>());
+    Node* to = nds.at(r.get<uint32_t>());
+    EdgePL pl;
+    pl.setLength(r.get<float>());
+    pl.setOneWay(r.get<uint8_t>());
+    if (r.get<uint8_t>()) pl.setRestricted();
+    if (r.get<uint8_t>()) pl.setRev();
+    pl.setLvl(r.get<uint8_t>());
+    uint32_t nPts = r.get<uint32_t>();
+    pl.getGeom()->reserve(nPts);
+    for (uint32_t i = 0; i < nPts; i++) {
+      double x = r.get<double>();
+      double y = r.get<double>();
+      pl.addPoint(POINT(x, y));
+    }
+    uint32_t nLines = r.get<uint32_t>();
+    for (uint32_t i = 0; i < nLines; i++)
+      pl.addLine(lines.at(r.get<uint32_t>()));
+    e = g->addEdg(from, to, pl);
+  }
+
+  readRules(&r, nds, edgs, true, res);
+  readRules(&r, nds, edgs, false, res);
+
+  uint32_t nFs = r.get<uint32_t>();
+  for (uint32_t i = 0; i < nFs; i++) {
+    auto s = stops.find(r.getStr());
+    uint32_t nid = r.get<uint32_t>();
+    if (s == stops.end()) continue;
+    (*fs)[s->second] = nid ? nds.at(nid - 1) : 0;
+  }
+
+  return true;
+}
@@ -0,0 +1,57 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_OSM_GRAPHCACHE_H_
+#define PFAEDLE_OSM_GRAPHCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include "pfaedle/osm/BBoxIdx.h"
+#include "pfaedle/osm/OsmReadOpts.h"
+#include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/Misc.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace osm {
+
+/*
+ * On-disk snapshots of fully built transit graphs (including station infos,
+ * station groups, components, restrictions and the feed stop mapping), keyed
+ * by everything OsmBuilder::read() depends on. Snapshots are read via mmap.
+ */
+class GraphCache {
+ public:
+  explicit GraphCache(const std::string& dir);
+
+  // Return the hash of the contents of the OSM file at osmPath. Computed
+  // once per run and shared by the keys of all configs.
+  static uint64_t hashOsm(const std::string& osmPath);
+
+  // Return the snapshot key for a graph build from the OSM file with hash
+  // osmHash with the given options, bounding box, grid size and feed stops
+  static uint64_t getKey(uint64_t osmHash, const OsmReadOpts& opts,
+                         const BBoxIdx& box, double gridSize,
+                         const router::FeedStops& fs);
+
+  // Read the snapshot for key into g, fs and res. Returns false (and leaves
+  // g, fs and res untouched) if there is no valid snapshot for key.
+  bool read(uint64_t key, trgraph::Graph* g, router::FeedStops* fs,
+            Restrictor* res) const;
+
+  // Write a snapshot of g, fs and res for key
+  void write(uint64_t key, const trgraph::Graph& g,
+             const router::FeedStops& fs, const Restrictor& res) const;
+
+ private:
+  std::string _dir;
+
+  std::string getPath(uint64_t key) const;
+
+  static const uint32_t VERSION = 1;
+};
+}  // namespace osm
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_OSM_GRAPHCACHE_H_
@@ -0,0 +1,134 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "pfaedle/osm/IdBitmap.h"
+
+using pfaedle::osm::IdBitmap;
+using pfaedle::osm::osmid;
+
+// _____________________________________________________________________________
+IdBitmap::IdBitmap() : _bytes(0) {}
+
+// _____________________________________________________________________________
+IdBitmap::~IdBitmap() {
+  for (auto* ch : _dense) {
+    if (!ch) continue;
+    delete[] ch->bits;
+    delete ch;
+  }
+  for (auto& kv : _sparse) {
+    delete[] kv.second->bits;
+    delete kv.second;
+  }
+}
+
+// _____________________________________________________________________________
+void IdBitmap::add(osmid id) {
+  chunkAdd(getOrAddChunk(id >> 16), id & 0xFFFF);
+}
+
+// _____________________________________________________________________________
+bool IdBitmap::has(osmid id) const {
+  const Chunk* ch = getChunk(id >> 16);
+  return ch && chunkHas(ch, id & 0xFFFF);
+}
+
+// _____________________________________________________________________________
+void IdBitmap::getIds(std::vector<osmid>* ret) const {
+  for (size_t c = 0; c < _dense.size(); c++) {
+    if (_dense[c]) chunkIds(_dense[c], c, ret);
+  }
+  for (const auto& kv : _sparse) chunkIds(kv.second, kv.first, ret);
+}
+
+// _____________________________________________________________________________
+IdBitmap::Chunk* IdBitmap::getChunk(uint64_t c) const {
+  if (c < DENSE_CHUNKS) return c < _dense.size() ? _dense[c] : 0;
+
+  auto i = _sparse.find(c);
+  if (i == _sparse.end()) return 0;
+  return i->second;
+}
+
+// _____________________________________________________________________________
+IdBitmap::Chunk* IdBitmap::getOrAddChunk(uint64_t c) {
+  Chunk* ch = getChunk(c);
+  if (ch) return ch;
+
+  ch = new Chunk();
+  ch->bits = 0;
+  _bytes += sizeof(Chunk);
+
+  if (c < DENSE_CHUNKS) {
+    if (c >= _dense.size()) {
+      _bytes -= _dense.capacity() * sizeof(Chunk*);
+      _dense.resize(c + 1, 0);
+      _bytes += _dense.capacity() * sizeof(Chunk*);
+    }
+    _dense[c] = ch;
+  } else {
+    // map node overhead
+    _bytes += 4 * sizeof(void*);
+    _sparse[c] = ch;
+  }
+
+  return ch;
+}
+
+// _____________________________________________________________________________
+void IdBitmap::chunkAdd(Chunk* ch, uint16_t v) {
+  if (ch->bits) {
+    ch->bits[v >> 6] |= (1ull << (v & 63));
+    return;
+  }
+
+  // OSM ids usually arrive in ascending order, so appending is the fast path
+  if (ch->arr.empty() || ch->arr.back() < v) {
+    size_t cap = ch->arr.capacity();
+    ch->arr.push_back(v);
+    _bytes += (ch->arr.capacity() - cap) * sizeof(uint16_t);
+  } else {
+    auto i = std::lower_bound(ch->arr.begin(), ch->arr.end(), v);
+    if (*i == v) return;
+    size_t cap = ch->arr.capacity();
+    ch->arr.insert(i, v);
+    _bytes += (ch->arr.capacity() - cap) * sizeof(uint16_t);
+  }
+
+  if (ch->arr.size() > MAX_ARR) {
+    // switch to a plain bitmap
+    ch->bits = new uint64_t[1 << 10];
+    memset(ch->bits, 0, (1 << 10) * sizeof(uint64_t));
+    for (uint16_t o : ch->arr) ch->bits[o >> 6] |= (1ull << (o & 63));
+    _bytes -= ch->arr.capacity() * sizeof(uint16_t);
+    _bytes += (1 << 10) * sizeof(uint64_t);
+    std::vector<uint16_t>().swap(ch->arr);
+  }
+}
+
+// _____________________________________________________________________________
+bool IdBitmap::chunkHas(const Chunk* ch, uint16_t v) {
+  if (ch->bits) return ch->bits[v >> 6] & (1ull << (v & 63));
+  return std::binary_search(ch->arr.begin(), ch->arr.end(), v);
+}
+
+// _____________________________________________________________________________
+void IdBitmap::chunkIds(const Chunk* ch, uint64_t c, std::vector<osmid>* ret) {
+  if (!ch->bits) {
+    for (uint16_t o : ch->arr) ret->push_back((c << 16) | o);
+    return;
+  }
+
+  for (size_t w = 0; w < (1 << 10); w++) {
+    uint64_t word = ch->bits[w];
+    while (word) {
+      size_t b = __builtin_ctzll(word);
+      ret->push_back((c << 16) | (w << 6 | b));
+      word &= word - 1;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_OSM_IDBITMAP_H_
+#define PFAEDLE_OSM_IDBITMAP_H_
+
+#include <map>
+#include <vector>
+#include "pfaedle/osm/Osm.h"
+
+namespace pfaedle {
+namespace osm {
+
+/*
+ * Compressed in-memory bitmap over the 64 bit OSM id space. The id space is
+ * split into chunks of 2^16 ids, each chunk is stored either as a sorted
+ * array of its 16 bit offsets (if sparse) or as a plain bitmap (if dense).
+ */
+class IdBitmap {
+ public:
+  IdBitmap();
+  ~IdBitmap();
+
+  IdBitmap(const IdBitmap&) = delete;
+  IdBitmap& operator=(const IdBitmap&) = delete;
+
+  // Add an id
+  void add(osmid id);
+
+  // Check if an id is contained
+  bool has(osmid id) const;
+
+  // Approximate memory usage in bytes
+  size_t bytes() const { return _bytes; }
+
+  // Write all contained ids to ret, in ascending order
+  void getIds(std::vector<osmid>* ret) const;
+
+ private:
+  struct Chunk {
+    std::vector<uint16_t> arr;
+    uint64_t* bits;
+  };
+
+  // chunks of ids below DENSE_CHUNKS * 2^16, indexed by chunk number
+  std::vector<Chunk*> _dense;
+
+  // chunks of all other ids
+  std::map<uint64_t, Chunk*> _sparse;
+
+  size_t _bytes;
+
+  Chunk* getChunk(uint64_t c) const;
+  Chunk* getOrAddChunk(uint64_t c);
+  void chunkAdd(Chunk* ch, uint16_t v);
+  static bool chunkHas(const Chunk* ch, uint16_t v);
+  static void chunkIds(const Chunk* ch, uint64_t c, std::vector<osmid>* ret);
+
+  // max number of sorted offsets per chunk before switching to a bitmap
+  static const size_t MAX_ARR = 4096;
+  static const uint64_t DENSE_CHUNKS = 1 << 24;
+};
+}  // namespace osm
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_OSM_IDBITMAP_H_
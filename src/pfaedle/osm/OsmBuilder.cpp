@@ -4,12 +4,15 @@
 
 #include <float.h>
 #include <algorithm>
+#include <atomic>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <stack>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include "pfaedle/Def.h"
@@ -17,10 +20,13 @@
 #include "pfaedle/osm/Osm.h"
 #include "pfaedle/osm/OsmBuilder.h"
 #include "pfaedle/osm/OsmFilter.h"
+#include "pfaedle/osm/PbfReader.h"
 #include "pfaedle/osm/Restrictor.h"
 #include "pfaedle/trgraph/StatGroup.h"
+#include "util/Counter.h"
 #include "util/Misc.h"
 #include "util/Nullable.h"
+#include "util/Profiler.h"
 #include "util/log/Log.h"
 #include "xml/pfxml.h"
 
@@ -33,6 +39,9 @@ using pfaedle::osm::OsmBuilder;
 using pfaedle::osm::OsmNode;
 using pfaedle::osm::OsmRel;
 using pfaedle::osm::OsmWay;
+using pfaedle::osm::PbfEntity;
+using pfaedle::osm::PbfReader;
+using pfaedle::osm::PbfState;
 using pfaedle::trgraph::Component;
 using pfaedle::trgraph::Edge;
 using pfaedle::trgraph::EdgePL;
@@ -47,6 +56,21 @@ using util::Nullable;
 using util::geo::Box;
 using util::geo::webMercMeterDist;
 
+// _____________________________________________________________________________
+inline std::string pbfVal(const char* v) {
+  // attribute values are decoded as XML later on, escape PBF values
+  // accordingly
+  if (!strchr(v, '&')) return v;
+  std::string ret;
+  for (; *v; v++) {
+    if (*v == '&')
+      ret += "&amp;";
+    else
+      ret += *v;
+  }
+  return ret;
+}
+
 // _____________________________________________________________________________
 bool EqSearch::operator()(const Node* cand, const StatInfo* si) const {
   if (orphanSnap && cand->pl().getSI() &&
@@ -64,113 +88,140 @@ OsmBuilder::OsmBuilder() {}
 void OsmBuilder::read(const std::string& path, const OsmReadOpts& opts,
                       Graph* g, const BBoxIdx& bbox, size_t gridSize,
                       router::FeedStops* fs, Restrictor* res) {
-  if (!bbox.size()) return;
+  read(path, std::vector<const OsmReadOpts*>{&opts}, std::vector<Graph*>{g},
+       bbox, gridSize, std::vector<router::FeedStops*>{fs},
+       std::vector<Restrictor*>{res});
+}
+
+// _____________________________________________________________________________
+void OsmBuilder::read(const std::string& path,
+                      const std::vector<const OsmReadOpts*>& opts,
+                      const std::vector<Graph*>& gs, const BBoxIdx& bbox,
+                      size_t gridSize,
+                      const std::vector<router::FeedStops*>& fss,
+                      const std::vector<Restrictor*>& ress) {
+  if (!bbox.size() || !opts.size()) return;
 
   LOG(INFO) << "Reading OSM file " << path << " ... ";
 
-  NodeSet orphanStations;
-  EdgTracks eTracks;
+  std::vector<OsmReadCtx*> ctxs;
+  for (size_t i = 0; i < opts.size(); i++) {
+    ctxs.push_back(new OsmReadCtx());
+    ctxs.back()->opts = opts[i];
+    ctxs.back()->filter = OsmFilter(*opts[i]);
+    getKeptAttrKeys(*opts[i], ctxs.back()->attrKeys);
+    ctxs.back()->g = gs[i];
+    ctxs.back()->res = ress[i];
+  }
+
   {
-    OsmIdSet bboxNodes, noHupNodes;
-
-    NIdMap nodes;
-    NIdMultMap multNodes;
-    RelLst intmRels;
-    RelMap nodeRels, wayRels;
-
-    Restrictions rawRests;
-
-    AttrKeySet attrKeys[3] = {};
-    getKeptAttrKeys(opts, attrKeys);
-
-    OsmFilter filter(opts);
-
-    pfxml::file xml(path);
-
-    // we do four passes of the file here to be as memory creedy as possible:
-    // - the first pass collects all node IDs which are
-    //    * inside the given bounding box
-    //    * (TODO: maybe more filtering?)
-    //   these nodes are stored on the HD via OsmIdSet (which implements a
-    //   simple bloom filter / base 256 encoded id store
-    // - the second pass collects filtered relations
-    // - the third pass collects filtered ways which contain one of the nodes
-    //   from pass 1
-    // - the forth pass collects filtered nodes which were
-    //    * collected as node ids in pass 1
-    //    * match the filter criteria
-    //    * have been used in a way in pass 3
-
-    LOG(VDEBUG) << "Reading bounding box nodes...";
-    skipUntil(&xml, "node");
-    pfxml::parser_state nodeBeg = xml.state();
-    pfxml::parser_state edgesBeg =
-        readBBoxNds(&xml, &bboxNodes, &noHupNodes, filter, bbox);
-
-    LOG(VDEBUG) << "Reading relations...";
-    skipUntil(&xml, "relation");
-    readRels(&xml, &intmRels, &nodeRels, &wayRels, filter, attrKeys[2],
-             &rawRests);
-
-    LOG(VDEBUG) << "Reading edges...";
-    xml.set_state(edgesBeg);
-    readEdges(&xml, g, intmRels, wayRels, filter, bboxNodes, &nodes, &multNodes,
-              noHupNodes, attrKeys[1], rawRests, res, intmRels.flat, &eTracks,
-              opts);
-
-    LOG(VDEBUG) << "Reading kept nodes...";
-    xml.set_state(nodeBeg);
-    readNodes(&xml, g, intmRels, nodeRels, filter, bboxNodes, &nodes,
-              &multNodes, &orphanStations, attrKeys[0], intmRels.flat, opts);
+    util::Profiler::Scope prof("read_osm");
+    if (PbfReader::isPbf(path)) {
+      PbfReader pbf(path);
+      readPasses(&pbf, bbox, ctxs);
+    } else {
+      pfxml::file xml(path);
+      readPasses(&xml, bbox, ctxs);
+    }
   }
 
   LOG(VDEBUG) << "OSM ID set lookups: " << osm::OsmIdSet::LOOKUPS
-              << ", file lookups: " << osm::OsmIdSet::FLOOKUPS;
+              << ", file lookups: " << osm::OsmIdSet::FLOOKUPS
+              << ", spills to disk: " << osm::OsmIdSet::SPILLS;
+  if (osm::OsmIdSet::MEM_LAT_SAMPLES)
+    LOG(VDEBUG) << "Avg. sampled OSM ID set lookup latency in memory: "
+                << osm::OsmIdSet::MEM_LAT_NS / osm::OsmIdSet::MEM_LAT_SAMPLES
+                << "ns (" << osm::OsmIdSet::MEM_LAT_SAMPLES << " samples)";
+  if (osm::OsmIdSet::DISK_LAT_SAMPLES)
+    LOG(VDEBUG) << "Avg. sampled OSM ID set lookup latency on disk: "
+                << osm::OsmIdSet::DISK_LAT_NS / osm::OsmIdSet::DISK_LAT_SAMPLES
+                << "ns (" << osm::OsmIdSet::DISK_LAT_SAMPLES << " samples)";
+
+  // free the read state before the graphs are post-processed
+  std::vector<NodeSet> orphanStations(ctxs.size());
+  std::vector<EdgTracks> eTracks(ctxs.size());
+  for (size_t i = 0; i < ctxs.size(); i++) {
+    orphanStations[i].swap(ctxs[i]->orphanStations);
+    eTracks[i].swap(ctxs[i]->eTracks);
+    delete ctxs[i];
+  }
+
+  // the post-processing touches the global payload reference counts and is
+  // thus done sequentially
+  for (size_t i = 0; i < opts.size(); i++) {
+    if (opts.size() > 1) {
+      LOG(DEBUG) << "Building graph " << (i + 1) << " / " << opts.size()
+                 << "...";
+    }
+    buildGraph(*opts[i], gs[i], bbox, gridSize, fss[i], ress[i],
+               orphanStations[i], &eTracks[i]);
+  }
+}
+
+// _____________________________________________________________________________
+void OsmBuilder::buildGraph(const OsmReadOpts& opts, Graph* g,
+                            const BBoxIdx& bbox, size_t gridSize,
+                            router::FeedStops* fs, Restrictor* res,
+                            const NodeSet& orphanStations,
+                            EdgTracks* eTracks) {
+  // run a single pass, profile, log and count its wall time
+  auto pass = [](const std::string& name, const std::function<void()>& f) {
+    util::Profiler::Scope prof(name);
+    f();
+    double ms = prof.stop();
+    LOG(DEBUG) << "Pass " << name << " took " << ms << " ms";
+    util::Counter::named("graph_pass_ms",
+                         "Wall time of the graph build passes, in ms", "pass",
+                         name) += static_cast<size_t>(ms);
+  };
 
   LOG(VDEBUG) << "Applying edge track numbers...";
-  writeEdgeTracks(eTracks);
-  eTracks.clear();
+  writeEdgeTracks(*eTracks);
+  eTracks->clear();
 
-  {
-    LOG(VDEBUG) << "Fixing gaps...";
+  LOG(VDEBUG) << "Fixing gaps...";
+  pass("fix_gaps", [&]() {
     NodeGrid ng = buildNodeIdx(g, gridSize, bbox.getFullWebMercBox(), false);
     fixGaps(g, &ng);
-  }
+  });
 
   LOG(VDEBUG) << "Writing edge geoms...";
-  writeGeoms(g);
+  pass("write_geoms", [&]() { writeGeoms(g); });
 
   LOG(VDEBUG) << "Snapping stations...";
-  snapStats(opts, g, bbox, gridSize, fs, res, orphanStations);
+  pass("snap_stats", [&]() {
+    snapStats(opts, g, bbox, gridSize, fs, res, orphanStations);
+  });
 
   LOG(VDEBUG) << "Deleting orphan nodes...";
-  deleteOrphNds(g);
+  pass("delete_orph_nds", [&]() { deleteOrphNds(g); });
 
   LOG(VDEBUG) << "Deleting orphan edges...";
-  deleteOrphEdgs(g, opts);
+  pass("delete_orph_edgs", [&]() { deleteOrphEdgs(g, opts); });
 
   LOG(VDEBUG) << "Collapsing edges...";
-  collapseEdges(g);
+  pass("collapse_edges", [&]() { collapseEdges(g); });
 
   LOG(VDEBUG) << "Deleting orphan nodes...";
-  deleteOrphNds(g);
+  pass("delete_orph_nds", [&]() { deleteOrphNds(g); });
 
   LOG(VDEBUG) << "Deleting orphan edges...";
-  deleteOrphEdgs(g, opts);
+  pass("delete_orph_edgs", [&]() { deleteOrphEdgs(g, opts); });
 
   LOG(VDEBUG) << "Writing graph components...";
   // the restrictor is needed here to prevent connections in the graph
   // which are not possible in reality
-  uint32_t comps = writeComps(g);
+  uint32_t comps = 0;
+  pass("write_comps", [&]() { comps = writeComps(g); });
 
   LOG(VDEBUG) << "Simplifying geometries...";
-  simplifyGeoms(g);
+  pass("simplify_geoms", [&]() { simplifyGeoms(g); });
 
   LOG(VDEBUG) << "Writing other-direction edges...";
-  writeODirEdgs(g, res);
+  pass("write_odir_edgs", [&]() { writeODirEdgs(g, res); });
 
   LOG(VDEBUG) << "Write dummy node self-edges...";
-  writeSelfEdgs(g);
+  pass("write_self_edgs", [&]() { writeSelfEdgs(g); });
 
   size_t numEdges = 0;
 
@@ -182,6 +233,62 @@ void OsmBuilder::read(const std::string& path, const OsmReadOpts& opts,
              << " edges and " << comps << " connected component(s)";
 }
 
+// _____________________________________________________________________________
+template <typename OsmSrc>
+void OsmBuilder::readPasses(OsmSrc* f, const BBoxIdx& bbox,
+                            const std::vector<OsmReadCtx*>& ctxs) {
+  OsmIdSet bboxNodes;
+
+  // the union of the attribute keys needed by any of the graphs
+  AttrKeySet attrKeys[3] = {};
+  for (const auto* ctx : ctxs) {
+    for (size_t i = 0; i < 3; i++) {
+      attrKeys[i].insert(ctx->attrKeys[i].begin(), ctx->attrKeys[i].end());
+    }
+  }
+
+  // we do four passes of the file here to be as memory creedy as possible:
+  // - the first pass collects all node IDs which are
+  //    * inside the given bounding box
+  //    * (TODO: maybe more filtering?)
+  //   these nodes are stored on the HD via OsmIdSet (which implements a
+  //   simple bloom filter / base 256 encoded id store
+  // - the second pass collects filtered relations
+  // - the third pass collects filtered ways which contain one of the nodes
+  //   from pass 1
+  // - the forth pass collects filtered nodes which were
+  //    * collected as node ids in pass 1
+  //    * match the filter criteria
+  //    * have been used in a way in pass 3
+  //
+  // each entity is read only once and then checked against the filters of
+  // all graphs in ctxs
+
+  util::Profiler::Scope prof("bbox_nds");
+  LOG(VDEBUG) << "Reading bounding box nodes...";
+  skipUntil(f, "node");
+  auto nodeBeg = f->state();
+  auto edgesBeg = readBBoxNds(f, &bboxNodes, ctxs, bbox);
+  prof.stop();
+
+  util::Profiler::Scope profRels("rels");
+  LOG(VDEBUG) << "Reading relations...";
+  skipUntil(f, "relation");
+  readRels(f, ctxs, attrKeys[2]);
+  profRels.stop();
+
+  util::Profiler::Scope profEdgs("edgs");
+  LOG(VDEBUG) << "Reading edges...";
+  f->set_state(edgesBeg);
+  readEdges(f, ctxs, bboxNodes, attrKeys[1]);
+  profEdgs.stop();
+
+  util::Profiler::Scope profNds("nds");
+  LOG(VDEBUG) << "Reading kept nodes...";
+  f->set_state(nodeBeg);
+  readNodes(f, ctxs, bboxNodes, attrKeys[0]);
+}
+
 // _____________________________________________________________________________
 void OsmBuilder::overpassQryWrite(std::ostream* out,
                                   const std::vector<OsmReadOpts>& opts,
@@ -268,22 +375,6 @@ void OsmBuilder::overpassQryWrite(std::ostream* out,
 void OsmBuilder::filterWrite(const std::string& in, const std::string& out,
                              const std::vector<OsmReadOpts>& opts,
                              const BBoxIdx& latLngBox) {
-  OsmIdSet bboxNodes, noHupNodes;
-  MultAttrMap emptyF;
-
-  RelLst rels;
-  OsmIdList ways;
-  RelMap nodeRels, wayRels;
-
-  // TODO(patrick): not needed here!
-  Restrictions rests;
-
-  NIdMap nodes;
-
-  // always empty
-  NIdMultMap multNodes;
-
-  pfxml::file xml(in);
   std::ofstream outstr;
   outstr.open(out);
 
@@ -301,41 +392,56 @@ void OsmBuilder::filterWrite(const std::string& in, const std::string& out,
         std::to_string(latLngBox.getFullBox().getUpperRight().getX())}});
   wr.closeTag();
 
-  OsmFilter filter;
-  AttrKeySet attrKeys[3] = {};
+  OsmReadCtx ctx;
 
   for (const OsmReadOpts& o : opts) {
-    getKeptAttrKeys(o, attrKeys);
-    filter = filter.merge(OsmFilter(o.keepFilter, o.dropFilter));
+    getKeptAttrKeys(o, ctx.attrKeys);
+    ctx.filter = ctx.filter.merge(OsmFilter(o.keepFilter, o.dropFilter));
   }
 
-  skipUntil(&xml, "node");
-  pfxml::parser_state nodeBeg = xml.state();
-  pfxml::parser_state edgesBeg =
-      readBBoxNds(&xml, &bboxNodes, &noHupNodes, filter, latLngBox);
+  if (PbfReader::isPbf(in)) {
+    PbfReader pbf(in);
+    filterWritePasses(&pbf, &wr, &ctx, latLngBox);
+  } else {
+    pfxml::file xml(in);
+    filterWritePasses(&xml, &wr, &ctx, latLngBox);
+  }
+
+  wr.closeTags();
+}
 
-  skipUntil(&xml, "relation");
-  readRels(&xml, &rels, &nodeRels, &wayRels, filter, attrKeys[2], &rests);
+// _____________________________________________________________________________
+template <typename OsmSrc>
+void OsmBuilder::filterWritePasses(OsmSrc* f, util::xml::XmlWriter* wr,
+                                   OsmReadCtx* ctx, const BBoxIdx& latLngBox) {
+  OsmIdSet bboxNodes;
+  OsmIdList ways;
 
-  xml.set_state(edgesBeg);
-  readEdges(&xml, wayRels, filter, bboxNodes, attrKeys[1], &ways, &nodes,
-            rels.flat);
+  skipUntil(f, "node");
+  auto nodeBeg = f->state();
+  auto edgesBeg = readBBoxNds(f, &bboxNodes, {ctx}, latLngBox);
 
-  xml.set_state(nodeBeg);
+  skipUntil(f, "relation");
+  readRels(f, {ctx}, ctx->attrKeys[2]);
 
-  readWriteNds(&xml, &wr, nodeRels, filter, bboxNodes, &nodes, attrKeys[0],
-               rels.flat);
-  readWriteWays(&xml, &wr, &ways, attrKeys[1]);
+  f->set_state(edgesBeg);
+  readEdges(f, ctx->wayRels, ctx->filter, bboxNodes, ctx->attrKeys[1], &ways,
+            &ctx->nodes, ctx->rels.flat);
 
-  std::sort(ways.begin(), ways.end());
-  skipUntil(&xml, "relation");
-  readWriteRels(&xml, &wr, &ways, &nodes, filter, attrKeys[2]);
+  f->set_state(nodeBeg);
 
-  wr.closeTags();
+  readWriteNds(f, wr, ctx->nodeRels, ctx->filter, bboxNodes, &ctx->nodes,
+               ctx->attrKeys[0], ctx->rels.flat);
+  readWriteWays(f, wr, &ways, ctx->attrKeys[1]);
+
+  std::sort(ways.begin(), ways.end());
+  skipUntil(f, "relation");
+  readWriteRels(f, wr, &ways, &ctx->nodes, ctx->filter, ctx->attrKeys[2]);
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readWriteRels(pfxml::file* i, util::xml::XmlWriter* o,
+template <typename OsmSrc>
+void OsmBuilder::readWriteRels(OsmSrc* i, util::xml::XmlWriter* o,
                                OsmIdList* ways, NIdMap* nodes,
                                const OsmFilter& filter,
                                const AttrKeySet& keepAttrs) {
@@ -397,7 +503,8 @@ void OsmBuilder::readWriteRels(pfxml::file* i, util::xml::XmlWriter* o,
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readWriteWays(pfxml::file* i, util::xml::XmlWriter* o,
+template <typename OsmSrc>
+void OsmBuilder::readWriteWays(OsmSrc* i, util::xml::XmlWriter* o,
                                OsmIdList* ways,
                                const AttrKeySet& keepAttrs) const {
   OsmWay w;
@@ -442,10 +549,9 @@ NodePL OsmBuilder::plFromGtfs(const Stop* s, const OsmReadOpts& ops) {
 }
 
 // _____________________________________________________________________________
-pfxml::parser_state OsmBuilder::readBBoxNds(pfxml::file* xml, OsmIdSet* nodes,
-                                            OsmIdSet* nohupNodes,
-                                            const OsmFilter& filter,
-                                            const BBoxIdx& bbox) const {
+pfxml::parser_state OsmBuilder::readBBoxNds(
+    pfxml::file* xml, OsmIdSet* nodes, const std::vector<OsmReadCtx*>& ctxs,
+    const BBoxIdx& bbox) const {
   bool inNodeBlock = false;
   uint64_t curId = 0;
 
@@ -454,9 +560,11 @@ pfxml::parser_state OsmBuilder::readBBoxNds(pfxml::file* xml, OsmIdSet* nodes,
 
     if (inNodeBlock && xml->level() == 3 && curId &&
         strcmp(cur.name, "tag") == 0) {
-      if (filter.nohup(cur.attrs.find("k")->second,
-                       cur.attrs.find("v")->second)) {
-        nohupNodes->add(curId);
+      for (auto* ctx : ctxs) {
+        if (ctx->filter.nohup(cur.attrs.find("k")->second,
+                              cur.attrs.find("v")->second)) {
+          ctx->noHupNodes.add(curId);
+        }
       }
     }
 
@@ -479,6 +587,54 @@ pfxml::parser_state OsmBuilder::readBBoxNds(pfxml::file* xml, OsmIdSet* nodes,
   return xml->state();
 }
 
+// _____________________________________________________________________________
+PbfState OsmBuilder::readBBoxNds(PbfReader* pbf, OsmIdSet* nodes,
+                                 const std::vector<OsmReadCtx*>& ctxs,
+                                 const BBoxIdx& bbox) const {
+  do {
+    const PbfEntity& cur = pbf->get();
+
+    // block ended
+    if (cur.type != osm::PBF_NODE) return pbf->state();
+
+    if (bbox.contains(Point<double>(cur.lng, cur.lat))) {
+      nodes->add(cur.id);
+      for (auto* ctx : ctxs) {
+        for (size_t i = 0; i < cur.numTags; i++) {
+          if (ctx->filter.nohup(cur.tags[i].k, cur.tags[i].v)) {
+            ctx->noHupNodes.add(cur.id);
+            break;
+          }
+        }
+      }
+    }
+  } while (pbf->next());
+
+  return pbf->state();
+}
+
+// _____________________________________________________________________________
+OsmWay OsmBuilder::nextWayWithId(PbfReader* pbf, osmid wid,
+                                 const AttrKeySet& keepAttrs) const {
+  OsmWay w;
+
+  for (; pbf->get().type == osm::PBF_WAY; pbf->next()) {
+    const PbfEntity& cur = pbf->get();
+    if (cur.id != wid) continue;
+
+    w.id = cur.id;
+    w.nodes.assign(cur.refs, cur.refs + cur.numRefs);
+    for (size_t i = 0; i < cur.numTags; i++) {
+      if (keepAttrs.count(cur.tags[i].k))
+        w.attrs[cur.tags[i].k] = pbfVal(cur.tags[i].v);
+    }
+    pbf->next();
+    return w;
+  }
+
+  return w;
+}
+
 // _____________________________________________________________________________
 OsmWay OsmBuilder::nextWayWithId(pfxml::file* xml, osmid wid,
                                  const AttrKeySet& keepAttrs) const {
@@ -514,6 +670,17 @@ void OsmBuilder::skipUntil(pfxml::file* xml, const std::string& s) const {
   }
 }
 
+// _____________________________________________________________________________
+void OsmBuilder::skipUntil(PbfReader* pbf, const std::string& s) const {
+  osm::PbfType t = osm::PBF_REL;
+  if (s == "node") t = osm::PBF_NODE;
+  if (s == "way") t = osm::PBF_WAY;
+
+  // unlike the XML version, the current entity is not skipped
+  while (pbf->get().type != t && pbf->next()) {
+  }
+}
+
 // _____________________________________________________________________________
 bool OsmBuilder::relKeep(osmid id, const RelMap& rels,
                          const FlatRels& fl) const {
@@ -530,21 +697,16 @@ bool OsmBuilder::relKeep(osmid id, const RelMap& rels,
 }
 
 // _____________________________________________________________________________
-OsmWay OsmBuilder::nextWay(pfxml::file* xml, const RelMap& wayRels,
-                           const OsmFilter& filter, const OsmIdSet& bBoxNodes,
-                           const AttrKeySet& keepAttrs,
-                           const FlatRels& fl) const {
+OsmWay OsmBuilder::nextWay(pfxml::file* xml,
+                           const AttrKeySet& keepAttrs) const {
   OsmWay w;
 
   do {
     const pfxml::tag& cur = xml->get();
     if (xml->level() == 2 || xml->level() == 0) {
-      if (keepWay(w, wayRels, filter, bBoxNodes, fl)) return w;
-      if (strcmp(cur.name, "way")) return OsmWay();
+      if (w.id || strcmp(cur.name, "way")) return w;
 
       w.id = util::atoul(cur.attrs.find("id")->second);
-      w.nodes.clear();
-      w.attrs.clear();
     }
 
     if (w.id && xml->level() == 3) {
@@ -558,7 +720,38 @@ OsmWay OsmBuilder::nextWay(pfxml::file* xml, const RelMap& wayRels,
     }
   } while (xml->next());
 
-  if (keepWay(w, wayRels, filter, bBoxNodes, fl)) return w;
+  return w;
+}
+
+// _____________________________________________________________________________
+OsmWay OsmBuilder::nextWay(PbfReader* pbf,
+                           const AttrKeySet& keepAttrs) const {
+  OsmWay w;
+  if (pbf->get().type != osm::PBF_WAY) return w;
+
+  const PbfEntity& cur = pbf->get();
+  w.id = cur.id;
+  w.nodes.assign(cur.refs, cur.refs + cur.numRefs);
+  for (size_t i = 0; i < cur.numTags; i++) {
+    if (keepAttrs.count(cur.tags[i].k))
+      w.attrs[cur.tags[i].k] = pbfVal(cur.tags[i].v);
+  }
+
+  pbf->next();
+  return w;
+}
+
+// _____________________________________________________________________________
+template <typename OsmSrc>
+OsmWay OsmBuilder::nextWay(OsmSrc* f, const RelMap& wayRels,
+                           const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+                           const AttrKeySet& keepAttrs,
+                           const FlatRels& fl) const {
+  OsmWay w;
+  while ((w = nextWay(f, keepAttrs)).id) {
+    if (keepWay(w, wayRels, filter, bBoxNodes, fl)) return w;
+  }
+
   return OsmWay();
 }
 
@@ -580,7 +773,8 @@ bool OsmBuilder::keepWay(const OsmWay& w, const RelMap& wayRels,
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readEdges(pfxml::file* xml, const RelMap& wayRels,
+template <typename OsmSrc>
+void OsmBuilder::readEdges(OsmSrc* xml, const RelMap& wayRels,
                            const OsmFilter& filter, const OsmIdSet& bBoxNodes,
                            const AttrKeySet& keepAttrs, OsmIdList* ret,
                            NIdMap* nodes, const FlatRels& flat) {
@@ -594,55 +788,64 @@ void OsmBuilder::readEdges(pfxml::file* xml, const RelMap& wayRels,
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readEdges(pfxml::file* xml, Graph* g, const RelLst& rels,
-                           const RelMap& wayRels, const OsmFilter& filter,
-                           const OsmIdSet& bBoxNodes, NIdMap* nodes,
-                           NIdMultMap* multiNodes, const OsmIdSet& noHupNodes,
-                           const AttrKeySet& keepAttrs,
-                           const Restrictions& rawRests, Restrictor* restor,
-                           const FlatRels& fl, EdgTracks* eTracks,
-                           const OsmReadOpts& opts) {
+template <typename OsmSrc>
+void OsmBuilder::readEdges(OsmSrc* xml, const std::vector<OsmReadCtx*>& ctxs,
+                           const OsmIdSet& bBoxNodes,
+                           const AttrKeySet& keepAttrs) {
   OsmWay w;
-  while ((w = nextWay(xml, wayRels, filter, bBoxNodes, keepAttrs, fl)).id) {
-    Node* last = 0;
-    std::vector<TransitEdgeLine*> lines;
-    if (wayRels.count(w.id)) {
-      lines = getLines(wayRels.find(w.id)->second, rels, opts);
+  while ((w = nextWay(xml, keepAttrs)).id) {
+    for (auto* ctx : ctxs) {
+      if (!keepWay(w, ctx->wayRels, ctx->filter, bBoxNodes, ctx->rels.flat))
+        continue;
+      addEdges(w, bBoxNodes, ctx);
     }
-    std::string track =
-        getAttrByFirstMatch(opts.edgePlatformRules, w.id, w.attrs, wayRels,
-                            rels, opts.trackNormzer);
+  }
+}
 
-    osmid lastnid = 0;
-    for (osmid nid : w.nodes) {
-      Node* n = 0;
-      if (noHupNodes.has(nid)) {
-        n = g->addNd();
-        (*multiNodes)[nid].insert(n);
-      } else if (!nodes->count(nid)) {
-        if (!bBoxNodes.has(nid)) continue;
-        n = g->addNd();
-        (*nodes)[nid] = n;
-      } else {
-        n = (*nodes)[nid];
-      }
-      if (last) {
-        auto e = g->addEdg(last, n, EdgePL());
-        if (!e) continue;
+// _____________________________________________________________________________
+void OsmBuilder::addEdges(const OsmWay& w, const OsmIdSet& bBoxNodes,
+                          OsmReadCtx* ctx) {
+  const OsmReadOpts& opts = *ctx->opts;
+  Graph* g = ctx->g;
+
+  Node* last = 0;
+  std::vector<TransitEdgeLine*> lines;
+  if (ctx->wayRels.count(w.id)) {
+    lines = getLines(ctx->wayRels.find(w.id)->second, ctx);
+  }
+  std::string track =
+      getAttrByFirstMatch(opts.edgePlatformRules, w.id, w.attrs, ctx->wayRels,
+                          ctx->rels, opts.trackNormzer);
+
+  osmid lastnid = 0;
+  for (osmid nid : w.nodes) {
+    Node* n = 0;
+    if (ctx->noHupNodes.has(nid)) {
+      n = g->addNd();
+      ctx->multNodes[nid].insert(n);
+    } else if (!ctx->nodes.count(nid)) {
+      if (!bBoxNodes.has(nid)) continue;
+      n = g->addNd();
+      ctx->nodes[nid] = n;
+    } else {
+      n = ctx->nodes[nid];
+    }
+    if (last) {
+      auto e = g->addEdg(last, n, EdgePL());
+      if (!e) continue;
 
-        processRestr(nid, w.id, rawRests, e, n, restor);
-        processRestr(lastnid, w.id, rawRests, e, last, restor);
+      processRestr(nid, w.id, ctx->rawRests, e, n, ctx->res);
+      processRestr(lastnid, w.id, ctx->rawRests, e, last, ctx->res);
 
-        e->pl().addLines(lines);
-        e->pl().setLvl(filter.level(w.attrs));
-        if (!track.empty()) (*eTracks)[e] = track;
+      e->pl().addLines(lines);
+      e->pl().setLvl(ctx->filter.level(w.attrs));
+      if (!track.empty()) ctx->eTracks[e] = track;
 
-        if (filter.oneway(w.attrs)) e->pl().setOneWay(1);
-        if (filter.onewayrev(w.attrs)) e->pl().setOneWay(2);
-      }
-      lastnid = nid;
-      last = n;
+      if (ctx->filter.oneway(w.attrs)) e->pl().setOneWay(1);
+      if (ctx->filter.onewayrev(w.attrs)) e->pl().setOneWay(2);
     }
+    lastnid = nid;
+    last = n;
   }
 }
 
@@ -676,22 +879,16 @@ void OsmBuilder::processRestr(osmid nid, osmid wid,
 }
 
 // _____________________________________________________________________________
-OsmNode OsmBuilder::nextNode(pfxml::file* xml, NIdMap* nodes,
-                             NIdMultMap* multNodes, const RelMap& nodeRels,
-                             const OsmFilter& filter, const OsmIdSet& bBoxNodes,
-                             const AttrKeySet& keepAttrs,
-                             const FlatRels& fl) const {
+OsmNode OsmBuilder::nextNode(pfxml::file* xml,
+                             const AttrKeySet& keepAttrs) const {
   OsmNode n;
 
   do {
     const pfxml::tag& cur = xml->get();
     if (xml->level() == 2 || xml->level() == 0) {
-      if (keepNode(n, *nodes, *multNodes, nodeRels, bBoxNodes, filter, fl))
-        return n;
       // block ended
-      if (strcmp(cur.name, "node")) return OsmNode();
+      if (n.id || strcmp(cur.name, "node")) return n;
 
-      n.attrs.clear();
       n.lat = util::atof(cur.attrs.find("lat")->second, 7);
       n.lng = util::atof(cur.attrs.find("lon")->second, 7);
       n.id = util::atoul(cur.attrs.find("id")->second);
@@ -703,8 +900,41 @@ OsmNode OsmBuilder::nextNode(pfxml::file* xml, NIdMap* nodes,
     }
   } while (xml->next());
 
-  if (keepNode(n, *nodes, *multNodes, nodeRels, bBoxNodes, filter, fl))
-    return n;
+  return n;
+}
+
+// _____________________________________________________________________________
+OsmNode OsmBuilder::nextNode(PbfReader* pbf,
+                             const AttrKeySet& keepAttrs) const {
+  OsmNode n;
+  if (pbf->get().type != osm::PBF_NODE) return n;
+
+  const PbfEntity& cur = pbf->get();
+  n.id = cur.id;
+  n.lat = cur.lat;
+  n.lng = cur.lng;
+  for (size_t i = 0; i < cur.numTags; i++) {
+    if (keepAttrs.count(cur.tags[i].k))
+      n.attrs[cur.tags[i].k] = pbfVal(cur.tags[i].v);
+  }
+
+  pbf->next();
+  return n;
+}
+
+// _____________________________________________________________________________
+template <typename OsmSrc>
+OsmNode OsmBuilder::nextNode(OsmSrc* f, NIdMap* nodes, NIdMultMap* multNodes,
+                             const RelMap& nodeRels, const OsmFilter& filter,
+                             const OsmIdSet& bBoxNodes,
+                             const AttrKeySet& keepAttrs,
+                             const FlatRels& fl) const {
+  OsmNode n;
+  while ((n = nextNode(f, keepAttrs)).id) {
+    if (keepNode(n, *nodes, *multNodes, nodeRels, bBoxNodes, filter, fl))
+      return n;
+  }
+
   return OsmNode();
 }
 
@@ -726,7 +956,8 @@ bool OsmBuilder::keepNode(const OsmNode& n, const NIdMap& nodes,
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readWriteNds(pfxml::file* i, util::xml::XmlWriter* o,
+template <typename OsmSrc>
+void OsmBuilder::readWriteNds(OsmSrc* i, util::xml::XmlWriter* o,
                               const RelMap& nRels, const OsmFilter& filter,
                               const OsmIdSet& bBoxNds, NIdMap* nds,
                               const AttrKeySet& keepAttrs,
@@ -749,85 +980,79 @@ void OsmBuilder::readWriteNds(pfxml::file* i, util::xml::XmlWriter* o,
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readNodes(pfxml::file* xml, Graph* g, const RelLst& rels,
-                           const RelMap& nodeRels, const OsmFilter& filter,
-                           const OsmIdSet& bBoxNodes, NIdMap* nodes,
-                           NIdMultMap* multNodes, NodeSet* orphanStations,
-                           const AttrKeySet& keepAttrs, const FlatRels& fl,
-                           const OsmReadOpts& opts) const {
-  StAttrGroups attrGroups;
+template <typename OsmSrc>
+void OsmBuilder::readNodes(OsmSrc* xml, const std::vector<OsmReadCtx*>& ctxs,
+                           const OsmIdSet& bBoxNodes,
+                           const AttrKeySet& keepAttrs) const {
+  std::vector<StAttrGroups> attrGroups(ctxs.size());
 
   OsmNode nd;
-  while ((nd = nextNode(xml, nodes, multNodes, nodeRels, filter, bBoxNodes,
-                        keepAttrs, fl))
-             .id) {
-    Node* n = 0;
-    auto pos = util::geo::latLngToWebMerc<PFAEDLE_PRECISION>(nd.lat, nd.lng);
-    if (nodes->count(nd.id)) {
-      n = (*nodes)[nd.id];
+  while ((nd = nextNode(xml, keepAttrs)).id) {
+    for (size_t i = 0; i < ctxs.size(); i++) {
+      OsmReadCtx* ctx = ctxs[i];
+      if (!keepNode(nd, ctx->nodes, ctx->multNodes, ctx->nodeRels, bBoxNodes,
+                    ctx->filter, ctx->rels.flat))
+        continue;
+      addNode(nd, ctx, &attrGroups[i]);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void OsmBuilder::addNode(const OsmNode& nd, OsmReadCtx* ctx,
+                         StAttrGroups* attrGroups) const {
+  const OsmReadOpts& opts = *ctx->opts;
+  const OsmFilter& filter = ctx->filter;
+
+  Node* n = 0;
+  auto pos = util::geo::latLngToWebMerc<PFAEDLE_PRECISION>(nd.lat, nd.lng);
+  if (ctx->nodes.count(nd.id)) {
+    n = ctx->nodes[nd.id];
+    n->pl().setGeom(pos);
+    if (filter.station(nd.attrs)) {
+      auto si = getStatInfo(n, nd.id, pos, nd.attrs, attrGroups,
+                            ctx->nodeRels, ctx->rels, opts);
+      if (!si.isNull()) n->pl().setSI(si);
+    } else if (filter.blocker(nd.attrs)) {
+      n->pl().setBlocker();
+    }
+  } else if (ctx->multNodes.count(nd.id)) {
+    for (auto* n : ctx->multNodes[nd.id]) {
       n->pl().setGeom(pos);
       if (filter.station(nd.attrs)) {
-        auto si = getStatInfo(n, nd.id, pos, nd.attrs, &attrGroups, nodeRels,
-                              rels, opts);
+        auto si = getStatInfo(n, nd.id, pos, nd.attrs, attrGroups,
+                              ctx->nodeRels, ctx->rels, opts);
         if (!si.isNull()) n->pl().setSI(si);
       } else if (filter.blocker(nd.attrs)) {
         n->pl().setBlocker();
       }
-    } else if ((*multNodes).count(nd.id)) {
-      for (auto* n : (*multNodes)[nd.id]) {
-        n->pl().setGeom(pos);
-        if (filter.station(nd.attrs)) {
-          auto si = getStatInfo(n, nd.id, pos, nd.attrs, &attrGroups, nodeRels,
-                                rels, opts);
-          if (!si.isNull()) n->pl().setSI(si);
-        } else if (filter.blocker(nd.attrs)) {
-          n->pl().setBlocker();
-        }
-      }
-    } else {
-      // these are nodes without any connected edges
-      if (filter.station(nd.attrs)) {
-        auto tmp = g->addNd(NodePL(pos));
-        auto si = getStatInfo(tmp, nd.id, pos, nd.attrs, &attrGroups, nodeRels,
-                              rels, opts);
-        if (!si.isNull()) tmp->pl().setSI(si);
-        if (tmp->pl().getSI()) {
-          tmp->pl().getSI()->setIsFromOsm(false);
-          orphanStations->insert(tmp);
-        }
+    }
+  } else {
+    // these are nodes without any connected edges
+    if (filter.station(nd.attrs)) {
+      auto tmp = ctx->g->addNd(NodePL(pos));
+      auto si = getStatInfo(tmp, nd.id, pos, nd.attrs, attrGroups,
+                            ctx->nodeRels, ctx->rels, opts);
+      if (!si.isNull()) tmp->pl().setSI(si);
+      if (tmp->pl().getSI()) {
+        tmp->pl().getSI()->setIsFromOsm(false);
+        ctx->orphanStations.insert(tmp);
       }
     }
   }
 }
 
 // _____________________________________________________________________________
-OsmRel OsmBuilder::nextRel(pfxml::file* xml, const OsmFilter& filter,
+OsmRel OsmBuilder::nextRel(pfxml::file* xml,
                            const AttrKeySet& keepAttrs) const {
   OsmRel rel;
 
   do {
     const pfxml::tag& cur = xml->get();
     if (xml->level() == 2 || xml->level() == 0) {
-      uint64_t keepFlags = 0;
-      uint64_t dropFlags = 0;
-      if (rel.id && rel.attrs.size() &&
-          (keepFlags = filter.keep(rel.attrs, OsmFilter::REL)) &&
-          !(dropFlags = filter.drop(rel.attrs, OsmFilter::REL))) {
-        rel.keepFlags = keepFlags;
-        rel.dropFlags = dropFlags;
-        return rel;
-      }
-
       // block ended
-      if (strcmp(cur.name, "relation")) return OsmRel();
-
-      rel.attrs.clear();
-      rel.nodes.clear();
-      rel.ways.clear();
-      rel.nodeRoles.clear();
-      rel.wayRoles.clear();
-      rel.keepFlags = 0;
-      rel.dropFlags = 0;
+      if (rel.id || strcmp(cur.name, "relation")) return rel;
+
       rel.id = util::atoul(cur.attrs.find("id")->second);
     }
 
@@ -860,36 +1085,87 @@ OsmRel OsmBuilder::nextRel(pfxml::file* xml, const OsmFilter& filter,
     }
   } while (xml->next());
 
-  // dont forget last relation
+  return rel;
+}
+
+// _____________________________________________________________________________
+OsmRel OsmBuilder::nextRel(PbfReader* pbf,
+                           const AttrKeySet& keepAttrs) const {
+  OsmRel rel;
+  if (pbf->get().type != osm::PBF_REL) return rel;
+
+  const PbfEntity& cur = pbf->get();
+  rel.id = cur.id;
+
+  for (size_t i = 0; i < cur.numMembers; i++) {
+    const osm::PbfMember& m = cur.members[i];
+    if (m.type == osm::PBF_NODE) {
+      rel.nodes.push_back(m.ref);
+      rel.nodeRoles.push_back(m.role);
+    } else if (m.type == osm::PBF_WAY) {
+      rel.ways.push_back(m.ref);
+      rel.wayRoles.push_back(m.role);
+    }
+  }
+
+  for (size_t i = 0; i < cur.numTags; i++) {
+    if (keepAttrs.count(cur.tags[i].k))
+      rel.attrs[cur.tags[i].k] = pbfVal(cur.tags[i].v);
+  }
+
+  pbf->next();
+  return rel;
+}
+
+// _____________________________________________________________________________
+template <typename OsmSrc>
+OsmRel OsmBuilder::nextRel(OsmSrc* f, const OsmFilter& filter,
+                           const AttrKeySet& keepAttrs) const {
+  OsmRel rel;
+  while ((rel = nextRel(f, keepAttrs)).id) {
+    if (keepRel(&rel, filter)) return rel;
+  }
+
+  return OsmRel();
+}
+
+// _____________________________________________________________________________
+bool OsmBuilder::keepRel(OsmRel* rel, const OsmFilter& filter) const {
   uint64_t keepFlags = 0;
   uint64_t dropFlags = 0;
-  if (rel.id && rel.attrs.size() &&
-      (keepFlags = filter.keep(rel.attrs, OsmFilter::REL)) &&
-      !(dropFlags = filter.drop(rel.attrs, OsmFilter::REL))) {
-    rel.keepFlags = keepFlags;
-    rel.dropFlags = dropFlags;
-    return rel;
+  if (rel->id && rel->attrs.size() &&
+      (keepFlags = filter.keep(rel->attrs, OsmFilter::REL)) &&
+      !(dropFlags = filter.drop(rel->attrs, OsmFilter::REL))) {
+    rel->keepFlags = keepFlags;
+    rel->dropFlags = dropFlags;
+    return true;
   }
 
-  return OsmRel();
+  return false;
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::readRels(pfxml::file* xml, RelLst* rels, RelMap* nodeRels,
-                          RelMap* wayRels, const OsmFilter& filter,
-                          const AttrKeySet& keepAttrs,
-                          Restrictions* rests) const {
+template <typename OsmSrc>
+void OsmBuilder::readRels(OsmSrc* xml, const std::vector<OsmReadCtx*>& ctxs,
+                          const AttrKeySet& keepAttrs) const {
   OsmRel rel;
-  while ((rel = nextRel(xml, filter, keepAttrs)).id) {
-    rels->rels.push_back(rel.attrs);
-    if (rel.keepFlags & osm::REL_NO_DOWN) {
-      rels->flat.insert(rels->rels.size() - 1);
-    }
-    for (osmid id : rel.nodes) (*nodeRels)[id].push_back(rels->rels.size() - 1);
-    for (osmid id : rel.ways) (*wayRels)[id].push_back(rels->rels.size() - 1);
+  while ((rel = nextRel(xml, keepAttrs)).id) {
+    for (auto* ctx : ctxs) {
+      if (!keepRel(&rel, ctx->filter)) continue;
+
+      RelLst* rels = &ctx->rels;
+      rels->rels.push_back(rel.attrs);
+      if (rel.keepFlags & osm::REL_NO_DOWN) {
+        rels->flat.insert(rels->rels.size() - 1);
+      }
+      for (osmid id : rel.nodes)
+        ctx->nodeRels[id].push_back(rels->rels.size() - 1);
+      for (osmid id : rel.ways)
+        ctx->wayRels[id].push_back(rels->rels.size() - 1);
 
-    // TODO(patrick): this is not needed for the filtering - remove it here!
-    readRestr(rel, rests, filter);
+      // TODO(patrick): this is not needed for the filtering - remove it here!
+      readRestr(rel, &ctx->rawRests, ctx->filter);
+    }
   }
 }
 
@@ -1291,40 +1567,103 @@ std::set<Node*> OsmBuilder::snapStation(Graph* g, NodePL* s, EdgeGrid* eg,
                                         NodeGrid* sng, const OsmReadOpts& opts,
                                         Restrictor* restor, bool surrHeur,
                                         bool orphSnap, double d) {
-  assert(s->getSI());
-  std::set<Node*> ret;
+  return commitSnap(g, s,
+                    planSnap(*s, eg, sng, opts, surrHeur, orphSnap, d, false),
+                    eg, sng, opts, restor, orphSnap, d, 0);
+}
+
+// _____________________________________________________________________________
+pfaedle::osm::SnapPlan OsmBuilder::planSnap(const NodePL& s, EdgeGrid* eg,
+                                            NodeGrid* sng,
+                                            const OsmReadOpts& opts,
+                                            bool surrHeur, bool orphSnap,
+                                            double d, bool search) {
+  assert(s.getSI());
+  SnapPlan ret;
+  ret.geom = *s.getGeom();
+  ret.fallback = false;
+  bool inserts = false;
 
   EdgeCandPQ pq;
 
-  getEdgCands(*s->getGeom(), &pq, eg, d);
+  getEdgCands(*s.getGeom(), &pq, eg, d);
 
   if (pq.empty() && surrHeur) {
     // no station found in the first round, try again with the nearest
     // surrounding station with matching name
-    const Node* best = getMatchingNd(*s, sng, opts.maxSnapFallbackHeurDistance);
+    ret.fallback = true;
+    const Node* best = getMatchingNd(s, sng, opts.maxSnapFallbackHeurDistance);
     if (best) {
       getEdgCands(*best->pl().getGeom(), &pq, eg, d);
     } else {
       // if still no luck, get edge cands in fallback snap distance
-      getEdgCands(*s->getGeom(), &pq, eg, opts.maxSnapFallbackHeurDistance);
+      getEdgCands(*s.getGeom(), &pq, eg, opts.maxSnapFallbackHeurDistance);
     }
   }
 
   while (!pq.empty()) {
     auto* e = pq.top().second;
     pq.pop();
+    auto geom = util::geo::projectOn(*e->getFrom()->pl().getGeom(),
+                                     *s.getGeom(), *e->getTo()->pl().getGeom());
+    ret.cands.push_back(SnapCand{e, geom, false, 0, false});
+
+    // after an insertion, the graph around s has changed and the remaining
+    // candidates have to be searched again on commit
+    if (!search || inserts) continue;
+
+    auto& c = ret.cands.back();
+    c.searched = true;
+    c.eq = eqStatReach(e, s.getSI(), geom, 2 * d, 0, opts.maxAngleSnapReach,
+                       orphSnap);
+    c.blocked = !c.eq && e->pl().lvl() <= opts.maxSnapLevel &&
+                isBlocked(e, s.getSI(), geom, opts.maxBlockDistance, 0,
+                          opts.maxAngleSnapReach);
+    inserts = !c.eq && !c.blocked && e->pl().lvl() <= opts.maxSnapLevel;
+  }
+
+  return ret;
+}
+
+// _____________________________________________________________________________
+std::set<Node*> OsmBuilder::commitSnap(Graph* g, NodePL* s,
+                                       const SnapPlan& plan, EdgeGrid* eg,
+                                       NodeGrid* sng, const OsmReadOpts& opts,
+                                       Restrictor* restor, bool orphSnap,
+                                       double d, SnapChanges* chgs) {
+  assert(s->getSI());
+  std::set<Node*> ret;
+
+  // range of the searches below, changes outside of it cannot alter their
+  // results
+  double searchD = std::max(2 * d, opts.maxBlockDistance);
+
+  auto mark = [chgs](Node* n) {
+    if (chgs) chgs->dirty.add(*n->pl().getGeom(), n);
+  };
+
+  for (const auto& c : plan.cands) {
+    auto* e = c.e;
+    // s may have been moved onto a previous candidate edge
     auto geom =
         util::geo::projectOn(*e->getFrom()->pl().getGeom(), *s->getGeom(),
                              *e->getTo()->pl().getGeom());
 
-    Node* eq = 0;
-    if (!(eq = eqStatReach(e, s->getSI(), geom, 2 * d, 0,
-                           opts.maxAngleSnapReach, orphSnap))) {
+    Node* eq = c.eq;
+    bool blocked = c.blocked;
+
+    if (!c.searched || !(geom == c.geom) ||
+        changedNear(chgs, geom, searchD)) {
+      eq = eqStatReach(e, s->getSI(), geom, 2 * d, 0, opts.maxAngleSnapReach,
+                       orphSnap);
+      blocked = !eq && e->pl().lvl() <= opts.maxSnapLevel &&
+                isBlocked(e, s->getSI(), geom, opts.maxBlockDistance, 0,
+                          opts.maxAngleSnapReach);
+    }
+
+    if (!eq) {
       if (e->pl().lvl() > opts.maxSnapLevel) continue;
-      if (isBlocked(e, s->getSI(), geom, opts.maxBlockDistance, 0,
-                    opts.maxAngleSnapReach)) {
-        continue;
-      }
+      if (blocked) continue;
 
       // if the projected position is near (< 2 meters) the end point of this
       // way and the endpoint is not already a station, place the station there.
@@ -1333,11 +1672,13 @@ std::set<Node*> OsmBuilder::snapStation(Graph* g, NodePL* s, EdgeGrid* eg,
         e->getFrom()->pl().setSI(*s->getSI());
         if (s->getSI()->getGroup())
           s->getSI()->getGroup()->addNode(e->getFrom());
+        mark(e->getFrom());
         ret.insert(e->getFrom());
       } else if (!e->getTo()->pl().getSI() &&
                  webMercMeterDist(geom, *e->getTo()->pl().getGeom()) < 2) {
         e->getTo()->pl().setSI(*s->getSI());
         if (s->getSI()->getGroup()) s->getSI()->getGroup()->addNode(e->getTo());
+        mark(e->getTo());
         ret.insert(e->getTo());
       } else {
         s->setGeom(geom);
@@ -1365,6 +1706,11 @@ std::set<Node*> OsmBuilder::snapStation(Graph* g, NodePL* s, EdgeGrid* eg,
         // replace edge in restrictor
         restor->replaceEdge(e, ne, nf);
 
+        mark(n);
+        mark(e->getFrom());
+        mark(e->getTo());
+        if (chgs) chgs->deleted.insert(e);
+
         g->delEdg(e->getFrom(), e->getTo());
         eg->remove(e);
         ret.insert(n);
@@ -1384,6 +1730,43 @@ std::set<Node*> OsmBuilder::snapStation(Graph* g, NodePL* s, EdgeGrid* eg,
   return ret;
 }
 
+// _____________________________________________________________________________
+bool OsmBuilder::isStale(const SnapPlan& plan, const NodePL& s,
+                         const OsmReadOpts& opts, const SnapChanges& chgs) {
+  // the candidates were collected around another position
+  if (!(plan.geom == *s.getGeom())) return true;
+
+  // edges near s are only ever added by splitting a candidate edge
+  for (const auto& c : plan.cands) {
+    if (chgs.deleted.count(c.e)) return true;
+  }
+
+  // the fallback depends on the nearest matching station, which may be new
+  return plan.fallback &&
+         changedNear(&chgs, plan.geom, opts.maxSnapFallbackHeurDistance);
+}
+
+// _____________________________________________________________________________
+bool OsmBuilder::changedNear(const SnapChanges* chgs, const POINT& p,
+                             double d) {
+  if (!chgs) return false;
+
+  // searches follow edges whose length is at least the distance of their
+  // end points, allow for some slack in the distance approximation
+  d *= 1.1;
+
+  double distor = util::geo::webMercDistFactor(p);
+  std::set<Node*> neighs;
+  BOX box = util::geo::pad(util::geo::getBoundingBox(p), d / distor);
+  chgs->dirty.get(box, &neighs);
+
+  for (auto* n : neighs) {
+    if (webMercMeterDist(*n->pl().getGeom(), p) <= d) return true;
+  }
+
+  return false;
+}
+
 // _____________________________________________________________________________
 StatGroup* OsmBuilder::groupStats(const NodeSet& s) {
   if (!s.size()) return 0;
@@ -1413,14 +1796,16 @@ StatGroup* OsmBuilder::groupStats(const NodeSet& s) {
 
 // _____________________________________________________________________________
 std::vector<TransitEdgeLine*> OsmBuilder::getLines(
-    const std::vector<size_t>& edgeRels, const RelLst& rels,
-    const OsmReadOpts& ops) {
+    const std::vector<size_t>& edgeRels, OsmReadCtx* ctx) const {
+  const OsmReadOpts& ops = *ctx->opts;
+  const RelLst& rels = ctx->rels;
+
   std::vector<TransitEdgeLine*> ret;
   for (size_t relId : edgeRels) {
     TransitEdgeLine* elp = 0;
 
-    if (_relLines.count(relId)) {
-      elp = _relLines[relId];
+    if (ctx->relLines.count(relId)) {
+      elp = ctx->relLines[relId];
     } else {
       TransitEdgeLine el;
 
@@ -1463,13 +1848,13 @@ std::vector<TransitEdgeLine*> OsmBuilder::getLines(
       if (!el.shortName.size() && !el.fromStr.size() && !el.toStr.size())
         continue;
 
-      if (_lines.count(el)) {
-        elp = _lines[el];
-        _relLines[relId] = elp;
+      if (ctx->lines.count(el)) {
+        elp = ctx->lines[el];
+        ctx->relLines[relId] = elp;
       } else {
         elp = new TransitEdgeLine(el);
-        _lines[el] = elp;
-        _relLines[relId] = elp;
+        ctx->lines[el] = elp;
+        ctx->relLines[relId] = elp;
       }
     }
     ret.push_back(elp);
@@ -1680,45 +2065,122 @@ const EdgePL& OsmBuilder::mergeEdgePL(Edge* a, Edge* b) {
   return a->pl();
 }
 
+// _____________________________________________________________________________
+bool OsmBuilder::collapsible(Graph* g, Node* n, Edge** ea, Edge** eb) {
+  if (n->getOutDeg() + n->getInDeg() != 2 || n->pl().getSI()) return false;
+
+  if (n->getOutDeg() == 2) {
+    *ea = *n->getAdjListOut().begin();
+    *eb = *n->getAdjListOut().rbegin();
+  } else if (n->getInDeg() == 2) {
+    *ea = *n->getAdjListIn().begin();
+    *eb = *n->getAdjListIn().rbegin();
+  } else {
+    *ea = *n->getAdjListOut().begin();
+    *eb = *n->getAdjListIn().begin();
+  }
+
+  // important, we don't have a multigraph! if the same edge
+  // will already exist, leave this node
+  if (g->getEdg((*ea)->getOtherNd(n), (*eb)->getOtherNd(n))) return false;
+  if (g->getEdg((*eb)->getOtherNd(n), (*ea)->getOtherNd(n))) return false;
+
+  return edgesSim(*ea, *eb);
+}
+
 // _____________________________________________________________________________
 void OsmBuilder::collapseEdges(Graph* g) {
+  std::vector<Node*> cands;
   for (auto* n : *g->getNds()) {
-    if (n->getOutDeg() + n->getInDeg() != 2 || n->pl().getSI()) continue;
-
-    Edge* ea;
-    Edge* eb;
-    if (n->getOutDeg() == 2) {
-      ea = *n->getAdjListOut().begin();
-      eb = *n->getAdjListOut().rbegin();
-    } else if (n->getInDeg() == 2) {
-      ea = *n->getAdjListIn().begin();
-      eb = *n->getAdjListIn().rbegin();
-    } else {
-      ea = *n->getAdjListOut().begin();
-      eb = *n->getAdjListIn().begin();
+    if (n->getOutDeg() + n->getInDeg() == 2 && !n->pl().getSI())
+      cands.push_back(n);
+  }
+
+  // collapse in rounds. In each round, the candidates are checked in
+  // parallel, and a batch of nodes with pairwise disjoint neighborhoods is
+  // collapsed. As these collapses cannot influence each other, the edge
+  // geometries are merged in parallel, and only the graph changes are done
+  // sequentially afterwards.
+  while (cands.size()) {
+    std::vector<char> ok(cands.size());
+    std::vector<Edge*> eas(cands.size());
+    std::vector<Edge*> ebs(cands.size());
+
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < cands.size(); i++) {
+      ok[i] = collapsible(g, cands[i], &eas[i], &ebs[i]);
+    }
+
+    std::unordered_set<const Node*> locked;
+    std::vector<size_t> batch;
+    std::vector<Node*> next;
+    std::unordered_set<const Node*> inNext;
+
+    for (size_t i = 0; i < cands.size(); i++) {
+      // rejected candidates stay rejected until one of their neighbors is
+      // collapsed
+      if (!ok[i]) continue;
+
+      Node* n = cands[i];
+      const Node* a = eas[i]->getOtherNd(n);
+      const Node* b = ebs[i]->getOtherNd(n);
+      if (locked.count(n) || locked.count(a) || locked.count(b)) {
+        if (inNext.insert(n).second) next.push_back(n);
+        continue;
+      }
+      locked.insert(n);
+      locked.insert(a);
+      locked.insert(b);
+      batch.push_back(i);
     }
 
-    // important, we don't have a multigraph! if the same edge
-    // will already exist, leave this node
-    if (g->getEdg(ea->getOtherNd(n), eb->getOtherNd(n))) continue;
-    if (g->getEdg(eb->getOtherNd(n), ea->getOtherNd(n))) continue;
+    std::vector<Node*> froms(batch.size());
+    std::vector<Node*> tos(batch.size());
+    std::vector<const EdgePL*> pls(batch.size());
 
-    if (edgesSim(ea, eb)) {
+#pragma omp parallel for schedule(dynamic, 256)
+    for (size_t j = 0; j < batch.size(); j++) {
+      Node* n = cands[batch[j]];
+      Edge* ea = eas[batch[j]];
+      Edge* eb = ebs[batch[j]];
       if (ea->pl().oneWay() && ea->getOtherNd(n) != ea->getFrom()) {
-        g->addEdg(eb->getOtherNd(n), ea->getOtherNd(n), mergeEdgePL(eb, ea));
+        froms[j] = eb->getOtherNd(n);
+        tos[j] = ea->getOtherNd(n);
+        pls[j] = &mergeEdgePL(eb, ea);
       } else {
-        g->addEdg(ea->getOtherNd(n), eb->getOtherNd(n), mergeEdgePL(ea, eb));
+        froms[j] = ea->getOtherNd(n);
+        tos[j] = eb->getOtherNd(n);
+        pls[j] = &mergeEdgePL(ea, eb);
       }
+    }
+
+    for (size_t j = 0; j < batch.size(); j++) {
+      Edge* ea = eas[batch[j]];
+      Edge* eb = ebs[batch[j]];
+      g->addEdg(froms[j], tos[j], *pls[j]);
       g->delEdg(ea->getFrom(), ea->getTo());
       g->delEdg(eb->getFrom(), eb->getTo());
+
+      // the neighbors may now be collapsible
+      for (auto* nd : {froms[j], tos[j]}) {
+        if (nd->getOutDeg() + nd->getInDeg() == 2 && !nd->pl().getSI() &&
+            inNext.insert(nd).second) {
+          next.push_back(nd);
+        }
+      }
     }
+
+    cands.swap(next);
   }
 }
 
 // _____________________________________________________________________________
 void OsmBuilder::simplifyGeoms(Graph* g) {
-  for (auto* n : *g->getNds()) {
-    for (auto* e : n->getAdjListOut()) {
+  std::vector<Node*> nds(g->getNds()->begin(), g->getNds()->end());
+
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < nds.size(); i++) {
+    for (auto* e : nds[i]->getAdjListOut()) {
       (*e->pl().getGeom()) = util::geo::simplify(*e->pl().getGeom(), 0.5);
     }
   }
@@ -1726,39 +2188,76 @@ void OsmBuilder::simplifyGeoms(Graph* g) {
 
 // _____________________________________________________________________________
 uint32_t OsmBuilder::writeComps(Graph* g) {
-  Component* comp = new Component{7};
+  // the node set is ordered by address, so nodes can be found in this
+  // vector by binary search
+  std::vector<Node*> nds(g->getNds()->begin(), g->getNds()->end());
+  auto idx = [&nds](const Node* n) {
+    return std::lower_bound(nds.begin(), nds.end(), n) - nds.begin();
+  };
+
+  // union-find over all edges, linking the larger root to the smaller one
+  std::vector<std::atomic<size_t>> parent(nds.size());
+  for (size_t i = 0; i < nds.size(); i++) parent[i] = i;
+
+  auto find = [&parent](size_t x) {
+    while (true) {
+      size_t p = parent[x].load();
+      if (p == x) return x;
+      size_t gp = parent[p].load();
+      // path halving
+      if (p != gp) parent[x].compare_exchange_weak(p, gp);
+      x = gp;
+    }
+  };
+
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < nds.size(); i++) {
+    for (auto* e : nds[i]->getAdjListOut()) {
+      size_t a = find(i);
+      size_t b = find(idx(e->getTo()));
+      while (a != b) {
+        if (a < b) std::swap(a, b);
+        size_t exp = a;
+        if (parent[a].compare_exchange_strong(exp, b)) break;
+        a = find(a);
+        b = find(b);
+      }
+    }
+  }
+
+  std::vector<size_t> roots(nds.size());
+  std::vector<Component*> comps(nds.size(), 0);
   uint32_t numC = 0;
 
-  for (auto* n : *g->getNds()) {
-    if (!n->pl().getComp()) {
-      std::stack<std::pair<Node*, Edge*>> q;
-      q.push(std::pair<Node*, Edge*>(n, 0));
-      while (!q.empty()) {
-        std::pair<Node*, Edge*> cur = q.top();
-        q.pop();
-
-        cur.first->pl().setComp(comp);
-        for (auto* e : cur.first->getAdjListOut()) {
-          if (e->pl().lvl() < comp->minEdgeLvl)
-            comp->minEdgeLvl = e->pl().lvl();
-          if (!e->getOtherNd(cur.first)->pl().getComp())
-            q.push(std::pair<Node*, Edge*>(e->getOtherNd(cur.first), e));
-        }
-        for (auto* e : cur.first->getAdjListIn()) {
-          if (e->pl().lvl() < comp->minEdgeLvl)
-            comp->minEdgeLvl = e->pl().lvl();
-          if (!e->getOtherNd(cur.first)->pl().getComp())
-            q.push(std::pair<Node*, Edge*>(e->getOtherNd(cur.first), e));
-        }
-      }
+#pragma omp parallel for
+  for (size_t i = 0; i < nds.size(); i++) roots[i] = find(i);
+
+  for (size_t i = 0; i < nds.size(); i++) {
+    if (roots[i] != i) continue;
+    comps[i] = new Component{7};
+    numC++;
+  }
 
-      numC++;
-      comp = new Component{7};
+  // minimum edge level per component
+  std::vector<std::atomic<uint8_t>> lvls(nds.size());
+  for (size_t i = 0; i < nds.size(); i++) lvls[i] = 7;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (size_t i = 0; i < nds.size(); i++) {
+    auto& lvl = lvls[roots[i]];
+    for (auto* e : nds[i]->getAdjListOut()) {
+      uint8_t l = e->pl().lvl();
+      uint8_t cur = lvl.load();
+      while (l < cur && !lvl.compare_exchange_weak(cur, l)) continue;
     }
   }
 
-  // the last comp was not used
-  delete comp;
+  // setComp() counts the nodes per component in a shared map, and is not
+  // thread safe
+  for (size_t i = 0; i < nds.size(); i++) {
+    nds[i]->pl().setComp(comps[roots[i]]);
+    if (comps[i]) comps[i]->minEdgeLvl = lvls[i];
+  }
 
   return numC;
 }
@@ -1870,34 +2369,83 @@ void OsmBuilder::snapStats(const OsmReadOpts& opts, Graph* g,
 
   std::vector<const Stop*> notSnapped;
 
+  std::vector<const Stop*> stops;
+  std::vector<NodePL> pls;
+  stops.reserve(fs->size());
+  pls.reserve(fs->size());
   for (auto& s : *fs) {
-    bool snapped = false;
-    auto pl = plFromGtfs(s.first, opts);
-    for (size_t i = 0; i < opts.maxSnapDistances.size(); i++) {
-      double d = opts.maxSnapDistances[i];
+    stops.push_back(s.first);
+    pls.push_back(plFromGtfs(s.first, opts));
+  }
+
+  // changes are looked up within the range of the searches, use small cells
+  double maxD = 0;
+  for (double d : opts.maxSnapDistances) maxD = std::max(maxD, d);
+  double cellSize = std::max(2 * maxD, opts.maxBlockDistance) + 1;
+
+  std::vector<bool> snapped(stops.size(), false);
+  std::vector<SnapPlan> plans(stops.size());
+  size_t stale = 0;
+
+  // snap all stops with the first distance, then all stops with the second
+  // distance, and so on
+  for (size_t i = 0; i < opts.maxSnapDistances.size(); i++) {
+    double d = opts.maxSnapDistances[i];
+    bool surrHeur = i == opts.maxSnapDistances.size() - 1;
+
+    // first phase: collect candidate edges and do the (expensive) equal
+    // station and blocker searches for all stops in parallel, without
+    // changing the graph
+#pragma omp parallel for schedule(dynamic, 16)
+    for (size_t k = 0; k < stops.size(); k++) {
+      plans[k] = planSnap(pls[k], &eg, &sng, opts, surrHeur, false, d, true);
+    }
+
+    // second phase: commit the plans in order. Searches of a plan are redone
+    // if the graph was changed within their range by a previous commit, and
+    // plans whose candidate edges changed are redone completely.
+    SnapChanges chgs(cellSize, bbox.getFullWebMercBox());
+
+    for (size_t k = 0; k < stops.size(); k++) {
+      NodeSet r;
+      if (isStale(plans[k], pls[k], opts, chgs)) {
+        stale++;
+        r = commitSnap(g, &pls[k],
+                       planSnap(pls[k], &eg, &sng, opts, surrHeur, false, d,
+                                false),
+                       &eg, &sng, opts, res, false, d, &chgs);
+      } else {
+        r = commitSnap(g, &pls[k], plans[k], &eg, &sng, opts, res, false, d,
+                       &chgs);
+      }
 
-      StatGroup* group = groupStats(
-          snapStation(g, &pl, &eg, &sng, opts, res,
-                      i == opts.maxSnapDistances.size() - 1, false, d));
+      StatGroup* group = groupStats(r);
 
       if (group) {
-        group->addStop(s.first);
-        (*fs)[s.first] = *group->getNodes().begin();
-        snapped = true;
+        group->addStop(stops[k]);
+        (*fs)[stops[k]] = *group->getNodes().begin();
+        snapped[k] = true;
       }
     }
-    if (!snapped) {
-      LOG(VDEBUG) << "Could not snap station "
-                  << "(" << pl.getSI()->getName() << ")"
-                  << " (" << s.first->getLat() << "," << s.first->getLng()
-                  << ") in normal run, trying again later in orphan mode.";
-      if (!bbox.contains(*pl.getGeom())) {
-        LOG(VDEBUG) << "Note: '" << pl.getSI()->getName()
-                    << "' does not lie within the bounds for this graph and "
-                       "may be a stray station";
-      }
-      notSnapped.push_back(s.first);
+  }
+
+  LOG(DEBUG) << "Snapped " << stops.size() << " stations, " << stale << " of "
+             << stops.size() * opts.maxSnapDistances.size()
+             << " snap plans had to be redone.";
+
+  for (size_t k = 0; k < stops.size(); k++) {
+    if (snapped[k]) continue;
+    const auto& pl = pls[k];
+    LOG(VDEBUG) << "Could not snap station "
+                << "(" << pl.getSI()->getName() << ")"
+                << " (" << stops[k]->getLat() << "," << stops[k]->getLng()
+                << ") in normal run, trying again later in orphan mode.";
+    if (!bbox.contains(*pl.getGeom())) {
+      LOG(VDEBUG) << "Note: '" << pl.getSI()->getName()
+                  << "' does not lie within the bounds for this graph and "
+                     "may be a stray station";
     }
+    notSnapped.push_back(stops[k]);
   }
 
   if (notSnapped.size())
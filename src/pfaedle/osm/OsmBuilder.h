@@ -17,6 +17,7 @@
 #include "pfaedle/osm/OsmFilter.h"
 #include "pfaedle/osm/OsmIdSet.h"
 #include "pfaedle/osm/OsmReadOpts.h"
+#include "pfaedle/osm/PbfReader.h"
 #include "pfaedle/osm/Restrictor.h"
 #include "pfaedle/router/Router.h"
 #include "pfaedle/trgraph/Graph.h"
@@ -77,6 +78,69 @@ inline bool operator<(const NodeCand& a, const NodeCand& b) {
 
 typedef std::priority_queue<NodeCand> NodeCandPQ;
 
+/*
+ * Snapping of a station onto a single candidate edge: the projected position
+ * and, if searched is set, the results of the equal station and blocker
+ * searches from there on the graph as it was when the plan was made
+ */
+struct SnapCand {
+  Edge* e;
+  POINT geom;
+  bool searched;
+  Node* eq;
+  bool blocked;
+};
+
+/*
+ * Candidate edges for snapping a station at position geom, in the order in
+ * which they are tried
+ */
+struct SnapPlan {
+  POINT geom;
+  bool fallback;
+  std::vector<SnapCand> cands;
+};
+
+/*
+ * Graph changes made by station snapping, used to detect snap plans which
+ * were made before and are now stale
+ */
+struct SnapChanges {
+  SnapChanges(double cellSize, const BOX& webMercBox)
+      : dirty(cellSize, cellSize, webMercBox, false) {}
+
+  // nodes which were added, split or got a station
+  NodeGrid dirty;
+  std::set<const Edge*> deleted;
+};
+
+/*
+ * State of a single graph build while the OSM file is read
+ */
+struct OsmReadCtx {
+  OsmReadCtx() : opts(0), g(0), res(0) {}
+
+  const OsmReadOpts* opts;
+  OsmFilter filter;
+  AttrKeySet attrKeys[3];
+
+  Graph* g;
+  Restrictor* res;
+
+  OsmIdSet noHupNodes;
+  NIdMap nodes;
+  NIdMultMap multNodes;
+  RelLst rels;
+  RelMap nodeRels, wayRels;
+  Restrictions rawRests;
+
+  NodeSet orphanStations;
+  EdgTracks eTracks;
+
+  std::map<TransitEdgeLine, TransitEdgeLine*> lines;
+  std::map<size_t, TransitEdgeLine*> relLines;
+};
+
 /*
  * Builds a physical transit network graph from OSM data
  */
@@ -90,6 +154,14 @@ class OsmBuilder {
             const BBoxIdx& box, size_t gridSize, router::FeedStops* fs,
             Restrictor* res);
 
+  // Read the OSM file at path once and build a graph for each of the given
+  // options. gs, fss and ress hold the output per entry in opts.
+  void read(const std::string& path,
+            const std::vector<const OsmReadOpts*>& opts,
+            const std::vector<Graph*>& gs, const BBoxIdx& box,
+            size_t gridSize, const std::vector<router::FeedStops*>& fss,
+            const std::vector<Restrictor*>& ress);
+
   // Based on the list of options, output an overpass XML query for getting
   // the data needed for routing
   void overpassQryWrite(std::ostream* out, const std::vector<OsmReadOpts>& opts,
@@ -102,49 +174,74 @@ class OsmBuilder {
                    const std::vector<OsmReadOpts>& opts, const BBoxIdx& box);
 
  private:
+  // The passes of read() and filterWrite(), OsmSrc is either a pfxml::file
+  // or a PbfReader
+  template <typename OsmSrc>
+  void readPasses(OsmSrc* f, const BBoxIdx& bbox,
+                  const std::vector<OsmReadCtx*>& ctxs);
+
+  template <typename OsmSrc>
+  void filterWritePasses(OsmSrc* f, util::xml::XmlWriter* wr, OsmReadCtx* ctx,
+                         const BBoxIdx& bbox);
+
   pfxml::parser_state readBBoxNds(pfxml::file* xml, OsmIdSet* nodes,
-                               OsmIdSet* noHupNodes, const OsmFilter& filter,
-                               const BBoxIdx& bbox) const;
+                                  const std::vector<OsmReadCtx*>& ctxs,
+                                  const BBoxIdx& bbox) const;
 
-  void readRels(pfxml::file* f, RelLst* rels, RelMap* nodeRels, RelMap* wayRels,
-                const OsmFilter& filter, const AttrKeySet& keepAttrs,
-                Restrictions* rests) const;
+  PbfState readBBoxNds(PbfReader* pbf, OsmIdSet* nodes,
+                       const std::vector<OsmReadCtx*>& ctxs,
+                       const BBoxIdx& bbox) const;
+
+  template <typename OsmSrc>
+  void readRels(OsmSrc* f, const std::vector<OsmReadCtx*>& ctxs,
+                const AttrKeySet& keepAttrs) const;
 
   void readRestr(const OsmRel& rel, Restrictions* rests,
                  const OsmFilter& filter) const;
 
-  void readNodes(pfxml::file* f, Graph* g, const RelLst& rels,
-                 const RelMap& nodeRels, const OsmFilter& filter,
-                 const OsmIdSet& bBoxNodes, NIdMap* nodes,
-                 NIdMultMap* multNodes, NodeSet* orphanStations,
-                 const AttrKeySet& keepAttrs, const FlatRels& flatRels,
-                 const OsmReadOpts& opts) const;
+  template <typename OsmSrc>
+  void readNodes(OsmSrc* f, const std::vector<OsmReadCtx*>& ctxs,
+                 const OsmIdSet& bBoxNodes, const AttrKeySet& keepAttrs) const;
+
+  void addNode(const OsmNode& nd, OsmReadCtx* ctx,
+               StAttrGroups* attrGroups) const;
 
-  void readWriteNds(pfxml::file* i, util::xml::XmlWriter* o,
+  template <typename OsmSrc>
+  void readWriteNds(OsmSrc* i, util::xml::XmlWriter* o,
                     const RelMap& nodeRels, const OsmFilter& filter,
                     const OsmIdSet& bBoxNodes, NIdMap* nodes,
                     const AttrKeySet& keepAttrs, const FlatRels& f) const;
 
-  void readWriteWays(pfxml::file* i, util::xml::XmlWriter* o, OsmIdList* ways,
+  template <typename OsmSrc>
+  void readWriteWays(OsmSrc* i, util::xml::XmlWriter* o, OsmIdList* ways,
                      const AttrKeySet& keepAttrs) const;
 
-  void readWriteRels(pfxml::file* i, util::xml::XmlWriter* o, OsmIdList* ways,
+  template <typename OsmSrc>
+  void readWriteRels(OsmSrc* i, util::xml::XmlWriter* o, OsmIdList* ways,
                      NIdMap* nodes, const OsmFilter& filter,
                      const AttrKeySet& keepAttrs);
 
-  void readEdges(pfxml::file* xml, Graph* g, const RelLst& rels,
-                 const RelMap& wayRels, const OsmFilter& filter,
-                 const OsmIdSet& bBoxNodes, NIdMap* nodes,
-                 NIdMultMap* multNodes, const OsmIdSet& noHupNodes,
-                 const AttrKeySet& keepAttrs, const Restrictions& rest,
-                 Restrictor* restor, const FlatRels& flatRels,
-                 EdgTracks* etracks, const OsmReadOpts& opts);
+  template <typename OsmSrc>
+  void readEdges(OsmSrc* xml, const std::vector<OsmReadCtx*>& ctxs,
+                 const OsmIdSet& bBoxNodes, const AttrKeySet& keepAttrs);
+
+  void addEdges(const OsmWay& w, const OsmIdSet& bBoxNodes, OsmReadCtx* ctx);
 
-  void readEdges(pfxml::file* xml, const RelMap& wayRels, const OsmFilter& filter,
+  template <typename OsmSrc>
+  void readEdges(OsmSrc* xml, const RelMap& wayRels, const OsmFilter& filter,
                  const OsmIdSet& bBoxNodes, const AttrKeySet& keepAttrs,
                  OsmIdList* ret, NIdMap* nodes, const FlatRels& flatRels);
 
-  OsmWay nextWay(pfxml::file* xml, const RelMap& wayRels, const OsmFilter& filter,
+  // Return the next way, node or relation, without any filtering
+  OsmWay nextWay(pfxml::file* xml, const AttrKeySet& keepAttrs) const;
+  OsmWay nextWay(PbfReader* pbf, const AttrKeySet& keepAttrs) const;
+  OsmNode nextNode(pfxml::file* xml, const AttrKeySet& keepAttrs) const;
+  OsmNode nextNode(PbfReader* pbf, const AttrKeySet& keepAttrs) const;
+  OsmRel nextRel(pfxml::file* xml, const AttrKeySet& keepAttrs) const;
+  OsmRel nextRel(PbfReader* pbf, const AttrKeySet& keepAttrs) const;
+
+  template <typename OsmSrc>
+  OsmWay nextWay(OsmSrc* f, const RelMap& wayRels, const OsmFilter& filter,
                  const OsmIdSet& bBoxNodes, const AttrKeySet& keepAttrs,
                  const FlatRels& flatRels) const;
 
@@ -154,7 +251,11 @@ class OsmBuilder {
   OsmWay nextWayWithId(pfxml::file* xml, osmid wid,
                        const AttrKeySet& keepAttrs) const;
 
-  OsmNode nextNode(pfxml::file* xml, NIdMap* nodes, NIdMultMap* multNodes,
+  OsmWay nextWayWithId(PbfReader* pbf, osmid wid,
+                       const AttrKeySet& keepAttrs) const;
+
+  template <typename OsmSrc>
+  OsmNode nextNode(OsmSrc* f, NIdMap* nodes, NIdMultMap* multNodes,
                    const RelMap& nodeRels, const OsmFilter& filter,
                    const OsmIdSet& bBoxNodes, const AttrKeySet& keepAttrs,
                    const FlatRels& flatRels) const;
@@ -164,15 +265,25 @@ class OsmBuilder {
                 const OsmIdSet& bBoxNodes, const OsmFilter& filter,
                 const FlatRels& fl) const;
 
-  OsmRel nextRel(pfxml::file* xml, const OsmFilter& filter,
+  template <typename OsmSrc>
+  OsmRel nextRel(OsmSrc* f, const OsmFilter& filter,
                  const AttrKeySet& keepAttrs) const;
 
+  // Check rel against filter, and write the matching keep / drop flags
+  bool keepRel(OsmRel* rel, const OsmFilter& filter) const;
+
  protected:
   Nullable<StatInfo> getStatInfo(Node* node, osmid nid, const POINT& pos,
                                  const AttrMap& m, StAttrGroups* groups,
                                  const RelMap& nodeRels, const RelLst& rels,
                                  const OsmReadOpts& ops) const;
 
+  // Post-process the raw graph g read from the OSM file
+  static void buildGraph(const OsmReadOpts& opts, Graph* g,
+                         const BBoxIdx& bbox, size_t gridSize,
+                         router::FeedStops* fs, Restrictor* res,
+                         const NodeSet& orphanStations, EdgTracks* eTracks);
+
   static void snapStats(const OsmReadOpts& opts, Graph* g, const BBoxIdx& bbox,
                         size_t gridSize, router::FeedStops* fs, Restrictor* res,
                         const NodeSet& orphanStations);
@@ -189,6 +300,10 @@ class OsmBuilder {
 
   static void fixGaps(Graph* g, NodeGrid* ng);
   static void collapseEdges(Graph* g);
+
+  // True if n can be collapsed into a single edge from its two edges, which
+  // are written to ea and eb
+  static bool collapsible(Graph* g, Node* n, Edge** ea, Edge** eb);
   static void writeODirEdgs(Graph* g, Restrictor* restor);
   static void writeSelfEdgs(Graph* g);
   static void writeEdgeTracks(const EdgTracks& tracks);
@@ -208,6 +323,27 @@ class OsmBuilder {
                              const OsmReadOpts& opts, Restrictor* restor,
                              bool surHeur, bool orphSnap, double maxD);
 
+  // Collect the candidate edges for snapping s, without changing anything.
+  // If search is set, also do the equal station and blocker searches up to
+  // the first candidate on which s would be inserted into the graph.
+  static SnapPlan planSnap(const NodePL& s, EdgeGrid* eg, NodeGrid* sng,
+                           const OsmReadOpts& opts, bool surHeur,
+                           bool orphSnap, double maxD, bool search);
+
+  // Snap s to the graph as given by plan. Searches of the plan are redone if
+  // the graph changed near them, changes are recorded in chgs (may be 0).
+  static NodeSet commitSnap(Graph* g, NodePL* s, const SnapPlan& plan,
+                            EdgeGrid* eg, NodeGrid* sng,
+                            const OsmReadOpts& opts, Restrictor* restor,
+                            bool orphSnap, double maxD, SnapChanges* chgs);
+
+  // True if plan for s can no longer be committed, because its candidate
+  // edges may have changed
+  static bool isStale(const SnapPlan& plan, const NodePL& s,
+                      const OsmReadOpts& opts, const SnapChanges& chgs);
+
+  static bool changedNear(const SnapChanges* chgs, const POINT& p, double d);
+
   // Checks if from the edge e, a station similar to si can be reach with less
   // than maxD distance and less or equal to "maxFullTurns" full turns. If
   // such a station exists, it is returned. If not, 0 is returned.
@@ -228,12 +364,12 @@ class OsmBuilder {
   static NodePL plFromGtfs(const Stop* s, const OsmReadOpts& ops);
 
   std::vector<TransitEdgeLine*> getLines(const std::vector<size_t>& edgeRels,
-                                         const RelLst& rels,
-                                         const OsmReadOpts& ops);
+                                         OsmReadCtx* ctx) const;
 
   void getKeptAttrKeys(const OsmReadOpts& opts, AttrKeySet sets[3]) const;
 
   void skipUntil(pfxml::file* xml, const std::string& s) const;
+  void skipUntil(PbfReader* pbf, const std::string& s) const;
 
   void processRestr(osmid nid, osmid wid, const Restrictions& rawRests, Edge* e,
                     Node* n, Restrictor* restor) const;
@@ -253,9 +389,6 @@ class OsmBuilder {
                       const RelMap& entRels, const RelLst& rels) const;
 
   bool relKeep(osmid id, const RelMap& rels, const FlatRels& fl) const;
-
-  std::map<TransitEdgeLine, TransitEdgeLine*> _lines;
-  std::map<size_t, TransitEdgeLine*> _relLines;
 };
 }  // namespace osm
 }  // namespace pfaedle
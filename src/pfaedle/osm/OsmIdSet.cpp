@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <algorithm>
+#include <chrono>
 #include <cassert>
 #include <climits>
 #include <cstdlib>
@@ -13,24 +14,61 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "pfaedle/Def.h"
 #include "pfaedle/osm/OsmIdSet.h"
 
 using pfaedle::osm::OsmIdSet;
+using pfaedle::osm::OsmIdSetBackend;
+using pfaedle::osm::osmid;
 
 size_t OsmIdSet::LOOKUPS = 0;
 size_t OsmIdSet::FLOOKUPS = 0;
+size_t OsmIdSet::MEM_LAT_NS = 0;
+size_t OsmIdSet::MEM_LAT_SAMPLES = 0;
+size_t OsmIdSet::DISK_LAT_NS = 0;
+size_t OsmIdSet::DISK_LAT_SAMPLES = 0;
+size_t OsmIdSet::SPILLS = 0;
+OsmIdSetBackend OsmIdSet::DEFAULT_BACKEND = pfaedle::osm::OSMIDSET_AUTO;
 
 // _____________________________________________________________________________
-OsmIdSet::OsmIdSet()
-    : _closed(false),
+OsmIdSet::OsmIdSet() : OsmIdSet(DEFAULT_BACKEND) {}
+
+// _____________________________________________________________________________
+OsmIdSet::OsmIdSet(OsmIdSetBackend backend)
+    : _backend(backend),
+      _mem(0),
+      _memBudget(0),
+      _closed(false),
+      _file(-1),
+      _buffer(0),
+      _outBuffer(0),
       _sorted(true),
       _last(0),
       _smallest(-1),
       _biggest(0),
       _obufpos(0),
       _curBlock(-1),
+      _bitset(0),
       _fsize(0) {
+  if (_backend == OSMIDSET_DISK) {
+    initDisk();
+  } else {
+    _mem = new IdBitmap();
+    if (_backend == OSMIDSET_AUTO) _memBudget = memBudget();
+  }
+}
+
+// _____________________________________________________________________________
+OsmIdSet::~OsmIdSet() {
+  delete _mem;
+  delete _bitset;
+  delete[] _buffer;
+  delete[] _outBuffer;
+}
+
+// _____________________________________________________________________________
+void OsmIdSet::initDisk() {
   _bitset = new std::bitset<BLOOMF_BITS>();
   _file = openTmpFile();
 
@@ -39,25 +77,68 @@ OsmIdSet::OsmIdSet()
 }
 
 // _____________________________________________________________________________
-OsmIdSet::~OsmIdSet() {
-  delete _bitset;
-  delete[] _buffer;
-  if (!_closed) delete[] _outBuffer;
+size_t OsmIdSet::memBudget() {
+  // allow the bitmap to take 1/8 of the currently available physical memory
+  long pages = sysconf(_SC_AVPHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGE_SIZE);
+  if (pages < 0 || pageSize < 0) return 256 * 1024 * 1024;
+  return (static_cast<size_t>(pages) * static_cast<size_t>(pageSize)) / 8;
+}
+
+// _____________________________________________________________________________
+void OsmIdSet::spill() {
+  // move the in-memory ids to the disk-based set, the ids are already sorted
+  initDisk();
+
+  std::vector<osmid> ids;
+  _mem->getIds(&ids);
+  delete _mem;
+  _mem = 0;
+
+  for (osmid id : ids) {
+    diskAdd(id);
+    bloomAdd(id);
+  }
+
+  _sorted = true;
+  if (ids.size()) _last = ids.back();
+  SPILLS++;
 }
 
 // _____________________________________________________________________________
 void OsmIdSet::add(osmid id) {
   if (_closed) throw std::exception();
+
+  if (id < _smallest) _smallest = id;
+  if (id > _biggest) _biggest = id;
+
+  if (_mem) {
+    _mem->add(id);
+    if (_memBudget && _mem->bytes() > _memBudget) spill();
+    return;
+  }
+
   diskAdd(id);
 
   if (_last > id) _sorted = false;
   _last = id;
-  if (id < _smallest) _smallest = id;
-  if (id > _biggest) _biggest = id;
 
+  bloomAdd(id);
+}
+
+// _____________________________________________________________________________
+void OsmIdSet::bloomAdd(osmid id) {
   for (int i = 0; i < 10; i++) (*_bitset)[hash(id, i)] = 1;
 }
 
+// _____________________________________________________________________________
+bool OsmIdSet::bloomHas(osmid id) const {
+  for (int i = 0; i < 10; i++) {
+    if ((*_bitset)[hash(id, i)] == 0) return false;
+  }
+  return true;
+}
+
 // _____________________________________________________________________________
 void OsmIdSet::diskAdd(osmid id) {
   memcpy(_outBuffer + _obufpos, &id, 8);
@@ -129,21 +210,39 @@ bool OsmIdSet::has(osmid id) const {
     return false;
   }
 
-  for (int i = 0; i < 10; i++) {
-    if ((*_bitset)[hash(id, i)] == 0) return false;
+  if (LOOKUPS % LAT_SAMPLE_RATE != 0) {
+    if (_mem) return _mem->has(id);
+    return bloomHas(id) && diskHas(id);
+  }
+
+  // sample the lookup latency
+  auto t1 = std::chrono::high_resolution_clock::now();
+  bool has = _mem ? _mem->has(id) : bloomHas(id) && diskHas(id);
+  auto t2 = std::chrono::high_resolution_clock::now();
+  size_t ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+
+  if (_mem) {
+    MEM_LAT_NS += ns;
+    MEM_LAT_SAMPLES++;
+  } else {
+    DISK_LAT_NS += ns;
+    DISK_LAT_SAMPLES++;
   }
 
-  bool has = diskHas(id);
   return has;
 }
 
 // _____________________________________________________________________________
 void OsmIdSet::close() const {
+  _closed = true;
+  if (_mem) return;
+
   ssize_t w = cwrite(_file, _outBuffer, _obufpos);
   _fsize += w;
   _blockEnds.push_back(_biggest);
   delete[] _outBuffer;
-  _closed = true;
+  _outBuffer = 0;
 
   // if order was not sorted, sort now
   if (!_sorted) sort();
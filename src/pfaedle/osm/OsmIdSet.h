@@ -11,6 +11,7 @@
 #include <set>
 #include <string>
 #include <vector>
+#include "pfaedle/osm/IdBitmap.h"
 #include "pfaedle/osm/Osm.h"
 
 #ifndef POSIX_FADV_SEQUENTIAL
@@ -27,31 +28,61 @@ static const size_t OBUFFER_S = 8 * 1024 * 1024;
 
 #define BLOOMF_BITS 400000000
 
+// only every LAT_SAMPLE_RATE'th lookup is timed
+static const size_t LAT_SAMPLE_RATE = 64;
+
+enum OsmIdSetBackend { OSMIDSET_AUTO, OSMIDSET_DISK, OSMIDSET_MEM };
+
 /*
- * A disk-based set for OSM ids. Read-access for checking the presence is
- * reduced by a bloom filter
+ * A set for OSM ids. Ids are either kept in a compressed in-memory bitmap,
+ * or in a disk-based set where read-access for checking the presence is
+ * reduced by a bloom filter. In auto mode, the set starts in memory and
+ * spills to disk once the bitmap outgrows its share of the available RAM.
  */
 class OsmIdSet {
  public:
   OsmIdSet();
+  explicit OsmIdSet(OsmIdSetBackend backend);
   ~OsmIdSet();
 
+  OsmIdSet(const OsmIdSet&) = delete;
+  OsmIdSet& operator=(const OsmIdSet&) = delete;
+
   // Add an OSM id
   void add(osmid id);
 
   // Check if an OSM id is contained
   bool has(osmid id) const;
 
+  // True if the ids are currently held in memory
+  bool inMemory() const { return _mem; }
+
+  // Backend used by the default constructor
+  static OsmIdSetBackend DEFAULT_BACKEND;
+
   // Count the number of lookups and file lookups for debugging
   static size_t LOOKUPS;
   static size_t FLOOKUPS;
 
+  // Sampled lookup latencies (sum in ns, number of samples) per backend
+  static size_t MEM_LAT_NS;
+  static size_t MEM_LAT_SAMPLES;
+  static size_t DISK_LAT_NS;
+  static size_t DISK_LAT_SAMPLES;
+
+  // Number of sets that were spilled from memory to disk
+  static size_t SPILLS;
+
  private:
+  OsmIdSetBackend _backend;
+  IdBitmap* _mem;
+  size_t _memBudget;
+
   std::string _tmpPath;
   mutable bool _closed;
   mutable int _file;
   unsigned char* _buffer;
-  unsigned char* _outBuffer;
+  mutable unsigned char* _outBuffer;
   mutable bool _sorted;
   osmid _last;
   osmid _smallest;
@@ -72,6 +103,11 @@ class OsmIdSet {
   uint32_t jenkins(uint32_t in) const;
   uint32_t hash(uint32_t in, int i) const;
   void diskAdd(osmid id);
+  void bloomAdd(osmid id);
+  bool bloomHas(osmid id) const;
+  void initDisk();
+  void spill();
+  static size_t memBudget();
   void close() const;
   void sort() const;
   bool diskHas(osmid id) const;
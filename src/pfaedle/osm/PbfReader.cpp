@@ -0,0 +1,549 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#endif
+
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "pfaedle/osm/PbfReader.h"
+
+using pfaedle::osm::PbfEntity;
+using pfaedle::osm::PbfMember;
+using pfaedle::osm::PbfParseExc;
+using pfaedle::osm::PbfReader;
+using pfaedle::osm::PbfState;
+using pfaedle::osm::PbfTag;
+using pfaedle::osm::PbfType;
+
+namespace {
+
+const size_t MAX_HEADER_SIZE = 64 * 1024;
+const size_t MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+/*
+ * Minimal protocol buffer message iterator
+ */
+class PbfMsg {
+ public:
+  PbfMsg(const char* c, size_t n)
+      : _c(reinterpret_cast<const uint8_t*>(c)), _end(_c + n) {}
+
+  // Advance to the next field, returns false at the end of the message
+  bool next() {
+    if (_c >= _end) return false;
+    uint64_t key = varint();
+    field = key >> 3;
+    switch (key & 7) {
+      case 0:
+        val = varint();
+        data = 0;
+        len = 0;
+        break;
+      case 1:
+        skip(8);
+        break;
+      case 2:
+        len = varint();
+        data = reinterpret_cast<const char*>(_c);
+        skip(len);
+        break;
+      case 5:
+        skip(4);
+        break;
+      default:
+        throw PbfParseExc("unsupported wire type");
+    }
+    return true;
+  }
+
+  uint64_t varint() {
+    uint64_t ret = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+      if (_c >= _end) throw PbfParseExc("truncated varint");
+      uint8_t b = *_c++;
+      ret |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return ret;
+    }
+    throw PbfParseExc("varint too long");
+  }
+
+  bool atEnd() const { return _c >= _end; }
+
+  uint32_t field;
+  uint64_t val;
+  const char* data;
+  size_t len;
+
+ private:
+  const uint8_t* _c;
+  const uint8_t* _end;
+
+  void skip(size_t n) {
+    if (static_cast<size_t>(_end - _c) < n) throw PbfParseExc("truncated");
+    _c += n;
+  }
+};
+
+// _____________________________________________________________________________
+inline int64_t zigzag(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+// _____________________________________________________________________________
+// Read a packed (or single non-packed) repeated varint field into ret
+void packed(const PbfMsg& m, std::vector<uint64_t>* ret) {
+  ret->clear();
+  if (m.len == 0 && m.data == 0) {
+    ret->push_back(m.val);
+    return;
+  }
+  PbfMsg p(m.data, m.len);
+  while (!p.atEnd()) ret->push_back(p.varint());
+}
+
+}  // namespace
+
+// _____________________________________________________________________________
+PbfReader::PbfReader(const std::string& path)
+    : _file(path, std::ios::binary),
+      _fileSize(0),
+      _nextOffset(0),
+      _curBlock(0),
+      _curEnt(0) {
+  memset(&_end, 0, sizeof(_end));
+  if (!_file.good()) throw PbfParseExc("could not open " + path);
+
+  _file.seekg(0, std::ios::end);
+  _fileSize = _file.tellg();
+  _file.seekg(0);
+
+  readHeader();
+  skipEmpty();
+}
+
+// _____________________________________________________________________________
+bool PbfReader::isPbf(const std::string& path) {
+  std::ifstream f(path, std::ios::binary);
+  unsigned char len[4];
+  if (!f.read(reinterpret_cast<char*>(len), 4)) return false;
+
+  size_t hlen = (len[0] << 24) | (len[1] << 16) | (len[2] << 8) | len[3];
+  if (hlen == 0 || hlen > MAX_HEADER_SIZE) return false;
+
+  std::vector<char> buf(hlen);
+  if (!f.read(&buf[0], hlen)) return false;
+
+  try {
+    PbfMsg m(&buf[0], hlen);
+    while (m.next()) {
+      if (m.field == 1) return std::string(m.data, m.len) == "OSMHeader";
+    }
+  } catch (const PbfParseExc& e) {
+    return false;
+  }
+  return false;
+}
+
+// _____________________________________________________________________________
+const PbfEntity& PbfReader::get() const {
+  if (_curBlock >= _batch.size()) return _end;
+  return _batch[_curBlock].ents[_curEnt];
+}
+
+// _____________________________________________________________________________
+bool PbfReader::next() {
+  if (_curBlock >= _batch.size()) return false;
+  _curEnt++;
+  return skipEmpty();
+}
+
+// _____________________________________________________________________________
+bool PbfReader::skipEmpty() {
+  while (true) {
+    while (_curBlock < _batch.size() &&
+           _curEnt >= _batch[_curBlock].ents.size()) {
+      _curBlock++;
+      _curEnt = 0;
+    }
+    if (_curBlock < _batch.size()) return true;
+    if (!loadBatch(_nextOffset)) return false;
+  }
+}
+
+// _____________________________________________________________________________
+PbfState PbfReader::state() const {
+  if (_curBlock >= _batch.size()) return PbfState{_fileSize, 0};
+  return PbfState{_batch[_curBlock].offset, _curEnt};
+}
+
+// _____________________________________________________________________________
+void PbfReader::set_state(const PbfState& s) {
+  for (size_t i = 0; i < _batch.size(); i++) {
+    if (_batch[i].offset == s.offset) {
+      _curBlock = i;
+      _curEnt = s.ent;
+      skipEmpty();
+      return;
+    }
+  }
+
+  loadBatch(s.offset);
+  _curEnt = s.ent;
+  skipEmpty();
+}
+
+// _____________________________________________________________________________
+bool PbfReader::loadBatch(uint64_t offset) {
+  _batch.clear();
+  _curBlock = 0;
+  _curEnt = 0;
+  _nextOffset = offset;
+
+  // read a few blobs per thread sequentially, decode them in parallel
+  std::vector<RawBlob> raw(2 * omp_get_max_threads());
+  size_t n = 0;
+  std::string type;
+  while (n < raw.size() && readBlob(&raw[n], &type)) {
+    if (type == "OSMData") n++;
+  }
+
+  if (n == 0) return false;
+  _batch.resize(n);
+
+  std::string err;
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < n; i++) {
+    try {
+      decode(raw[i], &_batch[i]);
+    } catch (const PbfParseExc& e) {
+#pragma omp critical
+      err = e.what();
+    }
+  }
+
+  if (err.size()) throw PbfParseExc(err);
+  return true;
+}
+
+// _____________________________________________________________________________
+bool PbfReader::readBlob(RawBlob* blob, std::string* type) {
+  if (_nextOffset >= _fileSize) return false;
+
+  _file.clear();
+  _file.seekg(_nextOffset);
+
+  unsigned char len[4];
+  if (!_file.read(reinterpret_cast<char*>(len), 4)) return false;
+  size_t hlen = (len[0] << 24) | (len[1] << 16) | (len[2] << 8) | len[3];
+  if (hlen > MAX_HEADER_SIZE) throw PbfParseExc("blob header too large");
+
+  std::vector<char> hbuf(hlen);
+  if (hlen && !_file.read(&hbuf[0], hlen)) throw PbfParseExc("truncated");
+
+  size_t dataSize = 0;
+  type->clear();
+  PbfMsg h(hlen ? &hbuf[0] : 0, hlen);
+  while (h.next()) {
+    if (h.field == 1) *type = std::string(h.data, h.len);
+    if (h.field == 3) dataSize = h.val;
+  }
+
+  if (dataSize > MAX_BLOB_SIZE) throw PbfParseExc("blob too large");
+
+  std::vector<char> bbuf(dataSize);
+  if (dataSize && !_file.read(&bbuf[0], dataSize))
+    throw PbfParseExc("truncated");
+
+  blob->offset = _nextOffset;
+  blob->data.clear();
+  blob->rawSize = 0;
+  blob->zlib = false;
+
+  PbfMsg b(dataSize ? &bbuf[0] : 0, dataSize);
+  while (b.next()) {
+    if (b.field == 1) {
+      blob->data.assign(b.data, b.data + b.len);
+      blob->rawSize = b.len;
+    } else if (b.field == 2) {
+      blob->rawSize = b.val;
+    } else if (b.field == 3) {
+      blob->data.assign(b.data, b.data + b.len);
+      blob->zlib = true;
+    } else if (b.field >= 4 && b.field <= 7) {
+      throw PbfParseExc("unsupported blob compression");
+    }
+  }
+
+  _nextOffset += 4 + hlen + dataSize;
+  return true;
+}
+
+// _____________________________________________________________________________
+void PbfReader::readHeader() {
+  RawBlob blob;
+  std::string type;
+  if (!readBlob(&blob, &type) || type != "OSMHeader")
+    throw PbfParseExc("missing OSMHeader");
+
+  std::vector<char> buf;
+  inflate(blob, &buf);
+
+  PbfMsg m(buf.size() ? &buf[0] : 0, buf.size());
+  while (m.next()) {
+    if (m.field != 4) continue;
+    std::string feature(m.data, m.len);
+    if (feature != "OsmSchema-V0.6" && feature != "DenseNodes")
+      throw PbfParseExc("unsupported required feature " + feature);
+  }
+}
+
+// _____________________________________________________________________________
+void PbfReader::inflate(const RawBlob& blob, std::vector<char>* out) {
+  if (!blob.zlib) {
+    *out = blob.data;
+    return;
+  }
+#ifdef ZLIB_FOUND
+  out->resize(blob.rawSize);
+  if (blob.rawSize > MAX_BLOB_SIZE) throw PbfParseExc("blob too large");
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit(&zs) != Z_OK) throw PbfParseExc("zlib init failed");
+
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(blob.data.data()));
+  zs.avail_in = blob.data.size();
+  zs.next_out = reinterpret_cast<Bytef*>(out->data());
+  zs.avail_out = out->size();
+
+  int r = ::inflate(&zs, Z_FINISH);
+  inflateEnd(&zs);
+
+  if (r != Z_STREAM_END || zs.total_out != blob.rawSize)
+    throw PbfParseExc("could not decompress blob");
+#else
+  (void)out;
+  throw PbfParseExc("zlib compressed blobs are not supported in this build");
+#endif
+}
+
+// _____________________________________________________________________________
+void PbfReader::decode(const RawBlob& blob, Block* ret) {
+  std::vector<char> buf;
+  inflate(blob, &buf);
+
+  ret->offset = blob.offset;
+
+  int64_t gran = 100, latOffs = 0, lngOffs = 0;
+
+  // first pass: string table and coordinate encoding
+  PbfMsg m(buf.size() ? &buf[0] : 0, buf.size());
+  while (m.next()) {
+    if (m.field == 1) {
+      PbfMsg st(m.data, m.len);
+      while (st.next()) {
+        if (st.field != 1) continue;
+        ret->strs.push_back(ret->strBuf.size());
+        ret->strBuf.insert(ret->strBuf.end(), st.data, st.data + st.len);
+        ret->strBuf.push_back(0);
+      }
+    } else if (m.field == 17) {
+      gran = m.val;
+    } else if (m.field == 19) {
+      latOffs = m.val;
+    } else if (m.field == 20) {
+      lngOffs = m.val;
+    }
+  }
+
+  // second pass: primitive groups
+  PbfMsg g(buf.size() ? &buf[0] : 0, buf.size());
+  while (g.next()) {
+    if (g.field == 2) decodeGroup(g.data, g.len, gran, latOffs, lngOffs, ret);
+  }
+
+  // the entity vectors are final now, resolve the entity pointers
+  for (auto& e : ret->ents) {
+    e.tags = e.numTags ? &ret->tags[e.tagBeg] : 0;
+    e.refs = e.numRefs ? &ret->refs[e.refBeg] : 0;
+    e.members = e.numMembers ? &ret->members[e.memBeg] : 0;
+  }
+}
+
+// _____________________________________________________________________________
+void PbfReader::decodeGroup(const char* c, size_t n, int64_t gran,
+                            int64_t latOffs, int64_t lngOffs, Block* ret) {
+  PbfMsg m(c, n);
+  while (m.next()) {
+    switch (m.field) {
+      case 1:
+        decodeNode(m.data, m.len, gran, latOffs, lngOffs, ret);
+        break;
+      case 2:
+        decodeDense(m.data, m.len, gran, latOffs, lngOffs, ret);
+        break;
+      case 3:
+        decodeWay(m.data, m.len, ret);
+        break;
+      case 4:
+        decodeRel(m.data, m.len, ret);
+        break;
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void PbfReader::decodeDense(const char* c, size_t n, int64_t gran,
+                            int64_t latOffs, int64_t lngOffs, Block* ret) {
+  std::vector<uint64_t> ids, lats, lngs, kvs;
+  PbfMsg m(c, n);
+  while (m.next()) {
+    if (m.field == 1) packed(m, &ids);
+    if (m.field == 8) packed(m, &lats);
+    if (m.field == 9) packed(m, &lngs);
+    if (m.field == 10) packed(m, &kvs);
+  }
+
+  if (lats.size() != ids.size() || lngs.size() != ids.size())
+    throw PbfParseExc("inconsistent dense nodes");
+
+  int64_t id = 0, lat = 0, lng = 0;
+  size_t kv = 0;
+  for (size_t i = 0; i < ids.size(); i++) {
+    id += zigzag(ids[i]);
+    lat += zigzag(lats[i]);
+    lng += zigzag(lngs[i]);
+
+    PbfEntity e;
+    memset(&e, 0, sizeof(e));
+    e.type = PBF_NODE;
+    e.id = id;
+    e.lat = 1e-9 * (latOffs + gran * lat);
+    e.lng = 1e-9 * (lngOffs + gran * lng);
+    e.tagBeg = ret->tags.size();
+
+    // keys and values are interleaved, tags of one node end with a 0
+    while (kv < kvs.size() && kvs[kv] != 0) {
+      if (kv + 1 >= kvs.size()) throw PbfParseExc("inconsistent dense tags");
+      ret->tags.push_back({str(*ret, kvs[kv]), str(*ret, kvs[kv + 1])});
+      kv += 2;
+    }
+    kv++;
+
+    e.numTags = ret->tags.size() - e.tagBeg;
+    ret->ents.push_back(e);
+  }
+}
+
+// _____________________________________________________________________________
+void PbfReader::decodeNode(const char* c, size_t n, int64_t gran,
+                           int64_t latOffs, int64_t lngOffs, Block* ret) {
+  std::vector<uint64_t> keys, vals;
+  PbfEntity e;
+  memset(&e, 0, sizeof(e));
+  e.type = PBF_NODE;
+
+  PbfMsg m(c, n);
+  while (m.next()) {
+    if (m.field == 1) e.id = zigzag(m.val);
+    if (m.field == 2) packed(m, &keys);
+    if (m.field == 3) packed(m, &vals);
+    if (m.field == 8) e.lat = 1e-9 * (latOffs + gran * zigzag(m.val));
+    if (m.field == 9) e.lng = 1e-9 * (lngOffs + gran * zigzag(m.val));
+  }
+
+  if (keys.size() != vals.size()) throw PbfParseExc("inconsistent node tags");
+
+  e.tagBeg = ret->tags.size();
+  for (size_t i = 0; i < keys.size(); i++)
+    ret->tags.push_back({str(*ret, keys[i]), str(*ret, vals[i])});
+  e.numTags = keys.size();
+  ret->ents.push_back(e);
+}
+
+// _____________________________________________________________________________
+void PbfReader::decodeWay(const char* c, size_t n, Block* ret) {
+  std::vector<uint64_t> keys, vals, refs;
+  PbfEntity e;
+  memset(&e, 0, sizeof(e));
+  e.type = PBF_WAY;
+
+  PbfMsg m(c, n);
+  while (m.next()) {
+    if (m.field == 1) e.id = m.val;
+    if (m.field == 2) packed(m, &keys);
+    if (m.field == 3) packed(m, &vals);
+    if (m.field == 8) packed(m, &refs);
+  }
+
+  if (keys.size() != vals.size()) throw PbfParseExc("inconsistent way tags");
+
+  e.tagBeg = ret->tags.size();
+  for (size_t i = 0; i < keys.size(); i++)
+    ret->tags.push_back({str(*ret, keys[i]), str(*ret, vals[i])});
+  e.numTags = keys.size();
+
+  e.refBeg = ret->refs.size();
+  int64_t ref = 0;
+  for (auto r : refs) {
+    ref += zigzag(r);
+    ret->refs.push_back(ref);
+  }
+  e.numRefs = refs.size();
+  ret->ents.push_back(e);
+}
+
+// _____________________________________________________________________________
+void PbfReader::decodeRel(const char* c, size_t n, Block* ret) {
+  std::vector<uint64_t> keys, vals, roles, memIds, types;
+  PbfEntity e;
+  memset(&e, 0, sizeof(e));
+  e.type = PBF_REL;
+
+  PbfMsg m(c, n);
+  while (m.next()) {
+    if (m.field == 1) e.id = m.val;
+    if (m.field == 2) packed(m, &keys);
+    if (m.field == 3) packed(m, &vals);
+    if (m.field == 8) packed(m, &roles);
+    if (m.field == 9) packed(m, &memIds);
+    if (m.field == 10) packed(m, &types);
+  }
+
+  if (keys.size() != vals.size() || roles.size() != memIds.size() ||
+      types.size() != memIds.size())
+    throw PbfParseExc("inconsistent relation");
+
+  e.tagBeg = ret->tags.size();
+  for (size_t i = 0; i < keys.size(); i++)
+    ret->tags.push_back({str(*ret, keys[i]), str(*ret, vals[i])});
+  e.numTags = keys.size();
+
+  e.memBeg = ret->members.size();
+  int64_t ref = 0;
+  for (size_t i = 0; i < memIds.size(); i++) {
+    ref += zigzag(memIds[i]);
+    // member types are NODE = 0, WAY = 1, RELATION = 2
+    PbfType t = types[i] == 0 ? PBF_NODE : types[i] == 1 ? PBF_WAY : PBF_REL;
+    ret->members.push_back({t, static_cast<osmid>(ref), str(*ret, roles[i])});
+  }
+  e.numMembers = memIds.size();
+  ret->ents.push_back(e);
+}
+
+// _____________________________________________________________________________
+const char* PbfReader::str(const Block& b, uint64_t i) {
+  if (i >= b.strs.size()) throw PbfParseExc("invalid string table index");
+  return &b.strBuf[b.strs[i]];
+}
@@ -0,0 +1,138 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_OSM_PBFREADER_H_
+#define PFAEDLE_OSM_PBFREADER_H_
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "pfaedle/osm/Osm.h"
+
+namespace pfaedle {
+namespace osm {
+
+enum PbfType : uint8_t { PBF_NONE = 0, PBF_NODE = 1, PBF_WAY = 2, PBF_REL = 3 };
+
+struct PbfTag {
+  const char* k;
+  const char* v;
+};
+
+struct PbfMember {
+  PbfType type;
+  osmid ref;
+  const char* role;
+};
+
+/*
+ * A single decoded OSM entity. All pointers are only valid until the reader
+ * it was obtained from is advanced.
+ */
+struct PbfEntity {
+  PbfType type;
+  osmid id;
+  double lat;
+  double lng;
+
+  const PbfTag* tags;
+  size_t numTags;
+
+  // node refs of ways
+  const osmid* refs;
+  size_t numRefs;
+
+  // members of relations
+  const PbfMember* members;
+  size_t numMembers;
+
+  // positions of the above in the decoded block, only used while decoding
+  size_t tagBeg, refBeg, memBeg;
+};
+
+struct PbfState {
+  uint64_t offset;
+  size_t ent;
+};
+
+class PbfParseExc : public std::runtime_error {
+ public:
+  explicit PbfParseExc(const std::string& msg)
+      : std::runtime_error("PBF parse error: " + msg) {}
+};
+
+/*
+ * Reader for OSM PBF files. Blobs are read in batches and decoded in
+ * parallel, entities are then iterated in file order, the same way
+ * pfxml::file iterates over top-level XML tags.
+ */
+class PbfReader {
+ public:
+  explicit PbfReader(const std::string& path);
+
+  // True if the file at path looks like an OSM PBF file
+  static bool isPbf(const std::string& path);
+
+  // The current entity, of type PBF_NONE if the end of the file was reached
+  const PbfEntity& get() const;
+
+  // Advance to the next entity, returns false at the end of the file
+  bool next();
+
+  // Return / restore the current position
+  PbfState state() const;
+  void set_state(const PbfState& s);
+
+ private:
+  struct RawBlob {
+    uint64_t offset;
+    std::vector<char> data;
+    size_t rawSize;
+    bool zlib;
+  };
+
+  struct Block {
+    uint64_t offset;
+    std::vector<char> strBuf;
+    std::vector<size_t> strs;
+    std::vector<PbfEntity> ents;
+    std::vector<PbfTag> tags;
+    std::vector<osmid> refs;
+    std::vector<PbfMember> members;
+  };
+
+  std::ifstream _file;
+  uint64_t _fileSize;
+
+  // file offset of the next blob not yet in the current batch
+  uint64_t _nextOffset;
+
+  std::vector<Block> _batch;
+  size_t _curBlock;
+  size_t _curEnt;
+
+  PbfEntity _end;
+
+  bool loadBatch(uint64_t offset);
+  bool readBlob(RawBlob* blob, std::string* type);
+  void readHeader();
+  bool skipEmpty();
+
+  static void inflate(const RawBlob& blob, std::vector<char>* out);
+  static void decode(const RawBlob& blob, Block* ret);
+  static void decodeGroup(const char* c, size_t n, int64_t gran,
+                          int64_t latOffs, int64_t lngOffs, Block* ret);
+  static void decodeDense(const char* c, size_t n, int64_t gran,
+                          int64_t latOffs, int64_t lngOffs, Block* ret);
+  static void decodeNode(const char* c, size_t n, int64_t gran,
+                         int64_t latOffs, int64_t lngOffs, Block* ret);
+  static void decodeWay(const char* c, size_t n, Block* ret);
+  static void decodeRel(const char* c, size_t n, Block* ret);
+  static const char* str(const Block& b, uint64_t i);
+};
+}  // namespace osm
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_OSM_PBFREADER_H_
@@ -6,6 +6,8 @@
 #include "util/log/Log.h"
 
 using pfaedle::osm::Restrictor;
+using pfaedle::osm::RulePair;
+using pfaedle::osm::Rules;
 
 // _____________________________________________________________________________
 void Restrictor::relax(osmid wid, const trgraph::Node* n,
@@ -153,3 +155,19 @@ void Restrictor::replaceEdge(const trgraph::Edge* old, const trgraph::Node* via,
     }
   }
 }
+
+// _____________________________________________________________________________
+const Rules& Restrictor::getPosRules() const { return _pos; }
+
+// _____________________________________________________________________________
+const Rules& Restrictor::getNegRules() const { return _neg; }
+
+// _____________________________________________________________________________
+void Restrictor::addRule(const trgraph::Node* via, const RulePair& rule,
+                         bool pos) {
+  if (pos) {
+    _pos[via].push_back(rule);
+  } else {
+    _neg[via].push_back(rule);
+  }
+}
@@ -42,6 +42,13 @@ class Restrictor {
                      const trgraph::Edge* newE);
   void duplicateEdge(const trgraph::Edge* old, const trgraph::Edge* newE);
 
+  // Return the positive and negative rules, keyed by via node
+  const Rules& getPosRules() const;
+  const Rules& getNegRules() const;
+
+  // Add a fully resolved rule at node via
+  void addRule(const trgraph::Node* via, const RulePair& rule, bool pos);
+
  private:
   Rules _pos;
   Rules _neg;
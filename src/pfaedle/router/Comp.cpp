@@ -0,0 +1,60 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "pfaedle/router/Comp.h"
+
+using util::Sym;
+
+static const size_t SIMI_SHARDS = 64;
+
+struct SimiShard {
+  std::mutex m;
+  std::unordered_map<uint64_t, bool> simi;
+};
+
+static SimiShard STAT_SIMI[SIMI_SHARDS];
+static SimiShard LINE_SIMI[SIMI_SHARDS];
+
+// _____________________________________________________________________________
+template <typename F>
+static double memoSimi(SimiShard* shards, const Sym& a, const Sym& b, F f) {
+  if (a == b) return 1;
+  if (a.empty() || b.empty()) return 0;
+
+  // both similarities are symmetric
+  uint64_t k = (static_cast<uint64_t>(std::min(a.id(), b.id())) << 32) |
+               std::max(a.id(), b.id());
+  SimiShard& s = shards[(k ^ (k >> 29)) % SIMI_SHARDS];
+
+  {
+    std::lock_guard<std::mutex> lock(s.m);
+    auto i = s.simi.find(k);
+    if (i != s.simi.end()) return i->second;
+  }
+
+  bool simi = f(a.str(), b.str()) > 0.5;
+
+  std::lock_guard<std::mutex> lock(s.m);
+  s.simi[k] = simi;
+  return simi;
+}
+
+// _____________________________________________________________________________
+double pfaedle::router::statSimi(const Sym& a, const Sym& b) {
+  return memoSimi(STAT_SIMI, a, b,
+                  [](const std::string& a, const std::string& b) {
+                    return statSimi(a, b);
+                  });
+}
+
+// _____________________________________________________________________________
+double pfaedle::router::lineSimi(const Sym& a, const Sym& b) {
+  return memoSimi(LINE_SIMI, a, b,
+                  [](const std::string& a, const std::string& b) {
+                    return lineSimi(a, b);
+                  });
+}
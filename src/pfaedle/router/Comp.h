@@ -8,6 +8,7 @@
 #include <iostream>
 #include <algorithm>
 #include <string>
+#include "util/Interner.h"
 #include "util/String.h"
 
 namespace pfaedle {
@@ -86,6 +87,12 @@ inline double lineSimi(const std::string& a, const std::string& b) {
 
   return 0;
 }
+
+// Memoized statSimi() of two interned names, thread safe
+double statSimi(const util::Sym& a, const util::Sym& b);
+
+// Memoized lineSimi() of two interned names, thread safe
+double lineSimi(const util::Sym& a, const util::Sym& b);
 }  // namespace router
 }  // namespace pfaedle
 
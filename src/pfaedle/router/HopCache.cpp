@@ -0,0 +1,32 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <utility>
+#include "pfaedle/router/HopCache.h"
+
+using pfaedle::router::HopCache;
+using pfaedle::router::HopCacheKey;
+using pfaedle::router::EdgeCost;
+using pfaedle::router::EdgeList;
+
+// _____________________________________________________________________________
+HopCache::HopCache(size_t maxBytes, size_t numShards)
+    : _lru(maxBytes, numShards, "hop_cache", "hop cache") {}
+
+// _____________________________________________________________________________
+bool HopCache::get(size_t attrs, const trgraph::Edge* from,
+                   const trgraph::Edge* to, EdgeCost* c, EdgeList* edges) {
+  return _lru.get(HopCacheKey{attrs, from, to}, [c, edges](const Hop& hop) {
+    *c = hop.first;
+    *edges = hop.second;
+  });
+}
+
+// _____________________________________________________________________________
+void HopCache::put(size_t attrs, const trgraph::Edge* from,
+                   const trgraph::Edge* to, const EdgeCost& c,
+                   const EdgeList& edges) {
+  _lru.put(HopCacheKey{attrs, from, to}, Hop(c, edges),
+           edges.size() * sizeof(trgraph::Edge*));
+}
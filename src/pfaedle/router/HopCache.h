@@ -0,0 +1,67 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_ROUTER_HOPCACHE_H_
+#define PFAEDLE_ROUTER_HOPCACHE_H_
+
+#include <utility>
+#include "pfaedle/router/HopLru.h"
+#include "pfaedle/router/Misc.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace router {
+
+struct HopCacheKey {
+  size_t attrs;
+  const trgraph::Edge* from;
+  const trgraph::Edge* to;
+};
+
+inline bool operator==(const HopCacheKey& a, const HopCacheKey& b) {
+  return a.attrs == b.attrs && a.from == b.from && a.to == b.to;
+}
+
+struct HopCacheKeyHash {
+  size_t operator()(const HopCacheKey& k) const {
+    size_t h = std::hash<const trgraph::Edge*>()(k.from);
+    h ^= std::hash<const trgraph::Edge*>()(k.to) + 0x9e3779b9 + (h << 6) +
+         (h >> 2);
+    h ^= k.attrs + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
+typedef HopLruStats HopCacheStats;
+
+/*
+ * Hop cache shared between all routing threads. Entries are keyed by
+ * (routing attributes id, from edge, to edge) and kept in a sharded LRU map.
+ */
+class HopCache {
+ public:
+  // Init a cache holding at most maxBytes (approx.) of hops in numShards
+  // shards
+  HopCache(size_t maxBytes, size_t numShards);
+
+  // Look up hop from -> to, write the result to c and edges on a hit
+  bool get(size_t attrs, const trgraph::Edge* from, const trgraph::Edge* to,
+           EdgeCost* c, EdgeList* edges);
+
+  // Insert (or refresh) hop from -> to
+  void put(size_t attrs, const trgraph::Edge* from, const trgraph::Edge* to,
+           const EdgeCost& c, const EdgeList& edges);
+
+  HopCacheStats getStats() const { return _lru.getStats(); }
+
+ private:
+  typedef std::pair<EdgeCost, EdgeList> Hop;
+
+  HopLru<HopCacheKey, Hop, HopCacheKeyHash> _lru;
+};
+
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_HOPCACHE_H_
@@ -0,0 +1,25 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <map>
+#include <mutex>
+#include "pfaedle/router/HopLru.h"
+
+using pfaedle::router::RoutingAttrs;
+
+namespace {
+std::mutex attrsMutex;
+std::map<RoutingAttrs, size_t> attrsIds;
+}  // namespace
+
+// _____________________________________________________________________________
+size_t pfaedle::router::getAttrsId(const RoutingAttrs& rAttrs) {
+  std::lock_guard<std::mutex> lock(attrsMutex);
+  auto i = attrsIds.find(rAttrs);
+  if (i != attrsIds.end()) return i->second;
+
+  size_t id = attrsIds.size();
+  attrsIds[rAttrs] = id;
+  return id;
+}
@@ -0,0 +1,91 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_ROUTER_HOPLRU_H_
+#define PFAEDLE_ROUTER_HOPLRU_H_
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pfaedle/router/RoutingAttrs.h"
+#include "util/Counter.h"
+
+namespace pfaedle {
+namespace router {
+
+struct HopLruStats {
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  size_t entries;
+  size_t bytes;
+};
+
+// Return a process-wide stable id for the routing attributes rAttrs, to be
+// used in the keys of the hop cache and the hop memo. Takes a global lock,
+// so resolve it once per route, not per hop.
+size_t getAttrsId(const RoutingAttrs& rAttrs);
+
+/*
+ * Memory bounded LRU map from keys K to values V, shared between threads.
+ * The entries are distributed over a fixed number of independently locked
+ * shards by the hash H of their key. Each shard holds an equal part of the
+ * memory budget and evicts least recently used entries once it is exceeded.
+ */
+template <typename K, typename V, typename H>
+class HopLru {
+ public:
+  // Init an LRU map holding at most maxBytes (approx.) in numShards shards.
+  // Its counters are registered as <name>_hits, <name>_misses and
+  // <name>_evictions, desc names the map in their help texts.
+  HopLru(size_t maxBytes, size_t numShards, const std::string& name,
+         const std::string& desc);
+
+  // Look up k, on a hit mark it as most recently used and call f with its
+  // value while the shard is still locked
+  template <typename F>
+  bool get(const K& k, F f);
+
+  // Insert (or replace) the value of k. heapBytes are the bytes k and v
+  // hold outside of their own objects.
+  void put(K k, V v, size_t heapBytes);
+
+  HopLruStats getStats() const;
+
+ private:
+  struct Entry {
+    K key;
+    V val;
+    size_t bytes;
+  };
+
+  typedef std::list<Entry> LruList;
+
+  struct Shard {
+    mutable std::mutex m;
+    LruList lru;
+    std::unordered_map<K, typename LruList::iterator, H> idx;
+    size_t bytes;
+  };
+
+  size_t _maxShardBytes;
+  std::vector<Shard> _shards;
+
+  util::Counter _hits;
+  util::Counter _misses;
+  util::Counter _evictions;
+
+  Shard& getShard(const K& k);
+};
+
+#include "pfaedle/router/HopLru.tpp"
+
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_HOPLRU_H_
@@ -0,0 +1,86 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+// _____________________________________________________________________________
+template <typename K, typename V, typename H>
+HopLru<K, V, H>::HopLru(size_t maxBytes, size_t numShards,
+                        const std::string& name, const std::string& desc)
+    : _maxShardBytes(maxBytes / std::max<size_t>(numShards, 1)),
+      _shards(std::max<size_t>(numShards, 1)),
+      _hits(name + "_hits", "Lookups that hit the " + desc),
+      _misses(name + "_misses", "Lookups that missed the " + desc),
+      _evictions(name + "_evictions", "Entries evicted from the " + desc) {
+  for (auto& s : _shards) s.bytes = 0;
+}
+
+// _____________________________________________________________________________
+template <typename K, typename V, typename H>
+template <typename F>
+bool HopLru<K, V, H>::get(const K& k, F f) {
+  Shard& s = getShard(k);
+
+  std::lock_guard<std::mutex> lock(s.m);
+  auto i = s.idx.find(k);
+  if (i == s.idx.end()) {
+    _misses++;
+    return false;
+  }
+
+  // mark as most recently used
+  s.lru.splice(s.lru.begin(), s.lru, i->second);
+
+  f(static_cast<const V&>(i->second->val));
+  _hits++;
+  return true;
+}
+
+// _____________________________________________________________________________
+template <typename K, typename V, typename H>
+void HopLru<K, V, H>::put(K k, V v, size_t heapBytes) {
+  // list node + index node with a copy of the key + heap payload
+  size_t bytes = sizeof(Entry) + sizeof(K) + 5 * sizeof(void*) + heapBytes;
+  if (bytes > _maxShardBytes) return;
+
+  Shard& s = getShard(k);
+
+  std::lock_guard<std::mutex> lock(s.m);
+  auto i = s.idx.find(k);
+  if (i != s.idx.end()) {
+    s.bytes -= i->second->bytes;
+    s.lru.erase(i->second);
+    s.idx.erase(i);
+  }
+
+  while (s.lru.size() && s.bytes + bytes > _maxShardBytes) {
+    s.bytes -= s.lru.back().bytes;
+    s.idx.erase(s.lru.back().key);
+    s.lru.pop_back();
+    _evictions++;
+  }
+
+  s.lru.push_front(Entry{std::move(k), std::move(v), bytes});
+  s.idx[s.lru.front().key] = s.lru.begin();
+  s.bytes += bytes;
+}
+
+// _____________________________________________________________________________
+template <typename K, typename V, typename H>
+HopLruStats HopLru<K, V, H>::getStats() const {
+  HopLruStats ret{_hits, _misses, _evictions, 0, 0};
+  for (auto& s : _shards) {
+    std::lock_guard<std::mutex> lock(s.m);
+    ret.entries += s.lru.size();
+    ret.bytes += s.bytes;
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+template <typename K, typename V, typename H>
+typename HopLru<K, V, H>::Shard& HopLru<K, V, H>::getShard(const K& k) {
+  // the low bits of the pointer hash are mostly alignment, mix them first
+  size_t h = H()(k);
+  h ^= h >> 17;
+  return _shards[h % _shards.size()];
+}
@@ -0,0 +1,72 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <set>
+#include <utility>
+#include <vector>
+#include "pfaedle/router/HopMemo.h"
+
+using pfaedle::router::HopMemo;
+using pfaedle::router::HopMemoKey;
+using pfaedle::router::HopEdgeLists;
+using pfaedle::router::HopCosts;
+
+// _____________________________________________________________________________
+HopMemo::HopMemo(size_t maxBytes, size_t numShards)
+    : _lru(maxBytes, numShards, "hop_memo", "hop memo of stop pairs") {}
+
+// _____________________________________________________________________________
+bool HopMemo::get(size_t attrs, const trgraph::StatGroup* tgGrp,
+                  const std::set<trgraph::Edge*>& froms,
+                  const std::set<trgraph::Edge*>& tos,
+                  const HopEdgeLists& edgesRet, HopCosts* costs) {
+  return _lru.get(key(attrs, tgGrp, froms, tos), [&](const Hops& hops) {
+    size_t j = 0;
+    for (auto from : froms) {
+      const auto& row = edgesRet.at(from);
+      auto& costRow = (*costs)[from];
+      for (auto to : tos) {
+        *row.at(to) = hops.edges[j];
+        costRow[to] = hops.costs[j];
+        j++;
+      }
+    }
+  });
+}
+
+// _____________________________________________________________________________
+void HopMemo::put(size_t attrs, const trgraph::StatGroup* tgGrp,
+                  const std::set<trgraph::Edge*>& froms,
+                  const std::set<trgraph::Edge*>& tos,
+                  const HopEdgeLists& edges, const HopCosts& costs) {
+  Hops hops;
+  // key (twice, in the entry and the index) + matrix
+  size_t n = froms.size() * tos.size();
+  size_t bytes = 2 * (froms.size() + tos.size()) * sizeof(trgraph::Edge*) +
+                 n * (sizeof(EdgeCost) + sizeof(EdgeList));
+  hops.costs.reserve(n);
+  hops.edges.reserve(n);
+
+  for (auto from : froms) {
+    const auto& row = edges.at(from);
+    const auto& costRow = costs.at(from);
+    for (auto to : tos) {
+      hops.edges.push_back(*row.at(to));
+      hops.costs.push_back(costRow.at(to));
+      bytes += hops.edges.back().size() * sizeof(trgraph::Edge*);
+    }
+  }
+
+  _lru.put(key(attrs, tgGrp, froms, tos), std::move(hops), bytes);
+}
+
+// _____________________________________________________________________________
+HopMemoKey HopMemo::key(size_t attrs, const trgraph::StatGroup* tgGrp,
+                        const std::set<trgraph::Edge*>& froms,
+                        const std::set<trgraph::Edge*>& tos) {
+  return HopMemoKey{
+      attrs, tgGrp,
+      std::vector<const trgraph::Edge*>(froms.begin(), froms.end()),
+      std::vector<const trgraph::Edge*>(tos.begin(), tos.end())};
+}
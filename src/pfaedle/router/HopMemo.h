@@ -0,0 +1,93 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_ROUTER_HOPMEMO_H_
+#define PFAEDLE_ROUTER_HOPMEMO_H_
+
+#include <set>
+#include <vector>
+#include "pfaedle/router/HopLru.h"
+#include "pfaedle/router/Misc.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace router {
+
+struct HopMemoKey {
+  size_t attrs;
+  const trgraph::StatGroup* tgGrp;
+  std::vector<const trgraph::Edge*> froms;
+  std::vector<const trgraph::Edge*> tos;
+};
+
+inline bool operator==(const HopMemoKey& a, const HopMemoKey& b) {
+  return a.attrs == b.attrs && a.tgGrp == b.tgGrp && a.froms == b.froms &&
+         a.tos == b.tos;
+}
+
+struct HopMemoKeyHash {
+  size_t operator()(const HopMemoKey& k) const {
+    size_t h = k.attrs;
+    auto mix = [&h](const void* p) {
+      h ^= std::hash<const void*>()(p) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    };
+    mix(k.tgGrp);
+    for (auto e : k.froms) mix(e);
+    for (auto e : k.tos) mix(e);
+    return h;
+  }
+};
+
+typedef HopLruStats HopMemoStats;
+
+/*
+ * Memo of solved stop pairs, shared between all routing threads. An entry
+ * holds the costs and edge lists of all candidate hops between two
+ * consecutive stops and is keyed by (routing attributes id, target station
+ * group, source candidate edges, target candidate edges). Trips of
+ * different clusters which share a stop pair with the same candidates thus
+ * only route it once.
+ *
+ * The hops depend on the graph, the restrictions and the routing options,
+ * so a memo must only be used for a single combination of them. Like the
+ * hop cache, the memo is kept in a sharded LRU map.
+ */
+class HopMemo {
+ public:
+  // Init a memo holding at most maxBytes (approx.) in numShards shards
+  HopMemo(size_t maxBytes, size_t numShards);
+
+  // Look up the hops froms -> tos. On a hit, write the edge lists to the
+  // (preallocated) lists in edgesRet and the costs to costs.
+  bool get(size_t attrs, const trgraph::StatGroup* tgGrp,
+           const std::set<trgraph::Edge*>& froms,
+           const std::set<trgraph::Edge*>& tos, const HopEdgeLists& edgesRet,
+           HopCosts* costs);
+
+  // Store the hops froms -> tos
+  void put(size_t attrs, const trgraph::StatGroup* tgGrp,
+           const std::set<trgraph::Edge*>& froms,
+           const std::set<trgraph::Edge*>& tos, const HopEdgeLists& edges,
+           const HopCosts& costs);
+
+  HopMemoStats getStats() const { return _lru.getStats(); }
+
+ private:
+  struct Hops {
+    // row-major, froms x tos
+    std::vector<EdgeCost> costs;
+    std::vector<EdgeList> edges;
+  };
+
+  HopLru<HopMemoKey, Hops, HopMemoKeyHash> _lru;
+
+  static HopMemoKey key(size_t attrs, const trgraph::StatGroup* tgGrp,
+                        const std::set<trgraph::Edge*>& froms,
+                        const std::set<trgraph::Edge*>& tos);
+};
+
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_HOPMEMO_H_
@@ -0,0 +1,154 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pfaedle/router/Landmarks.h"
+
+using pfaedle::router::Landmarks;
+using pfaedle::router::RoutingOpts;
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+// _____________________________________________________________________________
+Landmarks::Landmarks(const trgraph::Graph& g, const RoutingOpts& rOpts,
+                     size_t num, size_t minCompSize)
+    : _num(num), _numComps(0) {
+  for (size_t i = 0; i < 8; i++) _levelPunish[i] = rOpts.levelPunish[i];
+
+  std::unordered_map<const trgraph::Component*, size_t> compIds;
+  std::vector<std::vector<const trgraph::Node*>> comps;
+
+  for (const auto* n : g.getNds()) {
+    if (!n->pl().getComp()) continue;
+    auto i = compIds.find(n->pl().getComp());
+    if (i == compIds.end()) {
+      i = compIds.insert({n->pl().getComp(), comps.size()}).first;
+      comps.push_back({});
+    }
+    comps[i->second].push_back(n);
+  }
+
+  std::vector<size_t> bases;
+  size_t tot = 0;
+
+  for (size_t i = 0; i < comps.size(); i++) {
+    bases.push_back(tot);
+    if (comps[i].size() < minCompSize) continue;
+    for (size_t j = 0; j < comps[i].size(); j++) _idx[comps[i][j]] = tot + j;
+    tot += comps[i].size();
+    _numComps++;
+  }
+
+  _from.resize(tot * _num, INF);
+  _to.resize(tot * _num, INF);
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < comps.size(); i++) {
+    if (comps[i].size() < minCompSize) continue;
+    build(comps[i], bases[i]);
+  }
+}
+
+// _____________________________________________________________________________
+void Landmarks::build(const std::vector<const trgraph::Node*>& nds,
+                      size_t base) {
+  size_t k = std::min(_num, nds.size());
+  std::vector<float> d;
+  std::vector<float> minD(nds.size(), INF);
+
+  // the first landmark is the node farthest away from an arbitrary node
+  dijkstra(nds, base, nds[0], false, &d);
+  size_t lm = 0;
+  for (size_t i = 0; i < nds.size(); i++) {
+    if (d[i] < INF && d[i] > d[lm]) lm = i;
+  }
+
+  for (size_t j = 0; j < k; j++) {
+    dijkstra(nds, base, nds[lm], false, &d);
+    for (size_t i = 0; i < nds.size(); i++) {
+      _from[(base + i) * _num + j] = d[i];
+      minD[i] = std::min(minD[i], d[i]);
+    }
+
+    dijkstra(nds, base, nds[lm], true, &d);
+    for (size_t i = 0; i < nds.size(); i++) _to[(base + i) * _num + j] = d[i];
+
+    // next landmark: a node not yet reachable from any landmark, or the
+    // node farthest away from all landmarks
+    lm = 0;
+    for (size_t i = 0; i < nds.size(); i++) {
+      if (minD[i] > minD[lm]) lm = i;
+      if (minD[i] == INF) break;
+    }
+
+    if (minD[lm] <= 0) break;
+  }
+}
+
+// _____________________________________________________________________________
+void Landmarks::dijkstra(const std::vector<const trgraph::Node*>& nds,
+                         size_t base, const trgraph::Node* src, bool rev,
+                         std::vector<float>* dists) const {
+  typedef std::pair<float, size_t> PQEntry;
+  std::priority_queue<PQEntry, std::vector<PQEntry>, std::greater<PQEntry>> pq;
+
+  dists->assign(nds.size(), INF);
+
+  size_t s = _idx.find(src)->second - base;
+  (*dists)[s] = 0;
+  pq.push({0, s});
+
+  while (!pq.empty()) {
+    PQEntry cur = pq.top();
+    pq.pop();
+
+    if (cur.first > (*dists)[cur.second]) continue;
+
+    const trgraph::Node* n = nds[cur.second];
+    const auto& adj = rev ? n->getAdjListIn() : n->getAdjListOut();
+
+    for (const auto* e : adj) {
+      const trgraph::Node* other = e->getOtherNd(n);
+      size_t o = _idx.find(other)->second - base;
+      float newD = cur.first + weight(e);
+      if (newD < (*dists)[o]) {
+        (*dists)[o] = newD;
+        pq.push({newD, o});
+      }
+    }
+  }
+}
+
+// _____________________________________________________________________________
+double Landmarks::weight(const trgraph::Edge* e) const {
+  return e->pl().getLength() * _levelPunish[e->pl().lvl()];
+}
+
+// _____________________________________________________________________________
+bool Landmarks::validFor(const RoutingOpts& rOpts) const {
+  for (size_t i = 0; i < 8; i++) {
+    if (_levelPunish[i] != rOpts.levelPunish[i]) return false;
+  }
+  return true;
+}
+
+// _____________________________________________________________________________
+const float* Landmarks::fromLms(const trgraph::Node* n) const {
+  auto i = _idx.find(n);
+  if (i == _idx.end()) return 0;
+  return &_from[i->second * _num];
+}
+
+// _____________________________________________________________________________
+const float* Landmarks::toLms(const trgraph::Node* n) const {
+  auto i = _idx.find(n);
+  if (i == _idx.end()) return 0;
+  return &_to[i->second * _num];
+}
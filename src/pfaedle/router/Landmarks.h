@@ -0,0 +1,67 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_ROUTER_LANDMARKS_H_
+#define PFAEDLE_ROUTER_LANDMARKS_H_
+
+#include <unordered_map>
+#include <vector>
+#include "pfaedle/router/Misc.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace router {
+
+/*
+ * Landmark distances (ALT) over a transit graph. Each connected component
+ * gets its own set of landmarks, chosen by farthest selection. Distances are
+ * measured in the level-punished edge length, which is a lower bound for
+ * every edge cost of the router's CostFunc.
+ */
+class Landmarks {
+ public:
+  // Build num landmarks per component of g (components with fewer than
+  // minCompSize nodes are skipped)
+  Landmarks(const trgraph::Graph& g, const RoutingOpts& rOpts, size_t num,
+            size_t minCompSize);
+
+  Landmarks(const Landmarks&) = delete;
+  Landmarks& operator=(const Landmarks&) = delete;
+
+  // Number of landmark slots per node
+  size_t size() const { return _num; }
+
+  // True if these landmarks yield lower bounds for routing options rOpts
+  bool validFor(const RoutingOpts& rOpts) const;
+
+  // Distances from the landmarks of n's component to n, 0 if n is not
+  // covered. Unreachable entries are infinite.
+  const float* fromLms(const trgraph::Node* n) const;
+
+  // Distances from n to the landmarks of n's component, 0 if n is not
+  // covered. Unreachable entries are infinite.
+  const float* toLms(const trgraph::Node* n) const;
+
+  // Number of components covered by landmarks
+  size_t numComps() const { return _numComps; }
+
+ private:
+  size_t _num;
+  size_t _numComps;
+  double _levelPunish[8];
+
+  std::unordered_map<const trgraph::Node*, size_t> _idx;
+  std::vector<float> _from;
+  std::vector<float> _to;
+
+  void build(const std::vector<const trgraph::Node*>& nds, size_t base);
+  void dijkstra(const std::vector<const trgraph::Node*>& nds, size_t base,
+                const trgraph::Node* src, bool rev,
+                std::vector<float>* dists) const;
+  double weight(const trgraph::Edge* e) const;
+};
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_LANDMARKS_H_
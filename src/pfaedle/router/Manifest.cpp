@@ -0,0 +1,88 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "pfaedle/router/Manifest.h"
+#include "util/log/Log.h"
+
+using pfaedle::router::Manifest;
+using pfaedle::router::ManifestEntry;
+
+static const char* MANIFEST_HEADER = "pfaedle-manifest 1";
+
+// _____________________________________________________________________________
+bool Manifest::read(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.good()) return false;
+
+  std::string line;
+  if (!std::getline(in, line) || line != MANIFEST_HEADER) {
+    LOG(WARN) << path << " is not a pfaedle manifest, ignoring it";
+    return false;
+  }
+
+  // one line per cluster: <fingerprint>\t<shape id>\t<dist> <dist> ...
+  while (std::getline(in, line)) {
+    size_t a = line.find('\t');
+    size_t b = line.find('\t', a + 1);
+    if (a == std::string::npos || b == std::string::npos) continue;
+
+    ManifestEntry e;
+    e.shapeId = line.substr(a + 1, b - a - 1);
+    std::stringstream ss(line.substr(b + 1));
+    double d;
+    while (ss >> d) e.dists.push_back(d);
+
+    _entries[strtoull(line.substr(0, a).c_str(), 0, 16)] = e;
+  }
+
+  return true;
+}
+
+// _____________________________________________________________________________
+void Manifest::write(const std::string& path) const {
+  // sorted, so that manifests of identical runs are identical
+  std::map<uint64_t, const ManifestEntry*> sorted;
+  for (const auto& e : _entries) sorted[e.first] = &e.second;
+
+  std::ofstream out(path);
+  out << MANIFEST_HEADER << "\n" << std::setprecision(12);
+  for (const auto& e : sorted) {
+    out << std::hex << e.first << std::dec << "\t" << e.second->shapeId
+        << "\t";
+    for (size_t i = 0; i < e.second->dists.size(); i++) {
+      out << (i ? " " : "") << e.second->dists[i];
+    }
+    out << "\n";
+  }
+}
+
+// _____________________________________________________________________________
+const ManifestEntry* Manifest::get(uint64_t fp) const {
+  auto i = _entries.find(fp);
+  if (i == _entries.end()) return 0;
+  return &i->second;
+}
+
+// _____________________________________________________________________________
+void Manifest::add(uint64_t fp, const ManifestEntry& e) {
+  std::lock_guard<std::mutex> lock(_m);
+  _entries[fp] = e;
+}
+
+// _____________________________________________________________________________
+uint64_t Manifest::hash(const std::string& str) {
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : str) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
@@ -0,0 +1,56 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_ROUTER_MANIFEST_H_
+#define PFAEDLE_ROUTER_MANIFEST_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pfaedle {
+namespace router {
+
+struct ManifestEntry {
+  std::string shapeId;
+  // shape_dist_traveled of each stop of the cluster's trips
+  std::vector<double> dists;
+};
+
+/*
+ * Fingerprints of the trip clusters of a run, each mapped to the shape the
+ * cluster got in the output feed of that run. A later run can copy the
+ * shapes of clusters whose fingerprint did not change from that output
+ * feed instead of matching them again.
+ */
+class Manifest {
+ public:
+  Manifest() {}
+
+  // Read a manifest written by write(), false if it could not be read
+  bool read(const std::string& path);
+  void write(const std::string& path) const;
+
+  // Entry of a cluster fingerprint, 0 if not present
+  const ManifestEntry* get(uint64_t fp) const;
+
+  // Add (or replace) the entry of a cluster fingerprint, thread-safe
+  void add(uint64_t fp, const ManifestEntry& e);
+
+  size_t size() const { return _entries.size(); }
+
+  // 64 bit FNV-1a hash of str, stable between runs and platforms
+  static uint64_t hash(const std::string& str);
+
+ private:
+  std::unordered_map<uint64_t, ManifestEntry> _entries;
+  std::mutex _m;
+};
+
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_MANIFEST_H_
@@ -152,6 +152,14 @@ typedef std::vector<EdgeCandGroup> EdgeCandRoute;
 typedef std::vector<trgraph::Edge*> EdgeList;
 typedef std::vector<trgraph::Node*> NodeList;
 
+// edge lists and costs of the hops from each source edge to each target edge
+typedef std::unordered_map<trgraph::Edge*,
+                           std::unordered_map<trgraph::Edge*, EdgeList*>>
+    HopEdgeLists;
+typedef std::unordered_map<trgraph::Edge*,
+                           std::unordered_map<trgraph::Edge*, EdgeCost>>
+    HopCosts;
+
 struct EdgeListHop {
   EdgeList edges;
   const trgraph::Node* start;
@@ -13,6 +13,7 @@
 #include <fstream>
 #include <limits>
 #include <map>
+#include <queue>
 #include <set>
 #include <unordered_map>
 #include <utility>
@@ -20,6 +21,7 @@
 #include "pfaedle/router/Comp.h"
 #include "pfaedle/router/Router.h"
 #include "pfaedle/router/RoutingAttrs.h"
+#include "util/Counter.h"
 #include "util/geo/output/GeoGraphJsonOutput.h"
 #include "util/graph/Dijkstra.h"
 #include "util/graph/EDijkstra.h"
@@ -29,19 +31,31 @@ using pfaedle::router::Router;
 using pfaedle::router::EdgeCost;
 using pfaedle::router::CostFunc;
 using pfaedle::router::DistHeur;
+using pfaedle::router::LandmarkHeur;
 using pfaedle::router::NCostFunc;
 using pfaedle::router::NDistHeur;
 using pfaedle::router::CombCostFunc;
+using pfaedle::router::CsrLabel;
+using pfaedle::router::CsrLineLabel;
+using pfaedle::router::CsrWorkspace;
+using pfaedle::router::CsrMultiEdge;
+using pfaedle::router::CsrMultiLabel;
+using pfaedle::router::HopEdgeLists;
+using pfaedle::router::HopCosts;
 using pfaedle::router::EdgeListHop;
 using pfaedle::router::EdgeListHops;
 using pfaedle::router::RoutingOpts;
 using pfaedle::router::RoutingAttrs;
 using pfaedle::router::HopBand;
 using pfaedle::router::NodeCandRoute;
+using pfaedle::router::EdgeCandRoute;
 using util::graph::EDijkstra;
 using util::graph::Dijkstra;
 using util::geo::webMercMeterDist;
 
+static util::Counter HOPS("router_hops",
+                          "Hops calculated by searches, without cache hits");
+
 // _____________________________________________________________________________
 EdgeCost NCostFunc::operator()(const trgraph::Node* from,
                                const trgraph::Edge* e,
@@ -63,6 +77,20 @@ EdgeCost NCostFunc::operator()(const trgraph::Node* from,
                   e->pl().getLength() * oneway, oneway, 0, 0, 0, &_rOpts);
 }
 
+// _____________________________________________________________________________
+EdgeCost NCostFunc::operator()(const trgraph::CsrGraph& g, uint32_t e) const {
+  const trgraph::CsrEdge& ed = g.edg(e);
+
+  int oneway = ed.oneWay == 2;
+  int32_t stationSkip = 0;
+
+  return EdgeCost(ed.lvl == 0 ? ed.length : 0, ed.lvl == 1 ? ed.length : 0,
+                  ed.lvl == 2 ? ed.length : 0, ed.lvl == 3 ? ed.length : 0,
+                  ed.lvl == 4 ? ed.length : 0, ed.lvl == 5 ? ed.length : 0,
+                  ed.lvl == 6 ? ed.length : 0, ed.lvl == 7 ? ed.length : 0, 0,
+                  stationSkip, ed.length * oneway, oneway, 0, 0, 0, &_rOpts);
+}
+
 // _____________________________________________________________________________
 EdgeCost CostFunc::operator()(const trgraph::Edge* from, const trgraph::Node* n,
                               const trgraph::Edge* to) const {
@@ -108,6 +136,71 @@ EdgeCost CostFunc::operator()(const trgraph::Edge* from, const trgraph::Node* n,
                   noLines ? from->pl().getLength() : 0, 0, &_rOpts);
 }
 
+// _____________________________________________________________________________
+EdgeCost CostFunc::operator()(const trgraph::CsrGraph& g, uint32_t from,
+                              uint32_t to, CsrWorkspace* ws) const {
+  const trgraph::CsrEdge& fr = g.edg(from);
+  const trgraph::CsrEdge& t = g.edg(to);
+  uint32_t n = fr.to;
+
+  uint32_t fullTurns = 0;
+  int oneway = fr.oneWay == 2;
+  int32_t stationSkip = 0;
+
+  if (fr.from == t.to && fr.to == t.from) {
+    // trivial full turn
+    fullTurns = 1;
+  } else if (g.getDeg(n) > 2) {
+    // otherwise, only intersection angles will be punished
+    fullTurns = router::angSmaller(g.backHop(from), g.getGeom(n),
+                                   g.frontHop(to), _rOpts.fullTurnAngle);
+  }
+
+  if (fr.restricted && !_res.may(g.getEdg(from), g.getEdg(to), g.getNd(n)))
+    oneway = 1;
+
+#ifdef PFAEDLE_DBG
+  g.getNd(n)->pl().setVisited();
+#endif
+
+  if (_tgGrp && g.nd(n).hasSI && g.nd(n).grp != _tgGrp) stationSkip = 1;
+
+  double transitLinePen = transitLineCmp(g, from, ws);
+  bool noLines = (_rAttrs.shortName.empty() && _rAttrs.toString.empty() &&
+                  _rAttrs.fromString.empty() &&
+                  g.linesBegin(from) == g.linesEnd(from));
+
+  return EdgeCost(fr.lvl == 0 ? fr.length : 0, fr.lvl == 1 ? fr.length : 0,
+                  fr.lvl == 2 ? fr.length : 0, fr.lvl == 3 ? fr.length : 0,
+                  fr.lvl == 4 ? fr.length : 0, fr.lvl == 5 ? fr.length : 0,
+                  fr.lvl == 6 ? fr.length : 0, fr.lvl == 7 ? fr.length : 0,
+                  fullTurns, stationSkip, fr.length * oneway, oneway,
+                  fr.length * transitLinePen, noLines ? fr.length : 0, 0,
+                  &_rOpts);
+}
+
+// _____________________________________________________________________________
+double CostFunc::transitLineCmp(const trgraph::CsrGraph& g, uint32_t e,
+                                CsrWorkspace* ws) const {
+  if (_rAttrs.shortName.empty() && _rAttrs.toString.empty() &&
+      _rAttrs.fromString.empty())
+    return 0;
+  double best = 1;
+  for (uint32_t i = g.linesBegin(e); i < g.linesEnd(e); i++) {
+    CsrLineLabel& l = ws->lines[g.line(i)];
+    if (l.stamp != ws->stamp) {
+      l.stamp = ws->stamp;
+      l.simi = _rAttrs.simi(g.getLine(g.line(i)));
+    }
+    double cur = l.simi;
+
+    if (cur < 0.0001) return 0;
+    if (cur < best) best = cur;
+  }
+
+  return best;
+}
+
 // _____________________________________________________________________________
 double CostFunc::transitLineCmp(const trgraph::EdgePL& e) const {
   if (_rAttrs.shortName.empty() && _rAttrs.toString.empty() &&
@@ -179,6 +272,61 @@ EdgeCost DistHeur::operator()(const trgraph::Edge* a,
   return EdgeCost(cur - _maxCentD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
+// _____________________________________________________________________________
+LandmarkHeur::LandmarkHeur(const Landmarks& lms,
+                           const std::set<trgraph::Edge*>& tos)
+    : _lms(lms) {
+  const float inf = std::numeric_limits<float>::infinity();
+  size_t k = _lms.size();
+
+  for (auto to : tos) {
+    // we bound the distance to the target edge's start node, the target
+    // edge's own cost is not part of the path cost
+    const float* fromL = _lms.fromLms(to->getFrom());
+    const float* toL = _lms.toLms(to->getFrom());
+    if (!fromL) continue;
+
+    auto comp = to->getFrom()->pl().getComp();
+    size_t c = std::find(_comps.begin(), _comps.end(), comp) - _comps.begin();
+    if (c == _comps.size()) {
+      _comps.push_back(comp);
+      _minFrom.resize(_minFrom.size() + k, inf);
+      _maxTo.resize(_maxTo.size() + k, 0);
+    }
+
+    for (size_t j = 0; j < k; j++) {
+      _minFrom[c * k + j] = std::min(_minFrom[c * k + j], fromL[j]);
+      _maxTo[c * k + j] = std::max(_maxTo[c * k + j], toL[j]);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+EdgeCost LandmarkHeur::operator()(const trgraph::Edge* a,
+                                  const std::set<trgraph::Edge*>& b) const {
+  UNUSED(b);
+  const float inf = std::numeric_limits<float>::infinity();
+  size_t k = _lms.size();
+
+  auto comp = a->getFrom()->pl().getComp();
+  size_t c = std::find(_comps.begin(), _comps.end(), comp) - _comps.begin();
+  if (c == _comps.size()) return EdgeCost();
+
+  const float* fromL = _lms.fromLms(a->getFrom());
+  const float* toL = _lms.toLms(a->getFrom());
+
+  float h = 0;
+  for (size_t j = 0; j < k; j++) {
+    if (fromL[j] < inf && _minFrom[c * k + j] < inf)
+      h = std::max(h, _minFrom[c * k + j] - fromL[j]);
+    if (toL[j] < inf && _maxTo[c * k + j] < inf)
+      h = std::max(h, toL[j] - _maxTo[c * k + j]);
+  }
+
+  // stay safely below the cost sums, which are accumulated in floats
+  return EdgeCost(h * 0.999);
+}
+
 // _____________________________________________________________________________
 EdgeCost NDistHeur::operator()(const trgraph::Node* a,
                                const std::set<trgraph::Node*>& b) const {
@@ -197,18 +345,21 @@ double CombCostFunc::operator()(const router::Edge* from, const router::Node* n,
 }
 
 // _____________________________________________________________________________
-Router::Router(size_t numThreads, bool caching)
-    : _cache(numThreads), _caching(caching) {
-  for (size_t i = 0; i < numThreads; i++) {
-    _cache[i] = new Cache();
-  }
+Router::Router(size_t numThreads, bool caching, size_t cacheSize)
+    : _numThreads(numThreads),
+      _cache(0),
+      _caching(caching),
+      _lms(0),
+      _csr(0),
+      _memo(0) {
+  // use more shards than threads to keep lock contention low
+  if (_caching) _cache = new HopCache(cacheSize, numThreads * 16);
 }
 
 // _____________________________________________________________________________
 Router::~Router() {
-  for (size_t i = 0; i < _cache.size(); i++) {
-    delete _cache[i];
-  }
+  delete _cache;
+  for (auto ws : _csrWs) delete ws;
 }
 
 // _____________________________________________________________________________
@@ -225,7 +376,8 @@ bool Router::compConned(const EdgeCandGroup& a, const EdgeCandGroup& b) const {
 
 // _____________________________________________________________________________
 HopBand Router::getHopBand(const EdgeCandGroup& a, const EdgeCandGroup& b,
-                           const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
+                           const RoutingAttrs& rAttrs, size_t attrs,
+                           const RoutingOpts& rOpts,
                            const osm::Restrictor& rest) const {
   assert(a.size());
   assert(b.size());
@@ -258,10 +410,23 @@ HopBand Router::getHopBand(const EdgeCandGroup& a, const EdgeCandGroup& b,
 
   EdgeList el;
   EdgeCost ret = costF.inf();
-  DistHeur distH(0, rOpts, to);
 
-  if (compConned(a, b))
-    ret = EDijkstra::shortestPath(from, to, costF, distH, &el);
+  if (compConned(a, b)) {
+    CsrWorkspace* ws = getCsrWorkspace();
+    if (_lms && _lms->validFor(rOpts)) {
+      LandmarkHeur lmH(*_lms, to);
+      if (ws)
+        ret = csrShortestPath(from, to, costF, lmH, &el, ws);
+      else
+        ret = EDijkstra::shortestPath(from, to, costF, lmH, &el);
+    } else {
+      DistHeur distH(0, rOpts, to);
+      if (ws)
+        ret = csrShortestPath(from, to, costF, distH, &el, ws);
+      else
+        ret = EDijkstra::shortestPath(from, to, costF, distH, &el);
+    }
+  }
 
   if (el.size() < 2 && costF.inf() <= ret) {
     LOG(VDEBUG) << "Pilot run: no connection between candidate groups,"
@@ -270,7 +435,7 @@ HopBand Router::getHopBand(const EdgeCandGroup& a, const EdgeCandGroup& b,
   }
 
   // cache the found path, will save a few dijkstra iterations
-  nestedCache(&el, from, costF, rAttrs);
+  nestedCache(&el, from, costF, attrs);
 
   auto na = el.back()->getFrom();
   auto nb = el.front()->getFrom();
@@ -319,7 +484,11 @@ EdgeListHops Router::routeGreedy(const NodeCandRoute& route,
 
     NodeList nodesRet;
     EdgeListHop hop;
-    Dijkstra::shortestPath(from, to, cost, dist, &hop.edges, &nodesRet);
+    CsrWorkspace* ws = getCsrWorkspace();
+    if (ws)
+      csrShortestPath(from, to, cost, dist, &hop.edges, &nodesRet, ws);
+    else
+      Dijkstra::shortestPath(from, to, cost, dist, &hop.edges, &nodesRet);
 
     if (nodesRet.size() > 1) {
       // careful: nodesRet is reversed!
@@ -364,7 +533,11 @@ EdgeListHops Router::routeGreedy2(const NodeCandRoute& route,
 
     NodeList nodesRet;
     EdgeListHop hop;
-    Dijkstra::shortestPath(from, to, cost, dist, &hop.edges, &nodesRet);
+    CsrWorkspace* ws = getCsrWorkspace();
+    if (ws)
+      csrShortestPath(from, to, cost, dist, &hop.edges, &nodesRet, ws);
+    else
+      Dijkstra::shortestPath(from, to, cost, dist, &hop.edges, &nodesRet);
     if (nodesRet.size() > 1) {
       // careful: nodesRet is reversed!
       hop.start = nodesRet.back();
@@ -385,8 +558,109 @@ EdgeListHops Router::routeGreedy2(const NodeCandRoute& route,
 EdgeListHops Router::route(const EdgeCandRoute& route,
                            const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
                            const osm::Restrictor& rest) const {
-  router::Graph cg;
-  return Router::route(route, rAttrs, rOpts, rest, &cg);
+  // the combination graph is layered, so instead of building it and solving
+  // it with a final Dijkstra pass, the best path is found layer by layer
+  // (Viterbi). Only the costs of the current layer, back pointers to the
+  // best predecessor and the best incoming hop of each candidate are kept.
+  if (route.size() < 2) return EdgeListHops();
+  EdgeListHops ret(route.size() - 1);
+
+  std::vector<double> costs(route[0].size());
+  for (size_t j = 0; j < route[0].size(); j++) {
+    costs[j] = EdgeCost(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                        route[0][j].pen, 0)
+                   .getValue();
+  }
+
+  std::vector<std::vector<size_t>> preds(route.size() - 1);
+  std::vector<std::vector<EdgeList>> bestHops(route.size() - 1);
+
+  // the attribute id is resolved once per route, not per hop
+  size_t attrs = getAttrsId(rAttrs);
+
+  size_t iters = EDijkstra::ITERS;
+  for (size_t i = 0; i < route.size() - 1; i++) {
+    const trgraph::StatGroup* tgGrp = 0;
+    if (route[i + 1].begin()->e->getFrom()->pl().getSI())
+      tgGrp = route[i + 1].begin()->e->getFrom()->pl().getSI()->getGroup();
+
+    std::set<trgraph::Edge*> froms;
+    for (const auto& fr : route[i]) froms.insert(fr.e);
+
+    EdgeSet tos;
+    for (const auto& to : route[i + 1]) tos.insert(to.e);
+
+    assert(tos.size());
+    assert(froms.size());
+
+    HopEdgeLists edgeLists;
+    HopCosts hopCosts;
+    for (auto eFr : froms) {
+      for (auto eTo : tos) edgeLists[eFr][eTo] = new EdgeList();
+    }
+
+    // stop pairs shared with earlier trips are only routed once
+    if (!_memo ||
+        !_memo->get(attrs, tgGrp, froms, tos, edgeLists, &hopCosts)) {
+      HopBand hopBand =
+          getHopBand(route[i], route[i + 1], rAttrs, attrs, rOpts, rest);
+      hops(froms, tos, tgGrp, edgeLists, &hopCosts, rAttrs, attrs, rOpts,
+           rest, hopBand);
+      if (_memo) _memo->put(attrs, tgGrp, froms, tos, edgeLists, hopCosts);
+    }
+
+    std::vector<double> nextCosts(route[i + 1].size(),
+                                  std::numeric_limits<double>::infinity());
+    preds[i].resize(route[i + 1].size(), 0);
+    bestHops[i].resize(route[i + 1].size());
+
+    for (size_t t = 0; t < route[i + 1].size(); t++) {
+      const auto& to = route[i + 1][t];
+      EdgeCost pen(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, to.pen, 0);
+      for (size_t f = 0; f < route[i].size(); f++) {
+        double c = costs[f] + (pen + hopCosts[route[i][f].e][to.e]).getValue();
+        if (c < nextCosts[t]) {
+          nextCosts[t] = c;
+          preds[i][t] = f;
+        }
+      }
+
+      EdgeList* el = edgeLists[route[i][preds[i][t]].e][to.e];
+      if (rOpts.popReachEdge && el->size()) {
+        // the reach edge is included, but we dont want it in the geometry
+        el->erase(el->begin());
+      }
+      // copied, the same edge may be the candidate of more than one node
+      bestHops[i][t] = *el;
+    }
+
+    // drop the best hops of candidates which are no longer on a best path
+    if (i > 0) {
+      std::vector<bool> used(route[i].size(), false);
+      for (auto f : preds[i]) used[f] = true;
+      for (size_t f = 0; f < route[i].size(); f++) {
+        if (!used[f]) EdgeList().swap(bestHops[i - 1][f]);
+      }
+    }
+
+    for (const auto& fr : edgeLists) {
+      for (const auto& kv : fr.second) delete kv.second;
+    }
+
+    std::swap(costs, nextCosts);
+  }
+
+  LOG(VDEBUG) << "Hops took " << EDijkstra::ITERS - iters << " iterations";
+
+  size_t t = std::min_element(costs.begin(), costs.end()) - costs.begin();
+  for (size_t i = route.size() - 1; i-- > 0;) {
+    size_t f = preds[i][t];
+    ret[i] = EdgeListHop{std::move(bestHops[i][t]), route[i][f].e->getFrom(),
+                         route[i + 1][t].e->getFrom()};
+    t = f;
+  }
+
+  return ret;
 }
 
 // _____________________________________________________________________________
@@ -414,12 +688,16 @@ EdgeListHops Router::route(const EdgeCandRoute& route,
                           route[0][i].pen, 0));
   }
 
+  // the attribute id is resolved once per route, not per hop
+  size_t attrs = getAttrsId(rAttrs);
+
   size_t iters = EDijkstra::ITERS;
   double itPerSecTot = 0;
   size_t n = 0;
   for (size_t i = 0; i < route.size() - 1; i++) {
     nextNodes.clear();
-    HopBand hopBand = getHopBand(route[i], route[i + 1], rAttrs, rOpts, rest);
+    HopBand hopBand =
+        getHopBand(route[i], route[i + 1], rAttrs, attrs, rOpts, rest);
 
     const trgraph::StatGroup* tgGrp = 0;
     if (route[i + 1].begin()->e->getFrom()->pl().getSI())
@@ -428,57 +706,64 @@ EdgeListHops Router::route(const EdgeCandRoute& route,
     std::set<trgraph::Edge*> froms;
     for (const auto& fr : route[i]) froms.insert(fr.e);
 
-    for (auto eFr : froms) {
-      router::Node* cNodeFr = nodes.find(eFr)->second;
+    EdgeSet tos;
+    for (const auto& to : route[i + 1]) tos.insert(to.e);
 
-      EdgeSet tos;
-      std::map<trgraph::Edge*, router::Edge*> edges;
-      std::map<trgraph::Edge*, double> pens;
-      std::unordered_map<trgraph::Edge*, EdgeList*> edgeLists;
-      std::unordered_map<trgraph::Edge*, EdgeCost> costs;
+    std::unordered_map<trgraph::Edge*, std::map<trgraph::Edge*, router::Edge*>>
+        edges;
+    std::map<trgraph::Edge*, double> pens;
+    HopEdgeLists edgeLists;
+    HopCosts costs;
 
-      assert(route[i + 1].size());
+    assert(route[i + 1].size());
+
+    for (auto eFr : froms) {
+      router::Node* cNodeFr = nodes.find(eFr)->second;
 
       for (const auto& to : route[i + 1]) {
         auto eTo = to.e;
-        tos.insert(eTo);
         if (!nextNodes.count(eTo))
           nextNodes[eTo] = cgraph->addNd(to.e->getFrom());
         if (i == route.size() - 2) cgraph->addEdg(nextNodes[eTo], sink);
 
-        edges[eTo] = cgraph->addEdg(cNodeFr, nextNodes[eTo]);
+        auto e = cgraph->addEdg(cNodeFr, nextNodes[eTo]);
+        edges[eFr][eTo] = e;
         pens[eTo] = to.pen;
 
-        edgeLists[eTo] = edges[eTo]->pl().getEdges();
-        edges[eTo]->pl().setStartNode(eFr->getFrom());
+        edgeLists[eFr][eTo] = e->pl().getEdges();
+        e->pl().setStartNode(eFr->getFrom());
         // for debugging
-        edges[eTo]->pl().setStartEdge(eFr);
-        edges[eTo]->pl().setEndNode(to.e->getFrom());
+        e->pl().setStartEdge(eFr);
+        e->pl().setEndNode(to.e->getFrom());
         // for debugging
-        edges[eTo]->pl().setEndEdge(eTo);
+        e->pl().setEndEdge(eTo);
       }
+    }
 
-      size_t iters = EDijkstra::ITERS;
-      auto t1 = TIME();
+    size_t iters = EDijkstra::ITERS;
+    auto t1 = TIME();
 
-      assert(tos.size());
-      assert(froms.size());
+    assert(tos.size());
+    assert(froms.size());
 
-      hops(eFr, froms, tos, tgGrp, edgeLists, &costs, rAttrs, rOpts, rest,
-           hopBand);
-      double itPerSec =
-          (static_cast<double>(EDijkstra::ITERS - iters)) / TOOK(t1, TIME());
-      n++;
-      itPerSecTot += itPerSec;
+    // all candidate hops of this stop pair are computed together
+    hops(froms, tos, tgGrp, edgeLists, &costs, rAttrs, attrs, rOpts, rest,
+         hopBand);
+    double itPerSec =
+        (static_cast<double>(EDijkstra::ITERS - iters)) / TOOK(t1, TIME());
+    n++;
+    itPerSecTot += itPerSec;
 
-      LOG(VDEBUG) << "from " << eFr << ": 1-" << tos.size() << " ("
-                  << route[i + 1].size() << " nodes) hop took "
-                  << EDijkstra::ITERS - iters << " iterations, "
-                  << TOOK(t1, TIME()) << "ms (tput: " << itPerSec << " its/ms)";
-      for (auto& kv : edges) {
+    LOG(VDEBUG) << froms.size() << "-" << tos.size() << " ("
+                << route[i + 1].size() << " nodes) hops took "
+                << EDijkstra::ITERS - iters << " iterations, "
+                << TOOK(t1, TIME()) << "ms (tput: " << itPerSec << " its/ms)";
+
+    for (auto eFr : froms) {
+      for (auto& kv : edges[eFr]) {
         kv.second->pl().setCost(
             EdgeCost(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, pens[kv.first], 0) +
-            costs[kv.first]);
+            costs[eFr][kv.first]);
 
         if (rOpts.popReachEdge && kv.second->pl().getEdges()->size()) {
           if (kv.second->pl().getEdges() &&
@@ -525,8 +810,7 @@ EdgeListHops Router::route(const EdgeCandRoute& route,
 EdgeListHops Router::route(const NodeCandRoute& route,
                            const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
                            const osm::Restrictor& rest) const {
-  router::Graph cg;
-  return Router::route(route, rAttrs, rOpts, rest, &cg);
+  return Router::route(edgeCands(route), rAttrs, rOpts, rest);
 }
 
 // _____________________________________________________________________________
@@ -534,6 +818,11 @@ EdgeListHops Router::route(const NodeCandRoute& route,
                            const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
                            const osm::Restrictor& rest,
                            router::Graph* cgraph) const {
+  return Router::route(edgeCands(route), rAttrs, rOpts, rest, cgraph);
+}
+
+// _____________________________________________________________________________
+EdgeCandRoute Router::edgeCands(const NodeCandRoute& route) const {
   EdgeCandRoute r;
   for (auto& nCands : route) {
     r.emplace_back();
@@ -542,7 +831,374 @@ EdgeListHops Router::route(const NodeCandRoute& route,
         r.back().push_back(EdgeCand{e, n.pen});
   }
 
-  return Router::route(r, rAttrs, rOpts, rest, cgraph);
+  return r;
+}
+
+// _____________________________________________________________________________
+uint32_t Router::newCsrStamp(CsrWorkspace* ws) const {
+  // the lower 3 bits of a label stamp are reserved for flags
+  ws->stamp += 8;
+  if (ws->stamp == 0) {
+    // stamp overflow, invalidate all labels
+    for (auto& l : ws->edgs) l.stamp = 0;
+    for (auto& l : ws->nds) l.stamp = 0;
+    for (auto& l : ws->lines) l.stamp = 0;
+    for (auto& l : ws->mEdgs) l.stamp = 0;
+    ws->stamp = 8;
+  }
+  return ws->stamp;
+}
+
+// _____________________________________________________________________________
+template <typename S, typename H>
+size_t Router::csrSearch(const S& froms, const std::set<trgraph::Edge*>& tos,
+                         const CostFunc& cost, const H& heur, size_t maxFound,
+                         CsrWorkspace* ws) const {
+  // mirrors the edge-based EDijkstra::shortestPathImpl(), but on the CSR
+  // graph with dense, stamped search labels. Ids of the settled targets are
+  // written to ws->found, the labels stay valid until the next search.
+  static const uint32_t SEEN = 1;
+  static const uint32_t SETTLED = 2;
+  static const uint32_t TARGET = 4;
+  static const uint32_t FLAGS = 7;
+
+  ws->found.clear();
+  ws->heap.clear();
+  if (tos.size() == 0) return 0;
+
+  const uint32_t stamp = newCsrStamp(ws);
+
+  for (auto e : tos) {
+    assert(_csr->getId(e) != trgraph::NO_ID);
+    ws->edgs[_csr->getId(e)].stamp = stamp | TARGET;
+  }
+
+  for (auto e : froms) {
+    uint32_t id = _csr->getId(e);
+    assert(id != trgraph::NO_ID);
+    CsrLabel& l = ws->edgs[id];
+    if ((l.stamp & ~FLAGS) != stamp) l.stamp = stamp;
+    l.stamp |= SEEN;
+    l.d = cost(0, 0, e).getValue();
+    l.h = heur(e, tos).getValue();
+    ws->heap.push_back(CsrPQEntry{
+        static_cast<float>((EdgeCost(l.d) + EdgeCost(l.h)).getValue()), l.d,
+        id, trgraph::NO_ID});
+    std::push_heap(ws->heap.begin(), ws->heap.end());
+  }
+
+  while (!ws->heap.empty()) {
+    EDijkstra::ITERS++;
+
+    std::pop_heap(ws->heap.begin(), ws->heap.end());
+    CsrPQEntry cur = ws->heap.back();
+    ws->heap.pop_back();
+
+    CsrLabel& curL = ws->edgs[cur.id];
+    if (curL.stamp & SETTLED) continue;
+
+    curL.stamp |= SETTLED;
+    curL.d = cur.d;
+    curL.parent = cur.parent;
+
+    if (curL.stamp & TARGET) {
+      ws->found.push_back(cur.id);
+      if (ws->found.size() == maxFound) break;
+    }
+
+    uint32_t n = _csr->edg(cur.id).to;
+    for (uint32_t o = _csr->outBegin(n); o < _csr->outEnd(n); o++) {
+      if (o == cur.id) continue;
+      EdgeCost newC = EdgeCost(cur.d) + cost(*_csr, cur.id, o, ws);
+      if (cost.inf() <= newC) continue;
+
+      CsrLabel& oL = ws->edgs[o];
+      if ((oL.stamp & ~FLAGS) != stamp) oL.stamp = stamp;
+
+      if (oL.stamp & SETTLED) continue;
+
+      if (!(oL.stamp & SEEN)) {
+        oL.stamp |= SEEN;
+        oL.h = heur(_csr->getEdg(o), tos).getValue();
+      } else if (oL.d <= newC.getValue()) {
+        // an entry with a lower or equal cost is already queued
+        continue;
+      }
+
+      oL.d = newC.getValue();
+      ws->heap.push_back(
+          CsrPQEntry{static_cast<float>((newC + EdgeCost(oL.h)).getValue()),
+                     oL.d, o, cur.id});
+      std::push_heap(ws->heap.begin(), ws->heap.end());
+    }
+  }
+
+  return ws->found.size();
+}
+
+// _____________________________________________________________________________
+void Router::csrEdgePath(uint32_t e, const CsrWorkspace& ws,
+                         EdgeList* ret) const {
+  for (uint32_t i = e; i != trgraph::NO_ID; i = ws.edgs[i].parent) {
+    ret->push_back(_csr->getEdg(i));
+  }
+}
+
+// _____________________________________________________________________________
+template <typename H>
+std::unordered_map<pfaedle::trgraph::Edge*, EdgeCost> Router::csrHops(
+    trgraph::Edge* from, const std::set<trgraph::Edge*>& tos,
+    const CostFunc& cost, const H& heur,
+    const std::unordered_map<trgraph::Edge*, EdgeList*>& edgesRet,
+    CsrWorkspace* ws) const {
+  std::unordered_map<trgraph::Edge*, EdgeCost> costs;
+  if (tos.size() == 0) return costs;
+
+  for (auto e : tos) costs[e] = cost.inf();
+
+  trgraph::Edge* froms[1] = {from};
+  csrSearch(froms, tos, cost, heur, tos.size(), ws);
+
+  for (uint32_t id : ws->found) {
+    trgraph::Edge* e = _csr->getEdg(id);
+    costs[e] = EdgeCost(ws->edgs[id].d);
+    csrEdgePath(id, *ws, edgesRet.at(e));
+  }
+
+  return costs;
+}
+
+// _____________________________________________________________________________
+template <typename H>
+void Router::csrHopMatrix(const std::vector<trgraph::Edge*>& froms,
+                          const std::vector<std::set<trgraph::Edge*>>& tos,
+                          const std::set<trgraph::Edge*>& allTos,
+                          const CostFunc& cost, const H& heur,
+                          const HopEdgeLists& edgesRet, HopCosts* rCosts,
+                          CsrWorkspace* ws) const {
+  // a single sweep computing the hops from froms[i] to tos[i] for all i.
+  // Each edge carries one label per source, but the heuristic and the turn
+  // costs to its outgoing edges are computed only once for all sources. The
+  // result for each source is the same as that of a separate search. The
+  // parent field of the heap entries holds the source index. Sources are
+  // solved in batches to bound the size of the label pool.
+  static const uint32_t SEEN = 1;
+  static const uint32_t EXPANDED = 2;
+  static const uint32_t TARGET = 4;
+  static const uint32_t FLAGS = 7;
+  const float inf = std::numeric_limits<float>::infinity();
+
+  for (size_t base = 0; base < froms.size(); base += MAX_MATRIX_SRCS) {
+    const uint32_t k = std::min(froms.size() - base, MAX_MATRIX_SRCS);
+
+    ws->heap.clear();
+    ws->mLabels.clear();
+    ws->mCosts.clear();
+    const uint32_t stamp = newCsrStamp(ws);
+
+    // allocate the per-source labels of edge e on first touch
+    auto touch = [&](uint32_t e) -> CsrMultiEdge& {
+      CsrMultiEdge& me = ws->mEdgs[e];
+      if ((me.stamp & ~FLAGS) != stamp) me.stamp = stamp;
+      if (!(me.stamp & SEEN)) {
+        me.stamp |= SEEN;
+        me.h = heur(_csr->getEdg(e), allTos).getValue();
+        me.labels = ws->mLabels.size();
+        ws->mLabels.resize(ws->mLabels.size() + k,
+                           CsrMultiLabel{inf, trgraph::NO_ID, false});
+      }
+      return me;
+    };
+
+    for (auto e : allTos) {
+      assert(_csr->getId(e) != trgraph::NO_ID);
+      touch(_csr->getId(e)).stamp |= TARGET;
+    }
+
+    std::vector<size_t> left(k);
+    size_t done = 0;
+
+    for (uint32_t s = 0; s < k; s++) {
+      left[s] = tos[base + s].size();
+      auto& costs = (*rCosts)[froms[base + s]];
+      for (auto e : tos[base + s]) costs[e] = cost.inf();
+
+      uint32_t id = _csr->getId(froms[base + s]);
+      assert(id != trgraph::NO_ID);
+      CsrMultiEdge& me = touch(id);
+      CsrMultiLabel& l = ws->mLabels[me.labels + s];
+      l.d = cost(0, 0, froms[base + s]).getValue();
+      ws->heap.push_back(CsrPQEntry{
+          static_cast<float>((EdgeCost(l.d) + EdgeCost(me.h)).getValue()), l.d,
+          id, s});
+      std::push_heap(ws->heap.begin(), ws->heap.end());
+    }
+
+    while (!ws->heap.empty() && done < k) {
+      EDijkstra::ITERS++;
+
+      std::pop_heap(ws->heap.begin(), ws->heap.end());
+      CsrPQEntry cur = ws->heap.back();
+      ws->heap.pop_back();
+
+      uint32_t s = cur.parent;
+      if (!left[s]) continue;
+
+      // labels may move during touch(), so they are always accessed by index
+      uint32_t curLabels = ws->mEdgs[cur.id].labels;
+      CsrMultiLabel& curL = ws->mLabels[curLabels + s];
+      if (curL.settled || cur.d > curL.d) continue;
+      curL.settled = true;
+
+      if ((ws->mEdgs[cur.id].stamp & TARGET) &&
+          tos[base + s].count(_csr->getEdg(cur.id))) {
+        if (--left[s] == 0) done++;
+        if (!left[s]) continue;
+      }
+
+      uint32_t n = _csr->edg(cur.id).to;
+      uint32_t begin = _csr->outBegin(n);
+
+      if (!(ws->mEdgs[cur.id].stamp & EXPANDED)) {
+        ws->mEdgs[cur.id].stamp |= EXPANDED;
+        ws->mEdgs[cur.id].costs = ws->mCosts.size();
+        for (uint32_t o = begin; o < _csr->outEnd(n); o++) {
+          ws->mCosts.push_back(
+              o == cur.id ? inf : cost(*_csr, cur.id, o, ws).getValue());
+        }
+      }
+
+      uint32_t curCosts = ws->mEdgs[cur.id].costs;
+
+      for (uint32_t o = begin; o < _csr->outEnd(n); o++) {
+        if (o == cur.id) continue;
+        EdgeCost newC =
+            EdgeCost(cur.d) + EdgeCost(ws->mCosts[curCosts + o - begin]);
+        if (cost.inf() <= newC) continue;
+
+        const CsrMultiEdge& oE = touch(o);
+        CsrMultiLabel& oL = ws->mLabels[oE.labels + s];
+
+        // an entry with a lower or equal cost is already queued
+        if (oL.settled || oL.d <= newC.getValue()) continue;
+
+        oL.d = newC.getValue();
+        oL.parent = cur.id;
+        ws->heap.push_back(
+            CsrPQEntry{static_cast<float>((newC + EdgeCost(oE.h)).getValue()),
+                       oL.d, o, s});
+        std::push_heap(ws->heap.begin(), ws->heap.end());
+      }
+    }
+
+    for (uint32_t s = 0; s < k; s++) {
+      for (auto t : tos[base + s]) {
+        uint32_t id = _csr->getId(t);
+        const CsrMultiLabel& l = ws->mLabels[ws->mEdgs[id].labels + s];
+        if (!l.settled) continue;
+
+        (*rCosts)[froms[base + s]][t] = EdgeCost(l.d);
+        EdgeList* ret = edgesRet.at(froms[base + s]).at(t);
+        for (uint32_t i = id; i != trgraph::NO_ID;
+             i = ws->mLabels[ws->mEdgs[i].labels + s].parent) {
+          ret->push_back(_csr->getEdg(i));
+        }
+      }
+    }
+  }
+}
+
+// _____________________________________________________________________________
+template <typename H>
+EdgeCost Router::csrShortestPath(const std::set<trgraph::Edge*>& froms,
+                                 const std::set<trgraph::Edge*>& tos,
+                                 const CostFunc& cost, const H& heur,
+                                 EdgeList* resEdges, CsrWorkspace* ws) const {
+  if (froms.size() == 0 || tos.size() == 0) return cost.inf();
+
+  if (!csrSearch(froms, tos, cost, heur, 1, ws)) return cost.inf();
+
+  csrEdgePath(ws->found.front(), *ws, resEdges);
+  return EdgeCost(ws->edgs[ws->found.front()].d);
+}
+
+// _____________________________________________________________________________
+template <typename H>
+EdgeCost Router::csrShortestPath(const std::set<trgraph::Node*>& froms,
+                                 const std::set<trgraph::Node*>& tos,
+                                 const NCostFunc& cost, const H& heur,
+                                 EdgeList* resEdges, NodeList* resNodes,
+                                 CsrWorkspace* ws) const {
+  // mirrors the node-based Dijkstra::shortestPathImpl() for a set of source
+  // nodes and a set of target nodes
+  static const uint32_t SETTLED = 2;
+  static const uint32_t TARGET = 4;
+  static const uint32_t FLAGS = 7;
+
+  ws->heap.clear();
+  const uint32_t stamp = newCsrStamp(ws);
+
+  for (auto n : tos) {
+    assert(_csr->getId(n) != trgraph::NO_ID);
+    ws->nds[_csr->getId(n)].stamp = stamp | TARGET;
+  }
+
+  for (auto n : froms) {
+    uint32_t id = _csr->getId(n);
+    assert(id != trgraph::NO_ID);
+    ws->heap.push_back(CsrPQEntry{0, 0, id, trgraph::NO_ID});
+    std::push_heap(ws->heap.begin(), ws->heap.end());
+  }
+
+  uint32_t found = trgraph::NO_ID;
+
+  while (!ws->heap.empty()) {
+    Dijkstra::ITERS++;
+
+    std::pop_heap(ws->heap.begin(), ws->heap.end());
+    CsrPQEntry cur = ws->heap.back();
+    ws->heap.pop_back();
+
+    CsrLabel& curL = ws->nds[cur.id];
+    if ((curL.stamp & ~FLAGS) != stamp) curL.stamp = stamp;
+    if (curL.stamp & SETTLED) continue;
+
+    curL.stamp |= SETTLED;
+    curL.d = cur.d;
+    curL.parent = cur.parent;
+
+    if (curL.stamp & TARGET) {
+      found = cur.id;
+      break;
+    }
+
+    for (uint32_t e = _csr->outBegin(cur.id); e < _csr->outEnd(cur.id); e++) {
+      EdgeCost newC = EdgeCost(cur.d) + cost(*_csr, e);
+      if (cost.inf() <= newC) continue;
+
+      uint32_t o = _csr->edg(e).to;
+      EdgeCost newH = newC + heur(_csr->getNd(o), tos);
+
+      ws->heap.push_back(CsrPQEntry{static_cast<float>(newH.getValue()),
+                                    static_cast<float>(newC.getValue()), o,
+                                    e});
+      std::push_heap(ws->heap.begin(), ws->heap.end());
+    }
+  }
+
+  if (found == trgraph::NO_ID) return cost.inf();
+
+  // build the path backwards, like Dijkstra::buildPath()
+  uint32_t n = found;
+  while (true) {
+    const CsrLabel& l = ws->nds[n];
+    if (resNodes) resNodes->push_back(_csr->getNd(n));
+    if (l.parent == trgraph::NO_ID) break;
+    if (resEdges) resEdges->push_back(_csr->getEdg(l.parent));
+    n = _csr->edg(l.parent).from;
+  }
+
+  return EdgeCost(ws->nds[found].d);
 }
 
 // _____________________________________________________________________________
@@ -551,13 +1207,14 @@ void Router::hops(trgraph::Edge* from, const std::set<trgraph::Edge*>& froms,
                   const trgraph::StatGroup* tgGrp,
                   const std::unordered_map<trgraph::Edge*, EdgeList*>& edgesRet,
                   std::unordered_map<trgraph::Edge*, EdgeCost>* rCosts,
-                  const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
-                  const osm::Restrictor& rest, HopBand hopB) const {
+                  const RoutingAttrs& rAttrs, size_t attrs,
+                  const RoutingOpts& rOpts, const osm::Restrictor& rest,
+                  HopBand hopB) const {
   std::set<trgraph::Edge*> rem;
 
   CostFunc cost(rAttrs, rOpts, rest, tgGrp, hopB.maxD);
 
-  const auto& cached = getCachedHops(from, tos, edgesRet, rCosts, rAttrs);
+  const auto& cached = getCachedHops(from, tos, edgesRet, rCosts, attrs);
 
   for (auto e : cached) {
     // shortcut: if the nodes lie in two different connected components,
@@ -574,22 +1231,132 @@ void Router::hops(trgraph::Edge* from, const std::set<trgraph::Edge*>& froms,
   LOG(VDEBUG) << "From cache: " << tos.size() - rem.size()
               << ", have to cal: " << rem.size();
 
+  HOPS += rem.size();
+
   if (rem.size()) {
-    DistHeur dist(from->getFrom()->pl().getComp()->minEdgeLvl, rOpts, rem);
-    const auto& ret = EDijkstra::shortestPath(from, rem, cost, dist, edgesRet);
+    std::unordered_map<trgraph::Edge*, EdgeCost> ret;
+    CsrWorkspace* ws = getCsrWorkspace();
+    if (_lms && _lms->validFor(rOpts)) {
+      LandmarkHeur lmH(*_lms, rem);
+      if (ws)
+        ret = csrHops(from, rem, cost, lmH, edgesRet, ws);
+      else
+        ret = EDijkstra::shortestPath(from, rem, cost, lmH, edgesRet);
+    } else {
+      DistHeur dist(from->getFrom()->pl().getComp()->minEdgeLvl, rOpts, rem);
+      if (ws)
+        ret = csrHops(from, rem, cost, dist, edgesRet, ws);
+      else
+        ret = EDijkstra::shortestPath(from, rem, cost, dist, edgesRet);
+    }
     for (const auto& kv : ret) {
-      nestedCache(edgesRet.at(kv.first), froms, cost, rAttrs);
+      nestedCache(edgesRet.at(kv.first), froms, cost, attrs);
 
       (*rCosts)[kv.first] = kv.second;
     }
   }
 }
 
+// _____________________________________________________________________________
+void Router::hops(const std::set<trgraph::Edge*>& froms,
+                  const std::set<trgraph::Edge*>& tos,
+                  const trgraph::StatGroup* tgGrp,
+                  const HopEdgeLists& edgesRet, HopCosts* rCosts,
+                  const RoutingAttrs& rAttrs, size_t attrs,
+                  const RoutingOpts& rOpts, const osm::Restrictor& rest,
+                  HopBand hopB) const {
+  CsrWorkspace* ws = getCsrWorkspace();
+
+  if (!ws) {
+    // no CSR graph, fall back to one search per source edge
+    for (auto from : froms) {
+      hops(from, froms, tos, tgGrp, edgesRet.at(from), &(*rCosts)[from],
+           rAttrs, attrs, rOpts, rest, hopB);
+    }
+    return;
+  }
+
+  CostFunc cost(rAttrs, rOpts, rest, tgGrp, hopB.maxD);
+
+  std::vector<trgraph::Edge*> srcs;
+  std::vector<std::set<trgraph::Edge*>> rems;
+  std::set<trgraph::Edge*> allRem;
+  uint8_t minLvl = 7;
+
+  for (auto from : froms) {
+    std::set<trgraph::Edge*> rem;
+    auto& costs = (*rCosts)[from];
+
+    const auto& cached =
+        getCachedHops(from, tos, edgesRet.at(from), &costs, attrs);
+
+    for (auto e : cached) {
+      // shortcut: if the nodes lie in two different connected components,
+      // the distance between them is trivially infinite
+      if ((rOpts.noSelfHops &&
+           (e == from || e->getFrom() == from->getFrom())) ||
+          from->getFrom()->pl().getComp() != e->getTo()->pl().getComp() ||
+          e->pl().oneWay() == 2 || from->pl().oneWay() == 2) {
+        costs[e] = cost.inf();
+      } else {
+        rem.insert(e);
+      }
+    }
+
+    LOG(VDEBUG) << "From cache: " << tos.size() - rem.size()
+                << ", have to cal: " << rem.size();
+
+    if (rem.empty()) continue;
+
+    HOPS += rem.size();
+    srcs.push_back(from);
+    rems.push_back(rem);
+    allRem.insert(rem.begin(), rem.end());
+    minLvl = std::min(minLvl, from->getFrom()->pl().getComp()->minEdgeLvl);
+  }
+
+  if (srcs.empty()) return;
+
+  // the heuristics bound the distance to the nearest of all remaining
+  // targets, which is a lower bound for each single source as well
+  if (_lms && _lms->validFor(rOpts)) {
+    LandmarkHeur lmH(*_lms, allRem);
+    csrHopMatrix(srcs, rems, allRem, cost, lmH, edgesRet, rCosts, ws);
+  } else {
+    DistHeur dist(minLvl, rOpts, allRem);
+    csrHopMatrix(srcs, rems, allRem, cost, dist, edgesRet, rCosts, ws);
+  }
+
+  for (size_t i = 0; i < srcs.size(); i++) {
+    for (auto e : rems[i]) {
+      nestedCache(edgesRet.at(srcs[i]).at(e), froms, cost, attrs);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+pfaedle::router::CsrWorkspace* Router::getCsrWorkspace() const {
+  if (!_csr) return 0;
+  size_t tid = omp_get_thread_num();
+  if (tid >= _csrWs.size()) return 0;
+
+  // workspaces are allocated lazily by the thread that uses them
+  if (!_csrWs[tid]) {
+    _csrWs[tid] = new CsrWorkspace();
+    _csrWs[tid]->stamp = 0;
+    _csrWs[tid]->edgs.resize(_csr->numEdgs(), CsrLabel{0, 0, 0, 0});
+    _csrWs[tid]->nds.resize(_csr->numNds(), CsrLabel{0, 0, 0, 0});
+    _csrWs[tid]->lines.resize(_csr->numLines(), CsrLineLabel{0, 0});
+    _csrWs[tid]->mEdgs.resize(_csr->numEdgs(), CsrMultiEdge{0, 0, 0, 0});
+  }
+
+  return _csrWs[tid];
+}
+
 // _____________________________________________________________________________
 void Router::nestedCache(const EdgeList* el,
                          const std::set<trgraph::Edge*>& froms,
-                         const CostFunc& cost,
-                         const RoutingAttrs& rAttrs) const {
+                         const CostFunc& cost, size_t attrs) const {
   if (!_caching) return;
   if (el->size() == 0) return;
   // iterate over result edges backwards
@@ -607,7 +1374,7 @@ void Router::nestedCache(const EdgeList* el,
 
     if (froms.count(*i)) {
       EdgeCost startC = cost(0, 0, *i) + curCost;
-      cache(*i, el->front(), startC, &curEdges, rAttrs);
+      cache(*i, el->front(), startC, &curEdges, attrs);
       j++;
     }
   }
@@ -618,13 +1385,14 @@ std::set<pfaedle::trgraph::Edge*> Router::getCachedHops(
     trgraph::Edge* from, const std::set<trgraph::Edge*>& tos,
     const std::unordered_map<trgraph::Edge*, EdgeList*>& edgesRet,
     std::unordered_map<trgraph::Edge*, EdgeCost>* rCosts,
-    const RoutingAttrs& rAttrs) const {
+    size_t attrs) const {
   std::set<trgraph::Edge*> ret;
+  if (!_caching) return tos;
+
   for (auto to : tos) {
-    if (_caching && (*_cache[omp_get_thread_num()])[rAttrs][from].count(to)) {
-      const auto& cv = (*_cache[omp_get_thread_num()])[rAttrs][from][to];
-      (*rCosts)[to] = cv.first;
-      *edgesRet.at(to) = cv.second;
+    EdgeCost c;
+    if (_cache->get(attrs, from, to, &c, edgesRet.at(to))) {
+      (*rCosts)[to] = c;
     } else {
       ret.insert(to);
     }
@@ -635,12 +1403,30 @@ std::set<pfaedle::trgraph::Edge*> Router::getCachedHops(
 
 // _____________________________________________________________________________
 void Router::cache(trgraph::Edge* from, trgraph::Edge* to, const EdgeCost& c,
-                   EdgeList* edges, const RoutingAttrs& rAttrs) const {
+                   EdgeList* edges, size_t attrs) const {
   if (!_caching) return;
   if (from == to) return;
-  (*_cache[omp_get_thread_num()])[rAttrs][from][to] =
-      std::pair<EdgeCost, EdgeList>(c, *edges);
+  _cache->put(attrs, from, to, c, *edges);
+}
+
+// _____________________________________________________________________________
+size_t Router::getCacheNumber() const { return _numThreads; }
+
+// _____________________________________________________________________________
+pfaedle::router::HopCacheStats Router::getCacheStats() const {
+  if (!_caching) return HopCacheStats{0, 0, 0, 0, 0};
+  return _cache->getStats();
+}
+
+// _____________________________________________________________________________
+void Router::setLandmarks(const Landmarks* lms) { _lms = lms; }
+
+// _____________________________________________________________________________
+void Router::setCsrGraph(const trgraph::CsrGraph* csr) {
+  _csr = csr;
+  for (auto ws : _csrWs) delete ws;
+  _csrWs.assign(_csr ? _numThreads : 0, 0);
 }
 
 // _____________________________________________________________________________
-size_t Router::getCacheNumber() const { return _cache.size(); }
+void Router::setHopMemo(HopMemo* memo) { _memo = memo; }
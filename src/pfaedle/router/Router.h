@@ -16,8 +16,12 @@
 #include "pfaedle/Def.h"
 #include "pfaedle/osm/Restrictor.h"
 #include "pfaedle/router/Graph.h"
+#include "pfaedle/router/HopCache.h"
+#include "pfaedle/router/HopMemo.h"
+#include "pfaedle/router/Landmarks.h"
 #include "pfaedle/router/Misc.h"
 #include "pfaedle/router/RoutingAttrs.h"
+#include "pfaedle/trgraph/CsrGraph.h"
 #include "pfaedle/trgraph/Graph.h"
 #include "util/geo/Geo.h"
 #include "util/graph/Dijkstra.h"
@@ -31,12 +35,9 @@ namespace router {
 
 typedef std::unordered_map<const trgraph::Edge*, router::Node*> CombNodeMap;
 typedef std::pair<size_t, size_t> HId;
-typedef std::map<
-    RoutingAttrs,
-    std::unordered_map<const trgraph::Edge*,
-                       std::unordered_map<const trgraph::Edge*,
-                                          std::pair<EdgeCost, EdgeList> > > >
-    Cache;
+
+// maximum number of sources solved in a single many-to-many hop sweep
+static const size_t MAX_MATRIX_SRCS = 64;
 
 struct HopBand {
   double minD;
@@ -45,6 +46,62 @@ struct HopBand {
   double maxInGrpDist;
 };
 
+// search label of an edge or node in the CSR searches, only valid if the
+// stamp (without the flag bits) matches the current query
+struct CsrLabel {
+  uint32_t stamp;
+  float d;
+  float h;
+  uint32_t parent;
+};
+
+struct CsrLineLabel {
+  uint32_t stamp;
+  float simi;
+};
+
+struct CsrPQEntry {
+  float k;
+  float d;
+  uint32_t id;
+  uint32_t parent;
+  bool operator<(const CsrPQEntry& p) const {
+    return k > p.k || (k == p.k && d > p.d);
+  }
+};
+
+// edge state of the many-to-many CSR hop search. labels and costs are
+// offsets into the label pool (one label per source) and into the cached
+// turn costs to the outgoing edges, both only valid for the current stamp
+struct CsrMultiEdge {
+  uint32_t stamp;
+  float h;
+  uint32_t labels;
+  uint32_t costs;
+};
+
+struct CsrMultiLabel {
+  float d;
+  uint32_t parent;
+  bool settled;
+};
+
+// per-thread state of the CSR searches, indexed by edge, node and line ids.
+// Labels are invalidated by increasing the stamp, the heap and the result
+// buffer keep their capacity, so a search does not allocate once warm.
+struct CsrWorkspace {
+  uint32_t stamp;
+  std::vector<CsrLabel> edgs;
+  std::vector<CsrLabel> nds;
+  std::vector<CsrLineLabel> lines;
+  std::vector<CsrPQEntry> heap;
+  std::vector<uint32_t> found;
+
+  std::vector<CsrMultiEdge> mEdgs;
+  std::vector<CsrMultiLabel> mLabels;
+  std::vector<float> mCosts;
+};
+
 struct CostFunc
     : public EDijkstra::CostFunc<trgraph::NodePL, trgraph::EdgePL, EdgeCost> {
   CostFunc(const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
@@ -64,9 +121,15 @@ struct CostFunc
 
   EdgeCost operator()(const trgraph::Edge* from, const trgraph::Node* n,
                       const trgraph::Edge* to) const;
+
+  // Same as above, but for the edge ids from -> to of a CSR graph
+  EdgeCost operator()(const trgraph::CsrGraph& g, uint32_t from, uint32_t to,
+                      CsrWorkspace* ws) const;
   EdgeCost inf() const { return _inf; }
 
   double transitLineCmp(const trgraph::EdgePL& e) const;
+  double transitLineCmp(const trgraph::CsrGraph& g, uint32_t e,
+                        CsrWorkspace* ws) const;
 };
 
 struct NCostFunc
@@ -88,6 +151,9 @@ struct NCostFunc
 
   EdgeCost operator()(const trgraph::Node* from, const trgraph::Edge* e,
                       const trgraph::Node* to) const;
+
+  // Same as above, but for the edge id e of a CSR graph
+  EdgeCost operator()(const trgraph::CsrGraph& g, uint32_t e) const;
   EdgeCost inf() const { return _inf; }
 
   double transitLineCmp(const trgraph::EdgePL& e) const;
@@ -106,6 +172,22 @@ struct DistHeur
                       const std::set<trgraph::Edge*>& b) const;
 };
 
+struct LandmarkHeur
+    : public EDijkstra::HeurFunc<trgraph::NodePL, trgraph::EdgePL, EdgeCost> {
+  LandmarkHeur(const Landmarks& lms, const std::set<trgraph::Edge*>& tos);
+
+  const Landmarks& _lms;
+
+  // per target component: min distance from each landmark to a target and
+  // max distance from a target to each landmark
+  std::vector<const trgraph::Component*> _comps;
+  std::vector<float> _minFrom;
+  std::vector<float> _maxTo;
+
+  EdgeCost operator()(const trgraph::Edge* a,
+                      const std::set<trgraph::Edge*>& b) const;
+};
+
 struct NDistHeur
     : public Dijkstra::HeurFunc<trgraph::NodePL, trgraph::EdgePL, EdgeCost> {
   NDistHeur(const RoutingOpts& rOpts, const std::set<trgraph::Node*>& tos);
@@ -134,11 +216,14 @@ struct CombCostFunc
  */
 class Router {
  public:
-  // Init this router with caches for numThreads threads
-  explicit Router(size_t numThreads, bool caching);
+  // Init this router for numThreads threads, sharing a hop cache of
+  // (approx.) cacheSize bytes between them
+  Router(size_t numThreads, bool caching, size_t cacheSize);
   ~Router();
 
   // Find the most likely path through the graph for a node candidate route.
+  // Without cgraph, the route is solved layer by layer without building the
+  // combination graph. With cgraph, the combination graph is built in cgraph.
   EdgeListHops route(const NodeCandRoute& route, const RoutingAttrs& rAttrs,
                      const RoutingOpts& rOpts,
                      const osm::Restrictor& rest) const;
@@ -167,36 +252,103 @@ class Router {
                             const RoutingOpts& rOpts,
                             const osm::Restrictor& rest) const;
 
-  // Return the number of thread caches this router was initialized with
+  // Return the number of threads this router was initialized for
   size_t getCacheNumber() const;
 
+  // Return hit/miss statistics of the shared hop cache
+  HopCacheStats getCacheStats() const;
+
+  // Use landmark lower bounds to guide hop searches, 0 to disable
+  void setLandmarks(const Landmarks* lms);
+
+  // Run hop searches on a frozen CSR snapshot of the graph, 0 to disable
+  void setCsrGraph(const trgraph::CsrGraph* csr);
+
+  // Reuse the hops of stop pairs already solved for other trips, 0 to
+  // disable
+  void setHopMemo(HopMemo* memo);
+
  private:
-  mutable std::vector<Cache*> _cache;
+  size_t _numThreads;
+  mutable HopCache* _cache;
   bool _caching;
+  const Landmarks* _lms;
+  const trgraph::CsrGraph* _csr;
+  HopMemo* _memo;
+  mutable std::vector<CsrWorkspace*> _csrWs;
   HopBand getHopBand(const EdgeCandGroup& a, const EdgeCandGroup& b,
-                     const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
+                     const RoutingAttrs& rAttrs, size_t attrs,
+                     const RoutingOpts& rOpts,
                      const osm::Restrictor& rest) const;
 
   void hops(trgraph::Edge* from, const std::set<trgraph::Edge*>& froms,
             const std::set<trgraph::Edge*> to, const trgraph::StatGroup* tgGrp,
             const std::unordered_map<trgraph::Edge*, EdgeList*>& edgesRet,
             std::unordered_map<trgraph::Edge*, EdgeCost>* rCosts,
-            const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
+            const RoutingAttrs& rAttrs, size_t attrs, const RoutingOpts& rOpts,
             const osm::Restrictor& rest, HopBand hopB) const;
 
+  void hops(const std::set<trgraph::Edge*>& froms,
+            const std::set<trgraph::Edge*>& tos,
+            const trgraph::StatGroup* tgGrp, const HopEdgeLists& edgesRet,
+            HopCosts* rCosts, const RoutingAttrs& rAttrs, size_t attrs,
+            const RoutingOpts& rOpts, const osm::Restrictor& rest,
+            HopBand hopB) const;
+
+  template <typename H>
+  void csrHopMatrix(const std::vector<trgraph::Edge*>& froms,
+                    const std::vector<std::set<trgraph::Edge*>>& tos,
+                    const std::set<trgraph::Edge*>& allTos,
+                    const CostFunc& cost, const H& heur,
+                    const HopEdgeLists& edgesRet, HopCosts* rCosts,
+                    CsrWorkspace* ws) const;
+
+  template <typename H>
+  std::unordered_map<trgraph::Edge*, EdgeCost> csrHops(
+      trgraph::Edge* from, const std::set<trgraph::Edge*>& tos,
+      const CostFunc& cost, const H& heur,
+      const std::unordered_map<trgraph::Edge*, EdgeList*>& edgesRet,
+      CsrWorkspace* ws) const;
+
+  template <typename H>
+  EdgeCost csrShortestPath(const std::set<trgraph::Edge*>& froms,
+                           const std::set<trgraph::Edge*>& tos,
+                           const CostFunc& cost, const H& heur,
+                           EdgeList* resEdges, CsrWorkspace* ws) const;
+
+  template <typename H>
+  EdgeCost csrShortestPath(const std::set<trgraph::Node*>& froms,
+                           const std::set<trgraph::Node*>& tos,
+                           const NCostFunc& cost, const H& heur,
+                           EdgeList* resEdges, NodeList* resNodes,
+                           CsrWorkspace* ws) const;
+
+  template <typename S, typename H>
+  size_t csrSearch(const S& froms, const std::set<trgraph::Edge*>& tos,
+                   const CostFunc& cost, const H& heur, size_t maxFound,
+                   CsrWorkspace* ws) const;
+
+  void csrEdgePath(uint32_t e, const CsrWorkspace& ws, EdgeList* ret) const;
+
+  uint32_t newCsrStamp(CsrWorkspace* ws) const;
+
+  CsrWorkspace* getCsrWorkspace() const;
+
   std::set<trgraph::Edge*> getCachedHops(
       trgraph::Edge* from, const std::set<trgraph::Edge*>& to,
       const std::unordered_map<trgraph::Edge*, EdgeList*>& edgesRet,
       std::unordered_map<trgraph::Edge*, EdgeCost>* rCosts,
-      const RoutingAttrs& rAttrs) const;
+      size_t attrs) const;
 
   void cache(trgraph::Edge* from, trgraph::Edge* to, const EdgeCost& c,
-             EdgeList* edges, const RoutingAttrs& rAttrs) const;
+             EdgeList* edges, size_t attrs) const;
 
   void nestedCache(const EdgeList* el, const std::set<trgraph::Edge*>& froms,
-                   const CostFunc& cost, const RoutingAttrs& rAttrs) const;
+                   const CostFunc& cost, size_t attrs) const;
 
   bool compConned(const EdgeCandGroup& a, const EdgeCandGroup& b) const;
+
+  EdgeCandRoute edgeCands(const NodeCandRoute& route) const;
 };
 }  // namespace router
 }  // namespace pfaedle
@@ -5,9 +5,9 @@
 #ifndef PFAEDLE_ROUTER_ROUTINGATTRS_H_
 #define PFAEDLE_ROUTER_ROUTINGATTRS_H_
 
-#include <map>
 #include <string>
 #include "pfaedle/trgraph/EdgePL.h"
+#include "util/Interner.h"
 
 using pfaedle::trgraph::TransitEdgeLine;
 
@@ -15,18 +15,12 @@ namespace pfaedle {
 namespace router {
 
 struct RoutingAttrs {
-  RoutingAttrs() : fromString(""), toString(""), shortName(""), _simiCache() {}
-  std::string fromString;
-  std::string toString;
-  std::string shortName;
-
-  mutable std::map<const TransitEdgeLine*, double> _simiCache;
+  util::Sym fromString;
+  util::Sym toString;
+  util::Sym shortName;
 
   // carfull: lower return value = higher similarity
   double simi(const TransitEdgeLine* line) const {
-    auto i = _simiCache.find(line);
-    if (i != _simiCache.end()) return i->second;
-
     double cur = 1;
     if (shortName.empty() || router::lineSimi(line->shortName, shortName) > 0.5)
       cur -= 0.333333333;
@@ -39,8 +33,6 @@ struct RoutingAttrs {
         router::statSimi(line->fromStr, fromString) > 0.5)
       cur -= 0.333333333;
 
-    _simiCache[line] = cur;
-
     return cur;
   }
 };
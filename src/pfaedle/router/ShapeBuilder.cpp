@@ -9,12 +9,20 @@
 #define omp_get_num_procs() 1
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <exception>
+#include <iomanip>
 #include <map>
 #include <mutex>
+#include <set>
+#include <sstream>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include "ad/cppgtfs/gtfs/Feed.h"
 #include "pfaedle/Def.h"
 #include "pfaedle/eval/Collector.h"
@@ -23,6 +31,9 @@
 #include "pfaedle/osm/OsmBuilder.h"
 #include "pfaedle/router/ShapeBuilder.h"
 #include "pfaedle/trgraph/StatGroup.h"
+#include "util/Counter.h"
+#include "util/Profiler.h"
+#include "util/WorkPool.h"
 #include "util/geo/Geo.h"
 #include "util/geo/output/GeoGraphJsonOutput.h"
 #include "util/geo/output/GeoJsonOutput.h"
@@ -43,6 +54,8 @@ using pfaedle::osm::BBoxIdx;
 using pfaedle::router::Clusters;
 using pfaedle::router::EdgeListHops;
 using pfaedle::router::FeedStops;
+using pfaedle::router::Manifest;
+using pfaedle::router::ManifestEntry;
 using pfaedle::router::NodeCandGroup;
 using pfaedle::router::NodeCandRoute;
 using pfaedle::router::RoutingAttrs;
@@ -52,6 +65,29 @@ using util::geo::webMercMeterDist;
 using util::geo::webMercToLatLng;
 using util::geo::output::GeoGraphJsonOutput;
 
+static util::Counter TRIPS("trips_shaped", "Trips that got a shape");
+static util::Counter CLUSTERS("clusters_shaped", "Trip clusters routed");
+static util::Counter REUSED("clusters_reused",
+                            "Trip clusters whose shape was kept from the "
+                            "previous run");
+
+// size of the grid cells used to detect graph changes near trips, in web
+// mercator units
+static const double MANIFEST_CELL_SIZE = 10000;
+
+// _____________________________________________________________________________
+static std::pair<int64_t, int64_t> manifestCell(double x, double y) {
+  return {static_cast<int64_t>(std::floor(x / MANIFEST_CELL_SIZE)),
+          static_cast<int64_t>(std::floor(y / MANIFEST_CELL_SIZE))};
+}
+
+// _____________________________________________________________________________
+static int64_t usSinceEpoch() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 // _____________________________________________________________________________
 ShapeBuilder::ShapeBuilder(Feed* feed, ad::cppgtfs::gtfs::Feed* evalFeed,
                            MOTs mots, const config::MotConfig& motCfg,
@@ -65,11 +101,51 @@ ShapeBuilder::ShapeBuilder(Feed* feed, ad::cppgtfs::gtfs::Feed* evalFeed,
       _ecoll(ecoll),
       _cfg(cfg),
       _g(g),
-      _crouter(omp_get_num_procs(), cfg.useCaching),
+      _crouter(omp_get_num_procs(), cfg.useCaching,
+               cfg.routeCacheSize * 1024 * 1024),
+      _lms(0),
+      _memo(0),
+      _csr(0),
       _stops(fStops),
       _curShpCnt(0),
-      _restr(restr) {
+      _restr(restr),
+      _prevManifest(0),
+      _prevFeed(0),
+      _nextManifest(0) {
   _numThreads = _crouter.getCacheNumber();
+
+  auto t = TIME();
+  _csr = new trgraph::CsrGraph(*_g);
+  _crouter.setCsrGraph(_csr);
+  LOG(DEBUG) << "Built CSR snapshot of the graph (" << _csr->numNds()
+             << " nodes, " << _csr->numEdgs() << " edges) in "
+             << TOOK(t, TIME()) << " ms.";
+
+  if (_cfg.landmarks) {
+    LOG(DEBUG) << "Building " << _cfg.landmarks
+               << " landmarks per graph component...";
+    t = TIME();
+    // small components are cheap to search without guidance
+    _lms = new router::Landmarks(*_g, _motCfg.routingOpts, _cfg.landmarks,
+                                 100);
+    _crouter.setLandmarks(_lms);
+    LOG(DEBUG) << "Built landmarks for " << _lms->numComps()
+               << " components in " << TOOK(t, TIME()) << " ms.";
+  }
+
+  if (_cfg.hopMemoSize) {
+    // the memo is only valid for this graph, restrictor and routing options
+    _memo = new router::HopMemo(_cfg.hopMemoSize * 1024 * 1024,
+                                _numThreads * 16);
+    _crouter.setHopMemo(_memo);
+  }
+}
+
+// _____________________________________________________________________________
+ShapeBuilder::~ShapeBuilder() {
+  delete _lms;
+  delete _memo;
+  delete _csr;
 }
 
 // _____________________________________________________________________________
@@ -119,19 +195,21 @@ LINE ShapeBuilder::shapeL(Trip* trip) {
 // _____________________________________________________________________________
 EdgeListHops ShapeBuilder::route(const router::NodeCandRoute& ncr,
                                  const router::RoutingAttrs& rAttrs) const {
-  router::Graph g;
-
   if (_cfg.solveMethod == "global") {
+    if (_cfg.shapeTripId.empty() || !_cfg.writeCombGraph) {
+      return _crouter.route(ncr, rAttrs, _motCfg.routingOpts, *_restr);
+    }
+
+    // only build the combination graph if it should be written
+    router::Graph g;
     const router::EdgeListHops& ret =
         _crouter.route(ncr, rAttrs, _motCfg.routingOpts, *_restr, &g);
 
     // write combination graph
-    if (!_cfg.shapeTripId.empty() && _cfg.writeCombGraph) {
-      LOG(INFO) << "Outputting combgraph.json...";
-      std::ofstream pstr(_cfg.dbgOutputPath + "/combgraph.json");
-      GeoGraphJsonOutput o;
-      o.printLatLng(g, pstr);
-    }
+    LOG(INFO) << "Outputting combgraph.json...";
+    std::ofstream pstr(_cfg.dbgOutputPath + "/combgraph.json");
+    GeoGraphJsonOutput o;
+    o.printLatLng(g, pstr);
 
     return ret;
   } else if (_cfg.solveMethod == "greedy") {
@@ -182,7 +260,9 @@ void ShapeBuilder::shape(pfaedle::netgraph::Graph* ng) {
   TrGraphEdgs gtfsGraph;
 
   LOG(DEBUG) << "Clustering trips...";
+  util::Profiler::Scope prof("cluster_trips");
   Clusters clusters = clusterTrips(_feed, _mots);
+  prof.stop();
   LOG(DEBUG) << "Clustered trips into " << clusters.size() << " clusters.";
 
   std::map<std::string, size_t> shpUsage;
@@ -190,40 +270,101 @@ void ShapeBuilder::shape(pfaedle::netgraph::Graph* ng) {
     if (!t.getShape().empty()) shpUsage[t.getShape()]++;
   }
 
-  // to avoid unfair load balance on threads
-  std::random_shuffle(clusters.begin(), clusters.end());
+  // give shape shp with stop distances distances to all trips of cluster c
+  auto assign = [&](const Cluster& c, const ad::cppgtfs::gtfs::Shape& shp,
+                    const std::vector<double>& distances) {
+    for (auto t : c) {
+      if (_cfg.evaluate && _evalFeed && _ecoll) {
+        _ecoll->add(t, _evalFeed->getShapes().get(t->getShape()), shp,
+                    distances);
+      }
+
+      if (!t->getShape().empty() && shpUsage[t->getShape()] > 0) {
+        shpUsage[t->getShape()]--;
+        if (shpUsage[t->getShape()] == 0) {
+          std::lock_guard<std::mutex> guard(_shpMutex);
+          _feed->getShapes().remove(t->getShape());
+        }
+      }
+      setShape(t, shp, distances);
+    }
+  };
+
+  // clusters unchanged since the previous run keep their previous shape, the
+  // transit graph can only be built from matched clusters
+  std::vector<uint64_t> fps(clusters.size(), 0);
+  std::vector<size_t> todo;
+  size_t reused = REUSED;
+  for (size_t i = 0; i < clusters.size(); i++) {
+    if (_nextManifest) fps[i] = fingerprint(clusters[i][0]);
+
+    const ManifestEntry* prev = 0;
+    const ad::cppgtfs::gtfs::Shape* prevShp = 0;
+    if (_prevManifest && _prevFeed && !_cfg.buildTransitGraph) {
+      prev = _prevManifest->get(fps[i]);
+      if (prev) prevShp = _prevFeed->getShapes().get(prev->shapeId);
+    }
+
+    if (!prevShp ||
+        prev->dists.size() != clusters[i][0]->getStopTimes().size()) {
+      todo.push_back(i);
+      continue;
+    }
+
+    ad::cppgtfs::gtfs::Shape shp(getFreeShapeId(clusters[i][0]));
+    for (const auto& p : prevShp->getPoints()) shp.addPoint(p);
+    assign(clusters[i], shp, prev->dists);
+    _nextManifest->add(fps[i], ManifestEntry{shp.getId(), prev->dists});
+
+    REUSED++;
+    TRIPS += clusters[i].size();
+  }
+
+  if (_prevManifest) {
+    LOG(INFO) << "Reused shapes of " << REUSED - reused << " / "
+              << clusters.size() << " clusters from the previous run.";
+  }
+
+  // estimated work per cluster, clusters are dispatched longest-first
+  std::vector<double> costs(todo.size());
+  for (size_t i = 0; i < todo.size(); i++) {
+    costs[i] = estCost(clusters[todo[i]]);
+  }
 
-  size_t iters = EDijkstra::ITERS;
   size_t totiters = EDijkstra::ITERS;
-  size_t oiters = EDijkstra::ITERS;
-  size_t j = 0;
+  size_t totTrips = TRIPS;
+
+  // progress state, updated lock-free by the thread that logs
+  std::atomic<size_t> j(0);
+  std::atomic<size_t> oiters(EDijkstra::ITERS);
+  std::atomic<int64_t> t1(usSinceEpoch());
 
-  auto t1 = TIME();
   auto t2 = TIME();
   double totAvgDist = 0;
-  size_t totNumTrips = 0;
 
-#pragma omp parallel for num_threads(_numThreads)
-  for (size_t i = 0; i < clusters.size(); i++) {
-    j++;
-
-    if (j % 10 == 0) {
-#pragma omp critical
-      {
-        LOG(INFO) << "@ " << j << " / " << clusters.size() << " ("
-                  << (static_cast<int>((j * 1.0) / clusters.size() * 100))
-                  << "%, " << (EDijkstra::ITERS - oiters) << " iters, "
-                  << "matching " << (10.0 / (TOOK(t1, TIME()) / 1000))
-                  << " trips/sec)";
-
-        oiters = EDijkstra::ITERS;
-        t1 = TIME();
-      }
+  util::Profiler::Scope profMatch("match");
+  util::WorkPool pool(_numThreads);
+  pool.run(costs, [&](size_t k) {
+    size_t i = todo[k];
+    size_t cur = ++j;
+
+    if (cur % 10 == 0) {
+      size_t its = EDijkstra::ITERS;
+      int64_t now = usSinceEpoch();
+      size_t prevIts = oiters.exchange(its);
+      int64_t prevT = t1.exchange(now);
+
+      LOG(INFO) << "@ " << cur << " / " << todo.size() << " ("
+                << (static_cast<int>((cur * 1.0) / todo.size() * 100))
+                << "%, " << (its - prevIts) << " iters, "
+                << "matching " << (10.0 / ((now - prevT) / 1000000.0))
+                << " trips/sec)";
     }
 
     // explicitly call const version of shape here for thread safety
     const Shape& cshp =
         const_cast<const ShapeBuilder&>(*this).shape(clusters[i][0]);
+#pragma omp atomic
     totAvgDist += cshp.avgHopDist;
 
     if (_cfg.buildTransitGraph) {
@@ -235,50 +376,161 @@ void ShapeBuilder::shape(pfaedle::netgraph::Graph* ng) {
     const ad::cppgtfs::gtfs::Shape& shp =
         getGtfsShape(cshp, clusters[i][0], &distances);
 
-    LOG(VDEBUG) << "Took " << EDijkstra::ITERS - iters << " iterations.";
-    iters = EDijkstra::ITERS;
-
-    totNumTrips += clusters[i].size();
-
-    for (auto t : clusters[i]) {
-      if (_cfg.evaluate && _evalFeed && _ecoll) {
-        std::lock_guard<std::mutex> guard(_shpMutex);
-        _ecoll->add(t, _evalFeed->getShapes().get(t->getShape()), shp,
-                    distances);
-      }
+    CLUSTERS++;
+    TRIPS += clusters[i].size();
 
-      if (!t->getShape().empty() && shpUsage[t->getShape()] > 0) {
-        shpUsage[t->getShape()]--;
-        if (shpUsage[t->getShape()] == 0) {
-          std::lock_guard<std::mutex> guard(_shpMutex);
-          _feed->getShapes().remove(t->getShape());
-        }
-      }
-      setShape(t, shp, distances);
+    assign(clusters[i], shp, distances);
+    if (_nextManifest) {
+      _nextManifest->add(fps[i], ManifestEntry{shp.getId(), distances});
     }
+  });
+
+  double wall = profMatch.stop();
+  for (size_t i = 0; i < pool.getStats().size(); i++) {
+    const auto& st = pool.getStats()[i];
+    LOG(DEBUG) << "Thread " << i << ": " << st.tasks << " clusters ("
+               << st.steals << " stolen), busy " << st.busyMs << " ms, "
+               << (wall > 0 ? 100.0 * st.busyMs / wall : 100)
+               << "% utilization";
   }
 
-  LOG(INFO) << "Matched " << totNumTrips << " trips in " << clusters.size()
+  LOG(INFO) << "Matched " << TRIPS - totTrips << " trips in " << todo.size()
             << " clusters.";
   LOG(DEBUG) << "Took " << (EDijkstra::ITERS - totiters)
-             << " iterations in total.";
+             << " iterations in total ("
+             << (_lms ? "landmark" : "straight line") << " hop heuristic).";
   LOG(DEBUG) << "Took " << TOOK(t2, TIME()) << " ms in total.";
   LOG(DEBUG) << "Total avg. tput "
              << (static_cast<double>(EDijkstra::ITERS - totiters)) /
                     TOOK(t2, TIME())
              << " iters/sec";
   LOG(DEBUG) << "Total avg. trip tput "
-             << (clusters.size() / (TOOK(t2, TIME()) / 1000)) << " trips/sec";
+             << (todo.size() / (TOOK(t2, TIME()) / 1000)) << " trips/sec";
   LOG(DEBUG) << "Avg hop distance was "
-             << (totAvgDist / static_cast<double>(clusters.size()))
+             << (totAvgDist / static_cast<double>(todo.size()))
              << " meters";
 
+  if (_memo) {
+    const auto& mStats = _memo->getStats();
+    LOG(DEBUG) << "Hop memo: " << mStats.hits << " hits, " << mStats.misses
+               << " misses, " << mStats.evictions << " evictions, "
+               << mStats.entries << " entries (~"
+               << mStats.bytes / (1024 * 1024) << " MB)";
+  }
+
+  if (_cfg.useCaching) {
+    const auto& cStats = _crouter.getCacheStats();
+    LOG(DEBUG) << "Route cache: " << cStats.hits << " hits, " << cStats.misses
+               << " misses, " << cStats.evictions << " evictions, "
+               << cStats.entries << " entries (~"
+               << cStats.bytes / (1024 * 1024) << " MB)";
+  }
+
   if (_cfg.buildTransitGraph) {
     LOG(INFO) << "Building transit network graph...";
     buildTrGraph(&gtfsGraph, ng);
   }
 }
 
+// _____________________________________________________________________________
+void ShapeBuilder::setIncremental(const Manifest* prev,
+                                  const ad::cppgtfs::gtfs::Feed* prevFeed,
+                                  Manifest* next) {
+  _prevManifest = prev;
+  _prevFeed = prevFeed;
+  _nextManifest = next;
+  if (_nextManifest && _cellHashes.empty()) buildCellHashes();
+}
+
+// _____________________________________________________________________________
+void ShapeBuilder::buildCellHashes() {
+  auto t = TIME();
+  // hashes are summed up per cell, so they don't depend on the order of the
+  // nodes and edges in the graph. Coordinates are rounded to decimeters.
+  auto r = [](double d) { return std::to_string(llround(d * 10)); };
+
+  for (const auto* nd : *_g->getNds()) {
+    const POINT* geom = nd->pl().getGeom();
+    if (!geom) continue;
+    uint64_t& h = _cellHashes[manifestCell(geom->getX(), geom->getY())];
+
+    std::string str = "n" + r(geom->getX()) + "," + r(geom->getY());
+    if (nd->pl().getSI()) {
+      str += "|" + nd->pl().getSI()->getName() + "|" +
+             nd->pl().getSI()->getTrack();
+    }
+    h += Manifest::hash(str);
+
+    for (const auto* e : nd->getAdjListOut()) {
+      str = "e" + std::to_string(e->pl().lvl()) + "," +
+            std::to_string(e->pl().oneWay()) + "," +
+            std::to_string(e->pl().isRestricted());
+      for (const auto& p : *e->pl().getGeom()) {
+        str += "," + r(p.getX()) + "," + r(p.getY());
+      }
+      for (const auto* l : e->pl().getLines()) {
+        str += "|" + l->shortName.str() + "|" + l->fromStr.str() + "|" +
+               l->toStr.str();
+      }
+      h += Manifest::hash(str);
+    }
+  }
+
+  LOG(DEBUG) << "Hashed graph into " << _cellHashes.size() << " cells in "
+             << TOOK(t, TIME()) << " ms.";
+}
+
+// _____________________________________________________________________________
+uint64_t ShapeBuilder::fingerprint(Trip* t) {
+  // everything the matching of t depends on: its stops, its routing
+  // attributes, the routing options and the graph near its stops
+  const RoutingAttrs& rAttrs = getRAttrs(t);
+  const auto& ro = _motCfg.routingOpts;
+
+  std::stringstream ss;
+  ss << std::setprecision(10) << t->getRoute()->getType() << "|"
+     << rAttrs.fromString << "|" << rAttrs.toString << "|"
+     << rAttrs.shortName << "|" << _cfg.solveMethod << "|"
+     << ro.fullTurnPunishFac << "," << ro.fullTurnAngle << ","
+     << ro.passThruStationsPunish << "," << ro.oneWayPunishFac << ","
+     << ro.oneWayEdgePunish << "," << ro.lineUnmatchedPunishFact << ","
+     << ro.noLinesPunishFact << "," << ro.platformUnmatchedPen << ","
+     << ro.stationDistPenFactor << "," << ro.nonOsmPen;
+  for (size_t i = 0; i < 8; i++) ss << "," << ro.levelPunish[i];
+
+  // the cells covered by the bounding box of each hop, padded by one cell
+  std::set<std::pair<int64_t, int64_t>> cells;
+  POINT last;
+  bool first = true;
+  for (const auto& st : t->getStopTimes()) {
+    const Stop* s = st.getStop();
+    ss << "|" << s->getId() << "," << s->getLat() << "," << s->getLng() << ","
+       << s->getName() << "," << s->getPlatformCode();
+
+    POINT cur = latLngToWebMerc<PFAEDLE_PRECISION>(s->getLat(), s->getLng());
+    if (first) last = cur;
+    first = false;
+
+    auto a = manifestCell(std::min(last.getX(), cur.getX()),
+                          std::min(last.getY(), cur.getY()));
+    auto b = manifestCell(std::max(last.getX(), cur.getX()),
+                          std::max(last.getY(), cur.getY()));
+    for (int64_t x = a.first - 1; x <= b.first + 1; x++) {
+      for (int64_t y = a.second - 1; y <= b.second + 1; y++) {
+        cells.insert({x, y});
+      }
+    }
+    last = cur;
+  }
+
+  for (const auto& c : cells) {
+    auto i = _cellHashes.find(c);
+    if (i != _cellHashes.end()) ss << "|" << i->second;
+  }
+
+  return Manifest::hash(ss.str());
+}
+
 // _____________________________________________________________________________
 void ShapeBuilder::setShape(Trip* t, const ad::cppgtfs::gtfs::Shape& s,
                             const std::vector<double>& distances) {
@@ -290,7 +542,7 @@ void ShapeBuilder::setShape(Trip* t, const ad::cppgtfs::gtfs::Shape& s,
     i++;
   }
 
-  std::lock_guard<std::mutex> guard(_shpMutex);
+  // the shape container is thread safe
   t->setShape(_feed->getShapes().add(s));
 }
 
@@ -492,6 +744,30 @@ double ShapeBuilder::avgHopDist(Trip* trip) const {
   return sum / static_cast<double>(i);
 }
 
+// _____________________________________________________________________________
+double ShapeBuilder::estCost(const Cluster& c) const {
+  // the hop searches dominate, their work grows with the number of
+  // candidate pairs and with the hop distance
+  double ret = 0;
+  const Stop* prev = 0;
+
+  for (const auto& st : c[0]->getStopTimes()) {
+    if (prev) {
+      auto a = util::geo::latLngToWebMerc<PFAEDLE_PRECISION>(prev->getLat(),
+                                                             prev->getLng());
+      auto b = util::geo::latLngToWebMerc<PFAEDLE_PRECISION>(
+          st.getStop()->getLat(), st.getStop()->getLng());
+      double cands = std::max<size_t>(1, getNodeCands(prev).size()) *
+                     std::max<size_t>(1, getNodeCands(st.getStop()).size());
+      ret += cands * (1 + util::geo::webMercMeterDist(a, b));
+    }
+    prev = st.getStop();
+  }
+
+  // writing the shape for each trip of the cluster
+  return ret + c.size();
+}
+
 // _____________________________________________________________________________
 Clusters ShapeBuilder::clusterTrips(Feed* f, MOTs mots) {
   // building an index [start station, end station] -> [cluster]
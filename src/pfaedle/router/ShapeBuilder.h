@@ -5,6 +5,7 @@
 #ifndef PFAEDLE_ROUTER_SHAPEBUILDER_H_
 #define PFAEDLE_ROUTER_SHAPEBUILDER_H_
 
+#include <map>
 #include <mutex>
 #include <set>
 #include <string>
@@ -19,6 +20,7 @@
 #include "pfaedle/gtfs/Feed.h"
 #include "pfaedle/netgraph/Graph.h"
 #include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/Manifest.h"
 #include "pfaedle/router/Misc.h"
 #include "pfaedle/router/Router.h"
 #include "pfaedle/trgraph/Graph.h"
@@ -53,9 +55,16 @@ class ShapeBuilder {
                const config::MotConfig& motCfg, eval::Collector* ecoll,
                trgraph::Graph* g, router::FeedStops* stops,
                osm::Restrictor* restr, const config::Config& cfg);
+  ~ShapeBuilder();
 
   void shape(pfaedle::netgraph::Graph* ng);
 
+  // Copy the shapes of clusters found unchanged in prev from prevFeed
+  // instead of matching them, record all shaped clusters in next. prev and
+  // prevFeed may be 0.
+  void setIncremental(const Manifest* prev,
+                      const ad::cppgtfs::gtfs::Feed* prevFeed, Manifest* next);
+
   router::FeedStops* getFeedStops();
 
   const NodeCandGroup& getNodeCands(const Stop* s) const;
@@ -82,6 +91,9 @@ class ShapeBuilder {
   config::Config _cfg;
   trgraph::Graph* _g;
   router::Router _crouter;
+  router::Landmarks* _lms;
+  router::HopMemo* _memo;
+  trgraph::CsrGraph* _csr;
 
   router::FeedStops* _stops;
 
@@ -95,8 +107,18 @@ class ShapeBuilder {
 
   osm::Restrictor* _restr;
 
+  const Manifest* _prevManifest;
+  const ad::cppgtfs::gtfs::Feed* _prevFeed;
+  Manifest* _nextManifest;
+
+  // hashes of the graph parts in each grid cell, see buildCellHashes()
+  std::map<std::pair<int64_t, int64_t>, uint64_t> _cellHashes;
+
   void buildGraph(router::FeedStops* fStops);
 
+  void buildCellHashes();
+  uint64_t fingerprint(Trip* t);
+
   Clusters clusterTrips(Feed* f, MOTs mots);
   void writeTransitGraph(const Shape& shp, TrGraphEdgs* edgs,
                          const Cluster& cluster) const;
@@ -112,6 +134,9 @@ class ShapeBuilder {
 
   router::NodeCandRoute getNCR(Trip* trip) const;
   double avgHopDist(Trip* trip) const;
+
+  // Estimated work needed to shape cluster c
+  double estCost(const Cluster& c) const;
   const router::RoutingAttrs& getRAttrs(const Trip* trip) const;
   const router::RoutingAttrs& getRAttrs(const Trip* trip);
   bool routingEqual(Trip* a, Trip* b);
@@ -0,0 +1,107 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "pfaedle/trgraph/CsrGraph.h"
+#include "pfaedle/trgraph/StatInfo.h"
+
+using pfaedle::trgraph::CsrGraph;
+using pfaedle::trgraph::Edge;
+using pfaedle::trgraph::Node;
+
+// _____________________________________________________________________________
+CsrGraph::CsrGraph(const Graph& g) {
+  // number the nodes in BFS order, so that nodes close to each other in the
+  // graph are also close to each other in memory
+  _ndPtrs.reserve(g.getNds().size());
+  for (auto* n : g.getNds()) {
+    if (_ndIds.count(n)) continue;
+    std::queue<Node*> q;
+    q.push(n);
+    _ndIds[n] = _ndPtrs.size();
+    _ndPtrs.push_back(n);
+
+    while (!q.empty()) {
+      Node* cur = q.front();
+      q.pop();
+      for (auto* e : cur->getAdjListOut()) {
+        if (_ndIds.count(e->getTo())) continue;
+        _ndIds[e->getTo()] = _ndPtrs.size();
+        _ndPtrs.push_back(e->getTo());
+        q.push(e->getTo());
+      }
+      for (auto* e : cur->getAdjListIn()) {
+        if (_ndIds.count(e->getFrom())) continue;
+        _ndIds[e->getFrom()] = _ndPtrs.size();
+        _ndPtrs.push_back(e->getFrom());
+        q.push(e->getFrom());
+      }
+    }
+  }
+
+  std::unordered_map<const Component*, uint32_t> compIds;
+  std::unordered_map<const TransitEdgeLine*, uint32_t> lineIds;
+
+  _nds.reserve(_ndPtrs.size());
+  _geoms.reserve(_ndPtrs.size());
+  _outOffs.reserve(_ndPtrs.size() + 1);
+  _lineOffs.push_back(0);
+
+  // edges are numbered by their from node, so the outgoing edges of each node
+  // form a contiguous id range
+  for (auto* n : _ndPtrs) {
+    const StatInfo* si = n->pl().getSI();
+    _nds.push_back(CsrNode{si ? si->getGroup() : 0, si != 0});
+    _geoms.push_back(*n->pl().getGeom());
+    _outOffs.push_back(_edgs.size());
+
+    uint32_t comp = NO_ID;
+    if (n->pl().getComp()) {
+      comp = compIds.insert({n->pl().getComp(), compIds.size()}).first->second;
+    }
+
+    for (auto* e : n->getAdjListOut()) {
+      _edgIds[e] = _edgs.size();
+      _edgPtrs.push_back(e);
+      _edgs.push_back(CsrEdge{_ndIds[n], _ndIds[e->getTo()],
+                              e->pl().getLength(), comp,
+                              e->pl().lvl(), e->pl().oneWay(),
+                              e->pl().isRestricted()});
+
+      for (auto* l : e->pl().getLines()) {
+        _lines.push_back(lineIds.insert({l, lineIds.size()}).first->second);
+      }
+      _lineOffs.push_back(_lines.size());
+
+      if (e->pl().getGeom()->size() > 1) {
+        _hops.push_back(e->pl().frontHop());
+        _hops.push_back(e->pl().backHop());
+      } else {
+        _hops.push_back(*e->getTo()->pl().getGeom());
+        _hops.push_back(*n->pl().getGeom());
+      }
+    }
+  }
+
+  _outOffs.push_back(_edgs.size());
+
+  _lineObjs.resize(lineIds.size());
+  for (const auto& l : lineIds) _lineObjs[l.second] = l.first;
+}
+
+// _____________________________________________________________________________
+uint32_t CsrGraph::getId(const Edge* e) const {
+  auto i = _edgIds.find(e);
+  if (i == _edgIds.end()) return NO_ID;
+  return i->second;
+}
+
+// _____________________________________________________________________________
+uint32_t CsrGraph::getId(const Node* n) const {
+  auto i = _ndIds.find(n);
+  if (i == _ndIds.end()) return NO_ID;
+  return i->second;
+}
@@ -0,0 +1,96 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_TRGRAPH_CSRGRAPH_H_
+#define PFAEDLE_TRGRAPH_CSRGRAPH_H_
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "pfaedle/Def.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace trgraph {
+
+static const uint32_t NO_ID = std::numeric_limits<uint32_t>::max();
+
+struct CsrEdge {
+  uint32_t from;
+  uint32_t to;
+  double length;
+  uint32_t comp;
+  uint8_t lvl;
+  uint8_t oneWay;
+  bool restricted;
+};
+
+struct CsrNode {
+  const StatGroup* grp;
+  bool hasSI;
+};
+
+/*
+ * A frozen snapshot of a transit graph in compressed sparse row format.
+ * Nodes and edges are identified by dense integer ids, the outgoing edges of
+ * node n are the edges with ids outBegin(n) ... outEnd(n) - 1. All edge
+ * attributes needed during routing are held in contiguous arrays.
+ */
+class CsrGraph {
+ public:
+  explicit CsrGraph(const Graph& g);
+
+  CsrGraph(const CsrGraph&) = delete;
+  CsrGraph& operator=(const CsrGraph&) = delete;
+
+  size_t numNds() const { return _nds.size(); }
+  size_t numEdgs() const { return _edgs.size(); }
+  size_t numLines() const { return _lineObjs.size(); }
+
+  // Dense id of an original edge or node, NO_ID if unknown
+  uint32_t getId(const Edge* e) const;
+  uint32_t getId(const Node* n) const;
+
+  // Original edge or node for a dense id
+  Edge* getEdg(uint32_t e) const { return _edgPtrs[e]; }
+  Node* getNd(uint32_t n) const { return _ndPtrs[n]; }
+
+  const CsrEdge& edg(uint32_t e) const { return _edgs[e]; }
+  const CsrNode& nd(uint32_t n) const { return _nds[n]; }
+
+  uint32_t outBegin(uint32_t n) const { return _outOffs[n]; }
+  uint32_t outEnd(uint32_t n) const { return _outOffs[n + 1]; }
+  uint32_t getDeg(uint32_t n) const { return _outOffs[n + 1] - _outOffs[n]; }
+
+  // Line ids of edge e are line(linesBegin(e)) ... line(linesEnd(e) - 1)
+  uint32_t linesBegin(uint32_t e) const { return _lineOffs[e]; }
+  uint32_t linesEnd(uint32_t e) const { return _lineOffs[e + 1]; }
+  uint32_t line(uint32_t i) const { return _lines[i]; }
+  const TransitEdgeLine* getLine(uint32_t l) const { return _lineObjs[l]; }
+
+  const POINT& frontHop(uint32_t e) const { return _hops[2 * e]; }
+  const POINT& backHop(uint32_t e) const { return _hops[2 * e + 1]; }
+  const POINT& getGeom(uint32_t n) const { return _geoms[n]; }
+
+ private:
+  std::vector<CsrEdge> _edgs;
+  std::vector<CsrNode> _nds;
+  std::vector<uint32_t> _outOffs;
+
+  std::vector<uint32_t> _lineOffs;
+  std::vector<uint32_t> _lines;
+  std::vector<const TransitEdgeLine*> _lineObjs;
+
+  std::vector<POINT> _hops;
+  std::vector<POINT> _geoms;
+
+  std::vector<Edge*> _edgPtrs;
+  std::vector<Node*> _ndPtrs;
+  std::unordered_map<const Edge*, uint32_t> _edgIds;
+  std::unordered_map<const Node*, uint32_t> _ndIds;
+};
+}  // namespace trgraph
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_TRGRAPH_CSRGRAPH_H_
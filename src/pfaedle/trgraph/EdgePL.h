@@ -11,6 +11,7 @@
 #include <vector>
 #include "pfaedle/Def.h"
 #include "pfaedle/router/Comp.h"
+#include "util/Interner.h"
 #include "util/geo/Geo.h"
 #include "util/geo/GeoGraph.h"
 
@@ -25,9 +26,9 @@ namespace trgraph {
  * A line occuring on an edge
  */
 struct TransitEdgeLine {
-  std::string fromStr;
-  std::string toStr;
-  std::string shortName;
+  util::Sym fromStr;
+  util::Sym toStr;
+  util::Sym shortName;
 };
 
 inline bool operator==(const TransitEdgeLine& a, const TransitEdgeLine& b) {
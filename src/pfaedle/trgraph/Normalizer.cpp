@@ -4,6 +4,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <regex>
@@ -15,10 +18,29 @@
 #include "pfaedle/trgraph/Normalizer.h"
 
 using pfaedle::trgraph::Normalizer;
+using pfaedle::trgraph::ReplRuleComp;
+using pfaedle::trgraph::ReplRules;
+
+static const size_t NORM_CACHE_SHARDS = 16;
+
+// _____________________________________________________________________________
+static char lower(char c) {
+  // like the icase regexes, only fold ASCII
+  return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+// _____________________________________________________________________________
+static bool isWordChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+// _____________________________________________________________________________
+Normalizer::Normalizer() : _cache(NORM_CACHE_SHARDS) {}
 
 // _____________________________________________________________________________
 Normalizer::Normalizer(const ReplRules& rules)
-    : _rulesOrig(rules) {
+    : _rulesOrig(rules), _cache(NORM_CACHE_SHARDS) {
   buildRules(rules);
 }
 
@@ -26,62 +48,221 @@ Normalizer::Normalizer(const ReplRules& rules)
 Normalizer::Normalizer(const Normalizer& other)
     : _rules(other._rules),
       _rulesOrig(other._rulesOrig),
-      _cache(other._cache) {}
+      _cache(NORM_CACHE_SHARDS) {
+  for (size_t i = 0; i < NORM_CACHE_SHARDS; i++) {
+    std::lock_guard<std::mutex> lock(other._cache[i].m);
+    _cache[i].map = other._cache[i].map;
+  }
+}
 
 // _____________________________________________________________________________
 Normalizer& Normalizer::operator=(Normalizer other) {
   std::swap(this->_rules, other._rules);
   std::swap(this->_rulesOrig, other._rulesOrig);
-  std::swap(this->_cache, other._cache);
+  for (size_t i = 0; i < NORM_CACHE_SHARDS; i++) {
+    std::lock_guard<std::mutex> lock(_cache[i].m);
+    std::swap(this->_cache[i].map, other._cache[i].map);
+  }
 
   return *this;
 }
 
 // _____________________________________________________________________________
-std::string Normalizer::operator()(std::string sn) const {
-  return normTS(sn);
-}
+std::string Normalizer::operator()(std::string sn) const { return norm(sn); }
 
 // _____________________________________________________________________________
-std::string Normalizer::normTS(const std::string& sn) const {
-  std::lock_guard<std::mutex> lock(_mutex);
-  return norm(sn);
-}
+std::string Normalizer::normTS(const std::string& sn) const { return norm(sn); }
 
 // _____________________________________________________________________________
 std::string Normalizer::norm(const std::string& sn) const {
-  auto i = _cache.find(sn);
-  if (i != _cache.end()) return i->second;
+  size_t h = std::hash<std::string>()(sn);
+  CacheShard& s = _cache[(h ^ (h >> 17)) % NORM_CACHE_SHARDS];
 
-  std::string ret = sn;
-  for (auto rule : _rules) {
-    std::string tmp;
-    std::regex_replace(std::back_inserter(tmp), ret.begin(), ret.end(),
-                       rule.first, rule.second,
-                       std::regex_constants::format_sed);
-    std::swap(ret, tmp);
+  {
+    std::lock_guard<std::mutex> lock(s.m);
+    auto i = s.map.find(h);
+    if (i != s.map.end()) {
+      for (const auto& e : i->second) {
+        if (e.first == sn) return e.second;
+      }
+    }
   }
 
-  std::transform(ret.begin(), ret.end(), ret.begin(), ::tolower);
+  // normalize outside the lock, a concurrent caller may do the same work
+  std::string ret = apply(sn);
 
-  _cache[sn] = ret;
+  std::lock_guard<std::mutex> lock(s.m);
+  auto& bucket = s.map[h];
+  for (const auto& e : bucket) {
+    if (e.first == sn) return ret;
+  }
+  bucket.push_back({sn, ret});
 
   return ret;
 }
 
+// _____________________________________________________________________________
+std::string Normalizer::apply(const std::string& sn) const {
+  std::string ret = sn;
+  std::string low(sn.size(), 0);
+  std::transform(ret.begin(), ret.end(), low.begin(), lower);
+  std::string tmp;
+
+  for (const auto& rule : _rules) {
+    if (!rule.needle.empty() && low.find(rule.needle) == std::string::npos) {
+      continue;
+    }
+
+    tmp.clear();
+    if (rule.literal) {
+      size_t last = 0;
+      size_t pos;
+      while ((pos = low.find(rule.needle, last)) != std::string::npos) {
+        tmp.append(ret, last, pos - last);
+        tmp.append(rule.repl);
+        last = pos + rule.needle.size();
+      }
+      tmp.append(ret, last, std::string::npos);
+    } else {
+      if (!std::regex_search(ret, rule.regex)) continue;
+      std::regex_replace(std::back_inserter(tmp), ret.begin(), ret.end(),
+                         rule.regex, rule.repl,
+                         std::regex_constants::format_sed);
+    }
+
+    std::swap(ret, tmp);
+    low.resize(ret.size());
+    std::transform(ret.begin(), ret.end(), low.begin(), lower);
+  }
+
+  return low;
+}
+
 // _____________________________________________________________________________
 bool Normalizer::operator==(const Normalizer& b) const {
   return _rulesOrig == b._rulesOrig;
 }
 
+// _____________________________________________________________________________
+const ReplRules& Normalizer::getRules() const { return _rulesOrig; }
+
+// _____________________________________________________________________________
+bool Normalizer::isLiteral(const std::string& pattern, std::string* lit) {
+  lit->clear();
+  for (size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if (c == '\\') {
+      // escaped punctuation is literal, \s, \d, \1, ... are not
+      if (i + 1 == pattern.size() || isWordChar(pattern[i + 1])) return false;
+      c = pattern[++i];
+    } else if (strchr("^$.|?*+()[]{}", c)) {
+      return false;
+    }
+    lit->push_back(lower(c));
+  }
+  return !lit->empty();
+}
+
+// _____________________________________________________________________________
+std::string Normalizer::getNeedle(const std::string& pattern) {
+  // longest run of literal characters on the top level of the pattern which
+  // are not subject to a quantifier. Groups and classes end a run.
+  std::string best, cur;
+  bool lastLit = false;
+
+  auto endRun = [&]() {
+    if (cur.size() > best.size()) best = cur;
+    cur.clear();
+    lastLit = false;
+  };
+
+  for (size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if (c == '\\') {
+      if (i + 1 == pattern.size()) return "";
+      if (isWordChar(pattern[i + 1])) {
+        // classes and backreferences end a run, other escapes like \xHH,
+        // \uHHHH or \cX span more than one character, give up on them
+        if (!strchr("bBdDsSwW123456789", pattern[i + 1])) return "";
+        i++;
+        endRun();
+        continue;
+      }
+      cur.push_back(lower(pattern[++i]));
+      lastLit = true;
+    } else if (c == '|') {
+      // alternatives on the top level, no common string
+      return "";
+    } else if (c == '(') {
+      size_t depth = 0;
+      for (; i < pattern.size(); i++) {
+        if (pattern[i] == '\\') {
+          i++;
+        } else if (pattern[i] == '[') {
+          // classes may contain unescaped parentheses
+          i++;
+          if (i < pattern.size() && pattern[i] == '^') i++;
+          if (i < pattern.size() && pattern[i] == ']') i++;
+          while (i < pattern.size() && pattern[i] != ']') {
+            if (pattern[i] == '\\') i++;
+            i++;
+          }
+        } else if (pattern[i] == '(') {
+          depth++;
+        } else if (pattern[i] == ')') {
+          if (--depth == 0) break;
+        }
+      }
+      if (i >= pattern.size()) return "";
+      endRun();
+    } else if (c == '[') {
+      i++;
+      if (i < pattern.size() && pattern[i] == '^') i++;
+      if (i < pattern.size() && pattern[i] == ']') i++;
+      while (i < pattern.size() && pattern[i] != ']') {
+        if (pattern[i] == '\\') i++;
+        i++;
+      }
+      if (i >= pattern.size()) return "";
+      endRun();
+    } else if (c == '*' || c == '?' || c == '{') {
+      // the previous character is optional
+      if (lastLit) cur.pop_back();
+      endRun();
+      if (c == '{') {
+        while (i < pattern.size() && pattern[i] != '}') i++;
+      }
+    } else if (c == '+') {
+      // the previous character occurs at least once, but maybe repeated
+      endRun();
+    } else if (c == '.' || c == '^' || c == '$' || c == ')' || c == ']' ||
+               c == '}') {
+      endRun();
+    } else {
+      cur.push_back(lower(c));
+      lastLit = true;
+    }
+  }
+
+  endRun();
+  return best;
+}
+
 // _____________________________________________________________________________
 void Normalizer::buildRules(const ReplRules& rules) {
   for (auto rule : rules) {
     try {
-      _rules.push_back(ReplRuleComp(
+      ReplRuleComp comp{
           std::regex(rule.first, std::regex::ECMAScript | std::regex::icase |
                                      std::regex::optimize),
-          rule.second));
+          rule.second, false, ""};
+
+      // in sed format, & and \n refer to the match
+      comp.literal = isLiteral(rule.first, &comp.needle) &&
+                     rule.second.find_first_of("&\\") == std::string::npos;
+      if (!comp.literal) comp.needle = getNeedle(rule.first);
+
+      _rules.push_back(comp);
     } catch (const std::regex_error& e) {
       std::stringstream ss;
       ss << "'" << rule.first << "'"
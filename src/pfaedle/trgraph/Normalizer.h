@@ -18,7 +18,22 @@ namespace trgraph {
 typedef std::pair<std::string, std::string> ReplRule;
 typedef std::vector<ReplRule> ReplRules;
 
-typedef std::pair<std::regex, std::string> ReplRuleComp;
+/*
+ * A compiled replacement rule. Rules whose pattern is a plain string are
+ * applied without the regex engine, all others are only run if the input
+ * contains the string every match of the pattern must contain.
+ */
+struct ReplRuleComp {
+  std::regex regex;
+  std::string repl;
+
+  // the pattern is the (lower case) plain string needle
+  bool literal;
+
+  // lower case string contained in every match of the pattern, may be empty
+  std::string needle;
+};
+
 typedef std::vector<ReplRuleComp> ReplRulesComp;
 
 /*
@@ -26,7 +41,7 @@ typedef std::vector<ReplRuleComp> ReplRulesComp;
  */
 class Normalizer {
  public:
-  Normalizer() {}
+  Normalizer();
   explicit Normalizer(const ReplRules& rules);
 
   // copy constructor
@@ -35,23 +50,43 @@ class Normalizer {
   // assignment op
   Normalizer& operator=(Normalizer other);
 
-  // Normalize sn, not thread safe
-  std::string norm(const std::string& sn) const;
   // Normalize sn, thread safe
+  std::string norm(const std::string& sn) const;
+  // Normalize sn, thread safe, same as norm()
   std::string normTS(const std::string& sn) const;
 
-  // Normalize sn based on the rules of this normalizer, uses the thread safe
-  // version of norm() internally
+  // Normalize sn based on the rules of this normalizer
   std::string operator()(std::string sn) const;
   bool operator==(const Normalizer& b) const;
 
+  // Return the (uncompiled) replacement rules of this normalizer
+  const ReplRules& getRules() const;
+
+  // Return the string every match of pattern (case insensitive) must
+  // contain, lower case. Empty if no such string could be found.
+  static std::string getNeedle(const std::string& pattern);
+
+  // If pattern matches a plain string only, write it (unescaped) to lit
+  static bool isLiteral(const std::string& pattern, std::string* lit);
+
  private:
+  // normalized strings by the hash of their input, the hash picks the shard
+  // and is only computed once per lookup
+  struct CacheShard {
+    std::mutex m;
+    std::unordered_map<size_t, std::vector<std::pair<std::string, std::string>>>
+        map;
+  };
+
   ReplRulesComp _rules;
   ReplRules _rulesOrig;
-  mutable std::unordered_map<std::string, std::string> _cache;
-  mutable std::mutex _mutex;
+
+  // the cache is split into independently locked shards, so concurrent
+  // callers rarely wait for each other
+  mutable std::vector<CacheShard> _cache;
 
   void buildRules(const ReplRules& rules);
+  std::string apply(const std::string& sn) const;
 };
 }  // namespace trgraph
 }  // namespace pfaedle
@@ -12,7 +12,7 @@ using pfaedle::trgraph::StatGroup;
 std::unordered_map<const StatGroup*, size_t> StatInfo::_groups;
 
 // _____________________________________________________________________________
-StatInfo::StatInfo() : _name(""), _track(""), _fromOsm(false), _group(0) {}
+StatInfo::StatInfo() : _fromOsm(false), _group(0) {}
 
 // _____________________________________________________________________________
 StatInfo::StatInfo(const StatInfo& si)
@@ -65,10 +65,10 @@ void StatInfo::setGroup(StatGroup* g) {
 StatGroup* StatInfo::getGroup() const { return _group; }
 
 // _____________________________________________________________________________
-const std::string& StatInfo::getName() const { return _name; }
+const std::string& StatInfo::getName() const { return _name.str(); }
 
 // _____________________________________________________________________________
-const std::string& StatInfo::getTrack() const { return _track; }
+const std::string& StatInfo::getTrack() const { return _track.str(); }
 
 // _____________________________________________________________________________
 bool StatInfo::isFromOsm() const { return _fromOsm; }
@@ -79,10 +79,10 @@ void StatInfo::setIsFromOsm(bool is) { _fromOsm = is; }
 // _____________________________________________________________________________
 double StatInfo::simi(const StatInfo* other) const {
   if (!other) return 0;
-  if (router::statSimi(_name, other->getName()) > 0.5) return 1;
+  if (router::statSimi(_name, other->_name) > 0.5) return 1;
 
   for (const auto& a : _altNames) {
-    if (router::statSimi(a, other->getName()) > 0.5) return 1;
+    if (router::statSimi(a, other->_name) > 0.5) return 1;
     for (const auto& b : other->getAltNames()) {
       if (router::statSimi(a, b) > 0.5) return 1;
     }
@@ -96,7 +96,7 @@ double StatInfo::simi(const StatInfo* other) const {
 }
 
 // _____________________________________________________________________________
-const std::vector<std::string>& StatInfo::getAltNames() const {
+const std::vector<util::Sym>& StatInfo::getAltNames() const {
   return _altNames;
 }
 
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include "util/Interner.h"
 
 namespace pfaedle {
 namespace trgraph {
@@ -35,7 +36,7 @@ class StatInfo {
   void addAltName(const std::string& name);
 
   // Return all alternative names for this station.
-  const std::vector<std::string>& getAltNames() const;
+  const std::vector<util::Sym>& getAltNames() const;
 
   // Set the track of this stop.
   void setTrack(const std::string& tr);
@@ -61,9 +62,9 @@ class StatInfo {
 #endif
 
  private:
-  std::string _name;
-  std::vector<std::string> _altNames;
-  std::string _track;
+  util::Sym _name;
+  std::vector<util::Sym> _altNames;
+  util::Sym _track;
   bool _fromOsm;
   StatGroup* _group;
 
@@ -0,0 +1,207 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_thread_num() 0
+#endif
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "util/Counter.h"
+#include "util/json/Writer.h"
+
+using util::Counter;
+
+namespace {
+
+struct Registry {
+  std::mutex m;
+  std::vector<Counter*> counters;
+};
+
+// (name, label key, label value) -> (help, value)
+typedef std::map<std::tuple<std::string, std::string, std::string>,
+                 std::pair<std::string, size_t>>
+    Aggregate;
+
+// _____________________________________________________________________________
+Registry& registry() {
+  // never destroyed, counters may unregister during static destruction
+  static Registry* r = new Registry();
+  return *r;
+}
+}  // namespace
+
+// _____________________________________________________________________________
+Counter::Counter() : _shards(newShards()) {}
+
+// _____________________________________________________________________________
+Counter::Counter(const std::string& name, const std::string& help)
+    : _shards(newShards()), _name(name), _help(help) {
+  reg();
+}
+
+// _____________________________________________________________________________
+Counter::Counter(const std::string& name, const std::string& help,
+                 const std::string& labelKey, const std::string& labelVal)
+    : _shards(newShards()),
+      _name(name),
+      _help(help),
+      _labelKey(labelKey),
+      _labelVal(labelVal) {
+  reg();
+}
+
+// _____________________________________________________________________________
+Counter::~Counter() {
+  free(_shards);
+  if (_name.empty()) return;
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.m);
+  r.counters.erase(std::remove(r.counters.begin(), r.counters.end(), this),
+                   r.counters.end());
+}
+
+// _____________________________________________________________________________
+Counter::Shard* Counter::newShards() {
+  void* p = 0;
+  if (posix_memalign(&p, alignof(Shard), sizeof(Shard) * COUNTER_SHARDS)) {
+    throw std::bad_alloc();
+  }
+  Shard* ret = static_cast<Shard*>(p);
+  for (size_t i = 0; i < COUNTER_SHARDS; i++) new (&ret[i]) Shard{{0}};
+  return ret;
+}
+
+// _____________________________________________________________________________
+void Counter::reg() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.m);
+  r.counters.push_back(this);
+}
+
+// _____________________________________________________________________________
+void Counter::add(size_t v) {
+  _shards[omp_get_thread_num() % COUNTER_SHARDS].v.fetch_add(
+      v, std::memory_order_relaxed);
+}
+
+// _____________________________________________________________________________
+size_t Counter::get() const {
+  size_t ret = 0;
+  for (size_t i = 0; i < COUNTER_SHARDS; i++) {
+    ret += _shards[i].v.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+Counter& Counter::named(const std::string& name, const std::string& help,
+                        const std::string& labelKey,
+                        const std::string& labelVal) {
+  static std::mutex m;
+  std::lock_guard<std::mutex> lock(m);
+
+  {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> rLock(r.m);
+    for (auto c : r.counters) {
+      if (c->_name == name && c->_labelKey == labelKey &&
+          c->_labelVal == labelVal)
+        return *c;
+    }
+  }
+
+  return *new Counter(name, help, labelKey, labelVal);
+}
+
+// _____________________________________________________________________________
+static Aggregate aggregate() {
+  Aggregate ret;
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.m);
+  for (auto c : r.counters) {
+    auto& v = ret[std::make_tuple(c->getName(), c->getLabelKey(),
+                                  c->getLabelVal())];
+    v.first = c->getHelp();
+    v.second += c->get();
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+std::vector<std::pair<std::string, size_t>> Counter::snapshot() {
+  std::vector<std::pair<std::string, size_t>> ret;
+  for (const auto& kv : aggregate()) {
+    std::string name = std::get<0>(kv.first);
+    if (!std::get<1>(kv.first).empty()) {
+      name += "{" + std::get<1>(kv.first) + "=" + std::get<2>(kv.first) + "}";
+    }
+    ret.push_back({name, kv.second.second});
+  }
+  return ret;
+}
+
+// _____________________________________________________________________________
+void Counter::writeJson(std::ostream* out) {
+  // unlabeled counters are written as "name": value, labeled counters as
+  // "name": {"label value": value, ...}. If a name is used both with and
+  // without a label, the unlabeled value is nested under the empty key.
+  util::json::Writer w(out, 0, true);
+  w.obj();
+
+  Aggregate agg = aggregate();
+  for (auto i = agg.begin(); i != agg.end();) {
+    const std::string name = std::get<0>(i->first);
+    auto next = i;
+    next++;
+
+    if (std::get<1>(i->first).empty() &&
+        (next == agg.end() || std::get<0>(next->first) != name)) {
+      w.key(name);
+      w.val(static_cast<double>(i->second.second));
+      i = next;
+      continue;
+    }
+
+    w.key(name);
+    w.obj();
+    for (; i != agg.end() && std::get<0>(i->first) == name; i++) {
+      w.key(std::get<2>(i->first));
+      w.val(static_cast<double>(i->second.second));
+    }
+    w.close();
+  }
+
+  w.closeAll();
+  *out << std::endl;
+}
+
+// _____________________________________________________________________________
+void Counter::writePrometheus(std::ostream* out, const std::string& prefix) {
+  std::string last;
+  for (const auto& kv : aggregate()) {
+    std::string name = prefix + std::get<0>(kv.first);
+    if (name != last) {
+      *out << "# HELP " << name << " " << kv.second.first << "\n";
+      *out << "# TYPE " << name << " counter\n";
+      last = name;
+    }
+    *out << name;
+    if (!std::get<1>(kv.first).empty()) {
+      *out << "{" << std::get<1>(kv.first) << "=\"" << std::get<2>(kv.first)
+           << "\"}";
+    }
+    *out << " " << kv.second.second << "\n";
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_COUNTER_H_
+#define UTIL_COUNTER_H_
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// number of shards per counter, threads are mapped to shards by their
+// OpenMP thread number. Each shard occupies its own cache line.
+static const size_t COUNTER_SHARDS = 64;
+
+/*
+ * A counter which can be incremented from many threads without contention.
+ * Each thread increments its own cache line, reading the counter sums up all
+ * shards.
+ *
+ * Named counters register themselves in a global registry, from which all
+ * counters can be dumped as JSON or in the Prometheus text format. Counters
+ * with the same name and label are summed up in the dumps.
+ */
+class Counter {
+ public:
+  // Unnamed counter, not part of the registry
+  Counter();
+
+  // Counter in the registry, with an optional single label
+  Counter(const std::string& name, const std::string& help);
+  Counter(const std::string& name, const std::string& help,
+          const std::string& labelKey, const std::string& labelVal);
+  ~Counter();
+
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  void operator++(int) { add(1); }
+  Counter& operator+=(size_t v) {
+    add(v);
+    return *this;
+  }
+
+  operator size_t() const { return get(); }
+  size_t get() const;
+
+  void add(size_t v);
+
+  const std::string& getName() const { return _name; }
+  const std::string& getHelp() const { return _help; }
+  const std::string& getLabelKey() const { return _labelKey; }
+  const std::string& getLabelVal() const { return _labelVal; }
+
+  // Registry counter for name and label, created on first use and never
+  // freed. Use this for counters whose labels are only known at runtime.
+  static Counter& named(const std::string& name, const std::string& help,
+                        const std::string& labelKey,
+                        const std::string& labelVal);
+
+  // Current values of all registered counters, summed up by name and label
+  // and sorted by name
+  static std::vector<std::pair<std::string, size_t>> snapshot();
+
+  static void writeJson(std::ostream* out);
+  static void writePrometheus(std::ostream* out, const std::string& prefix);
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<size_t> v;
+  };
+
+  // allocated separately, the heap does not align counters to cache lines
+  Shard* _shards;
+
+  std::string _name;
+  std::string _help;
+  std::string _labelKey;
+  std::string _labelVal;
+
+  void reg();
+  static Shard* newShards();
+};
+}  // namespace util
+
+#endif  // UTIL_COUNTER_H_
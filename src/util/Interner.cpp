@@ -0,0 +1,59 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include "util/Interner.h"
+
+using util::Interner;
+
+static const size_t BLOCK_SIZE = 1 << util::INTERNER_BLOCK_BITS;
+static const size_t NUM_BLOCKS = 1 << (32 - util::INTERNER_BLOCK_BITS);
+
+// _____________________________________________________________________________
+Interner::Interner() {
+  for (size_t i = 0; i < NUM_BLOCKS; i++) _blocks[i] = 0;
+  intern("");
+}
+
+// _____________________________________________________________________________
+Interner::~Interner() {
+  for (size_t i = 0; i < NUM_BLOCKS; i++) delete[] _blocks[i].load();
+}
+
+// _____________________________________________________________________________
+uint32_t Interner::intern(const std::string& str) {
+  std::lock_guard<std::mutex> lock(_m);
+  auto i = _idx.find(str);
+  if (i != _idx.end()) return i->second;
+
+  size_t id = _idx.size();
+  if (id >= BLOCK_SIZE * NUM_BLOCKS) {
+    throw std::length_error("Interner is full");
+  }
+
+  const std::string** block = _blocks[id / BLOCK_SIZE].load();
+  if (!block) {
+    block = new const std::string*[BLOCK_SIZE];
+    _blocks[id / BLOCK_SIZE].store(block, std::memory_order_release);
+  }
+
+  i = _idx.insert({str, static_cast<uint32_t>(id)}).first;
+  block[id % BLOCK_SIZE] = &i->first;
+  return id;
+}
+
+// _____________________________________________________________________________
+size_t Interner::size() const {
+  std::lock_guard<std::mutex> lock(_m);
+  return _idx.size();
+}
+
+// _____________________________________________________________________________
+Interner& Interner::global() {
+  // never destructed, symbols may be used during static destruction
+  static Interner* interner = new Interner();
+  return *interner;
+}
@@ -0,0 +1,89 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_INTERNER_H_
+#define UTIL_INTERNER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace util {
+
+// strings per block of the interner's id table
+static const size_t INTERNER_BLOCK_BITS = 16;
+
+/*
+ * Maps strings to dense 32 bit ids and back. Each distinct string is stored
+ * once and never freed, id 0 is the empty string. Interning takes a lock,
+ * looking up the string of an id does not.
+ */
+class Interner {
+ public:
+  Interner();
+  ~Interner();
+
+  Interner(const Interner&) = delete;
+  Interner& operator=(const Interner&) = delete;
+
+  // Return the id of str, interning it on first use
+  uint32_t intern(const std::string& str);
+
+  // Return the string of id, which must have been returned by intern()
+  const std::string& get(uint32_t id) const {
+    return *_blocks[id >> INTERNER_BLOCK_BITS].load(
+        std::memory_order_acquire)[id & ((1 << INTERNER_BLOCK_BITS) - 1)];
+  }
+
+  // Number of distinct strings, including the empty string
+  size_t size() const;
+
+  // The interner used by Sym
+  static Interner& global();
+
+ private:
+  mutable std::mutex _m;
+  // the index keys are stable, the blocks point into them
+  std::unordered_map<std::string, uint32_t> _idx;
+  std::atomic<const std::string**> _blocks[1 << (32 - INTERNER_BLOCK_BITS)];
+};
+
+/*
+ * A string interned in the global interner. Copying and comparing for
+ * equality only touch the 32 bit id, ordering compares the strings.
+ */
+class Sym {
+ public:
+  Sym() : _id(0) {}
+  Sym(const std::string& str)  // NOLINT
+      : _id(str.empty() ? 0 : Interner::global().intern(str)) {}
+  Sym(const char* str) : Sym(std::string(str)) {}  // NOLINT
+
+  uint32_t id() const { return _id; }
+  const std::string& str() const { return Interner::global().get(_id); }
+  operator const std::string&() const { return str(); }  // NOLINT
+
+  bool empty() const { return _id == 0; }
+  size_t size() const { return str().size(); }
+
+ private:
+  uint32_t _id;
+};
+
+inline bool operator==(const Sym& a, const Sym& b) { return a.id() == b.id(); }
+inline bool operator!=(const Sym& a, const Sym& b) { return a.id() != b.id(); }
+inline bool operator<(const Sym& a, const Sym& b) {
+  return a.id() != b.id() && a.str() < b.str();
+}
+
+inline std::ostream& operator<<(std::ostream& os, const Sym& s) {
+  return os << s.str();
+}
+
+}  // namespace util
+
+#endif  // UTIL_INTERNER_H_
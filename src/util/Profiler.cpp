@@ -0,0 +1,165 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_in_parallel() 0
+#endif
+
+#include <sys/resource.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "util/Profiler.h"
+#include "util/json/Writer.h"
+
+using util::Profiler;
+using util::ProfileEntry;
+
+namespace {
+
+struct Registry {
+  std::mutex m;
+  std::vector<ProfileEntry> entries;
+  std::map<std::string, size_t> idx;
+};
+
+// _____________________________________________________________________________
+Registry& registry() {
+  // never destroyed, scopes may be stopped during static destruction
+  static Registry* r = new Registry();
+  return *r;
+}
+
+// the paths of the currently open scopes of this thread
+thread_local std::vector<std::string> openScopes;
+
+const std::chrono::time_point<std::chrono::steady_clock> START =
+    std::chrono::steady_clock::now();
+}  // namespace
+
+// _____________________________________________________________________________
+Profiler::Scope::Scope(const std::string& name)
+    : _wall(std::chrono::steady_clock::now()),
+      _thread(omp_in_parallel()),
+      _peakRss(peakRssKb()),
+      _ms(0),
+      _stopped(false) {
+  _cpu = cpuMs(_thread);
+  _name = openScopes.empty() ? name : openScopes.back() + "/" + name;
+  openScopes.push_back(_name);
+
+  // register the phase on start, such that outer phases are listed first
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.m);
+  if (r.idx.insert({_name, r.entries.size()}).second) {
+    r.entries.push_back(ProfileEntry{_name, 0, 0, 0, 0, 0});
+  }
+}
+
+// _____________________________________________________________________________
+double Profiler::Scope::stop() {
+  if (_stopped) return _ms;
+  _stopped = true;
+
+  _ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - _wall)
+            .count();
+  double cpu = cpuMs(_thread) - _cpu;
+  size_t rss = peakRssKb();
+
+  if (!openScopes.empty() && openScopes.back() == _name) openScopes.pop_back();
+
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.m);
+  ProfileEntry& e = r.entries[r.idx[_name]];
+  e.calls++;
+  e.wallMs += _ms;
+  e.cpuMs += cpu;
+  e.peakRssKb = rss;
+  e.peakRssGrowthKb += rss - std::min(rss, _peakRss);
+
+  return _ms;
+}
+
+// _____________________________________________________________________________
+Profiler::Nest::Nest(const std::string& parent)
+    : _parent(parent), _opened(!parent.empty() && openScopes.empty()) {
+  if (_opened) openScopes.push_back(_parent);
+}
+
+// _____________________________________________________________________________
+Profiler::Nest::~Nest() {
+  if (_opened && !openScopes.empty() && openScopes.back() == _parent) {
+    openScopes.pop_back();
+  }
+}
+
+// _____________________________________________________________________________
+std::string Profiler::currentPath() {
+  return openScopes.empty() ? "" : openScopes.back();
+}
+
+// _____________________________________________________________________________
+std::vector<ProfileEntry> Profiler::snapshot() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.m);
+  return r.entries;
+}
+
+// _____________________________________________________________________________
+void Profiler::writeJson(std::ostream* out,
+                         const std::map<std::string, std::string>& meta) {
+  util::json::Writer w(out, 3, true);
+  w.obj();
+
+  for (const auto& kv : meta) w.keyVal(kv.first, kv.second);
+
+  w.keyVal("wall_ms", std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - START)
+                          .count());
+  w.keyVal("cpu_ms", cpuMs(false));
+  w.keyVal("peak_rss_kb", static_cast<double>(peakRssKb()));
+
+  w.key("phases");
+  w.arr();
+  for (const auto& e : snapshot()) {
+    w.obj();
+    w.keyVal("name", e.name);
+    w.keyVal("calls", static_cast<double>(e.calls));
+    w.keyVal("wall_ms", e.wallMs);
+    w.keyVal("cpu_ms", e.cpuMs);
+    w.keyVal("peak_rss_kb", static_cast<double>(e.peakRssKb));
+    w.keyVal("peak_rss_growth_kb", static_cast<double>(e.peakRssGrowthKb));
+    w.close();
+  }
+
+  w.closeAll();
+  *out << std::endl;
+}
+
+// _____________________________________________________________________________
+size_t Profiler::peakRssKb() {
+  struct rusage u;
+  if (getrusage(RUSAGE_SELF, &u) != 0) return 0;
+#ifdef __APPLE__
+  // reported in bytes on macOS
+  return u.ru_maxrss / 1024;
+#else
+  return u.ru_maxrss;
+#endif
+}
+
+// _____________________________________________________________________________
+double Profiler::cpuMs(bool thread) {
+  struct timespec t;
+  if (clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID,
+                    &t) != 0)
+    return 0;
+  return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
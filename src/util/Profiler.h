@@ -0,0 +1,97 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_PROFILER_H_
+#define UTIL_PROFILER_H_
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace util {
+
+struct ProfileEntry {
+  // phase name, prefixed with the names of the enclosing phases of the
+  // same thread, separated by "/"
+  std::string name;
+  size_t calls;
+  double wallMs;
+  double cpuMs;
+
+  // peak resident set size of the process after the last call, and the
+  // amount by which the phase raised it
+  size_t peakRssKb;
+  size_t peakRssGrowthKb;
+};
+
+/*
+ * Global phase profiler. Phases are recorded by Scope objects, repeated
+ * phases with the same name are summed up. Outside of parallel regions, the
+ * CPU time of a phase is the CPU time of the whole process, inside of them
+ * the CPU time of the calling thread.
+ */
+class Profiler {
+ public:
+  class Scope {
+   public:
+    explicit Scope(const std::string& name);
+    ~Scope() { stop(); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    // Record the phase, returns its wall time in ms. Only the first call
+    // records anything.
+    double stop();
+
+   private:
+    std::string _name;
+    std::chrono::time_point<std::chrono::steady_clock> _wall;
+    double _cpu;
+    bool _thread;
+    size_t _peakRss;
+    double _ms;
+    bool _stopped;
+  };
+
+  /*
+   * Opens the phase path parent on a thread without open phases, without
+   * recording it. Phases started on worker threads are then nested like
+   * those of the thread which handed them their work.
+   */
+  class Nest {
+   public:
+    explicit Nest(const std::string& parent);
+    ~Nest();
+
+    Nest(const Nest&) = delete;
+    Nest& operator=(const Nest&) = delete;
+
+   private:
+    std::string _parent;
+    bool _opened;
+  };
+
+  // Path of the innermost open phase of the calling thread, empty if none
+  static std::string currentPath();
+
+  // Recorded phases, in the order in which they were first started
+  static std::vector<ProfileEntry> snapshot();
+
+  // Write all recorded phases as JSON, meta is written as additional
+  // top-level string attributes
+  static void writeJson(std::ostream* out,
+                        const std::map<std::string, std::string>& meta);
+
+  // Peak resident set size of the process so far, in kB
+  static size_t peakRssKb();
+
+  // Consumed CPU time of the process or of the calling thread, in ms
+  static double cpuMs(bool thread);
+};
+}  // namespace util
+
+#endif  // UTIL_PROFILER_H_
@@ -0,0 +1,109 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_thread_num() 0
+#endif
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "util/Misc.h"
+#include "util/Profiler.h"
+#include "util/WorkPool.h"
+
+using util::WorkPool;
+using std::chrono::microseconds;
+
+// _____________________________________________________________________________
+WorkPool::WorkPool(size_t numThreads)
+    : _numThreads(std::max<size_t>(1, numThreads)) {}
+
+// _____________________________________________________________________________
+void WorkPool::run(const std::vector<double>& costs,
+                   const std::function<void(size_t)>& f) {
+  std::vector<Queue> qs(_numThreads);
+  for (auto& q : qs) q.load = 0;
+  _stats.assign(_numThreads, WorkerStats{0, 0, 0, 0});
+
+  // longest processing time first: each task goes to the thread with the
+  // lowest estimated load so far, so every queue is sorted by decreasing cost
+  std::vector<size_t> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+    return costs[a] > costs[b];
+  });
+
+  for (size_t i : order) {
+    size_t min = 0;
+    for (size_t j = 1; j < qs.size(); j++) {
+      if (qs[j].load < qs[min].load) min = j;
+    }
+    qs[min].tasks.push_back(i);
+    qs[min].load += costs[i];
+  }
+
+  // phases started by the tasks are nested in the caller's phase on all
+  // threads
+  std::string scope = util::Profiler::currentPath();
+
+#pragma omp parallel num_threads(_numThreads)
+  {
+    util::Profiler::Nest nest(scope);
+    size_t tid = omp_get_thread_num();
+    WorkerStats& stats = _stats[tid];
+    auto t1 = TIME();
+    size_t task;
+
+    while (pop(&qs, tid, costs, &task)) {
+      auto t2 = TIME();
+      f(task);
+      stats.busyMs += TOOK(t2, TIME());
+      stats.tasks++;
+    }
+
+    stats.totMs = TOOK(t1, TIME());
+  }
+}
+
+// _____________________________________________________________________________
+bool WorkPool::pop(std::vector<Queue>* qs, size_t q,
+                   const std::vector<double>& costs, size_t* task) {
+  {
+    std::lock_guard<std::mutex> lock((*qs)[q].m);
+    if (!(*qs)[q].tasks.empty()) {
+      *task = (*qs)[q].tasks.front();
+      (*qs)[q].tasks.pop_front();
+      (*qs)[q].load -= costs[*task];
+      return true;
+    }
+  }
+
+  // own queue is empty, steal from the thread with the most remaining work
+  while (true) {
+    size_t victim = q;
+    double maxLoad = -1;
+    for (size_t i = 0; i < qs->size(); i++) {
+      if (i == q) continue;
+      std::lock_guard<std::mutex> lock((*qs)[i].m);
+      if (!(*qs)[i].tasks.empty() && (*qs)[i].load > maxLoad) {
+        maxLoad = (*qs)[i].load;
+        victim = i;
+      }
+    }
+
+    if (victim == q) return false;
+
+    std::lock_guard<std::mutex> lock((*qs)[victim].m);
+    if ((*qs)[victim].tasks.empty()) continue;
+    *task = (*qs)[victim].tasks.front();
+    (*qs)[victim].tasks.pop_front();
+    (*qs)[victim].load -= costs[*task];
+    _stats[q].steals++;
+    return true;
+  }
+}
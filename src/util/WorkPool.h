@@ -0,0 +1,56 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_WORKPOOL_H_
+#define UTIL_WORKPOOL_H_
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace util {
+
+struct WorkerStats {
+  size_t tasks;
+  size_t steals;
+  double busyMs;
+  double totMs;
+};
+
+/*
+ * Runs a set of tasks with (estimated) costs on a fixed number of OpenMP
+ * threads. Tasks are distributed longest-first onto per-thread queues, such
+ * that the estimated load of all threads is balanced. A thread whose queue
+ * runs empty steals the largest waiting task of the thread with the most
+ * remaining estimated work.
+ */
+class WorkPool {
+ public:
+  explicit WorkPool(size_t numThreads);
+
+  // Call f(i) for each task i in [0, costs.size()), costs[i] is the
+  // estimated cost of task i
+  void run(const std::vector<double>& costs,
+           const std::function<void(size_t)>& f);
+
+  // Per-thread statistics of the last run
+  const std::vector<WorkerStats>& getStats() const { return _stats; }
+
+ private:
+  struct Queue {
+    std::mutex m;
+    std::deque<size_t> tasks;
+    double load;
+  };
+
+  size_t _numThreads;
+  std::vector<WorkerStats> _stats;
+
+  bool pop(std::vector<Queue>* qs, size_t q, const std::vector<double>& costs,
+           size_t* task);
+};
+}  // namespace util
+
+#endif  // UTIL_WORKPOOL_H_
@@ -13,6 +13,8 @@
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 #include "util/Misc.h"
 #include "util/String.h"
 #include "util/geo/Box.h"
@@ -1013,26 +1015,44 @@ inline RotatedBox<T> simplify(const RotatedBox<T>& g, double d) {
 // _____________________________________________________________________________
 template <typename T>
 inline Line<T> simplify(const Line<T>& g, double d) {
-  // douglas peucker
-  double maxd = 0;
-  size_t maxi = 0;
-  for (size_t i = 1; i < g.size() - 1; i++) {
-    double dt = distToSegment(g.front(), g.back(), g[i]);
-    if (dt > maxd) {
-      maxi = i;
-      maxd = dt;
+  // douglas peucker, on index ranges of g to avoid copying sub lines
+  if (g.empty()) return g;
+
+  std::vector<bool> keep(g.size(), false);
+  keep.front() = true;
+  keep.back() = true;
+
+  std::vector<std::pair<size_t, size_t>> ranges{{0, g.size() - 1}};
+  while (!ranges.empty()) {
+    auto r = ranges.back();
+    ranges.pop_back();
+
+    double maxd = 0;
+    size_t maxi = 0;
+    for (size_t i = r.first + 1; i < r.second; i++) {
+      double dt = distToSegment(g[r.first], g[r.second], g[i]);
+      if (dt > maxd) {
+        maxi = i;
+        maxd = dt;
+      }
+    }
+
+    if (maxd > d) {
+      keep[maxi] = true;
+      ranges.push_back({maxi, r.second});
+      ranges.push_back({r.first, maxi});
     }
   }
 
-  if (maxd > d) {
-    auto a = simplify(Line<T>(g.begin(), g.begin() + maxi + 1), d);
-    const auto& b = simplify(Line<T>(g.begin() + maxi, g.end()), d);
-    a.insert(a.end(), b.begin() + 1, b.end());
+  // a single point is returned twice, as a line always has two end points
+  if (g.size() == 1) return Line<T>{g.front(), g.back()};
 
-    return a;
+  Line<T> ret;
+  for (size_t i = 0; i < g.size(); i++) {
+    if (keep[i]) ret.push_back(g[i]);
   }
 
-  return Line<T>{g.front(), g.back()};
+  return ret;
 }
 
 // _____________________________________________________________________________
@@ -1536,44 +1556,147 @@ inline double frechetDistC(size_t i, size_t j, const Line<T>& p,
 
 // _____________________________________________________________________________
 template <typename T>
-inline double frechetDist(const Line<T>& a, const Line<T>& b, double d) {
+inline void frechetRowDists(const Point<T>& p, const std::vector<double>& qx,
+                            const std::vector<double>& qy, size_t lo,
+                            size_t hi, double* ret) {
+  // independent per column, kept branch free so it can be vectorized
+  double px = p.getX(), py = p.getY();
+  for (size_t j = lo; j < hi; j++) {
+    double dx = qx[j] - px, dy = qy[j] - py;
+    ret[j] = sqrt(dx * dx + dy * dy);
+  }
+}
+
+// _____________________________________________________________________________
+template <typename T>
+inline double frechetDist(const Line<T>& a, const Line<T>& b, double d,
+                          double maxD) {
   // based on Eiter / Mannila
   // http://www.kr.tuwien.ac.at/staff/eiter/et-archive/cdtr9464.pdf
+  // only the previous and the current row of the matrix are kept. Every
+  // coupling passes through each row, so once a row's minimum exceeds maxD
+  // the result does, too.
 
   auto p = densify(a, d);
   auto q = densify(b, d);
+  if (!p.size() || !q.size()) return std::numeric_limits<double>::infinity();
+
+  std::vector<double> qx(q.size()), qy(q.size());
+  for (size_t j = 0; j < q.size(); j++) {
+    qx[j] = q[j].getX();
+    qy[j] = q[j].getY();
+  }
+
+  std::vector<double> prev(q.size()), cur(q.size()), dists(q.size());
+
+  frechetRowDists(p[0], qx, qy, 0, q.size(), &dists[0]);
+  prev[0] = dists[0];
+  double rowMin = prev[0];
+  for (size_t j = 1; j < q.size(); j++) {
+    prev[j] = std::max(prev[j - 1], dists[j]);
+  }
 
-  std::vector<std::vector<double>> ca(p.size(),
-                                      std::vector<double>(q.size(), -1.0));
-  double fd = frechetDistC(p.size() - 1, q.size() - 1, p, q, ca);
+  for (size_t i = 1; i < p.size(); i++) {
+    if (rowMin > maxD) return std::numeric_limits<double>::infinity();
 
-  return fd;
+    frechetRowDists(p[i], qx, qy, 0, q.size(), &dists[0]);
+    cur[0] = std::max(prev[0], dists[0]);
+    rowMin = cur[0];
+    for (size_t j = 1; j < q.size(); j++) {
+      cur[j] = std::max(std::min(std::min(prev[j], prev[j - 1]), cur[j - 1]),
+                        dists[j]);
+      rowMin = std::min(rowMin, cur[j]);
+    }
+    std::swap(prev, cur);
+  }
+
+  return prev.back();
 }
 
 // _____________________________________________________________________________
 template <typename T>
-inline double accFrechetDistC(const Line<T>& a, const Line<T>& b, double d) {
+inline double frechetDist(const Line<T>& a, const Line<T>& b, double d) {
+  return frechetDist(a, b, d, std::numeric_limits<double>::infinity());
+}
+
+// _____________________________________________________________________________
+template <typename T>
+inline double accFrechetDistCBand(const Line<T>& a, const Line<T>& b,
+                                  double d, size_t band, double maxD) {
+  // accumulated distance along the best coupling, each point of a weighted
+  // by the length of its segment. Only two rows of the matrix are kept, and
+  // in each row only the columns within band of the diagonal are computed.
   auto p = densify(a, d);
   auto q = densify(b, d);
+  const double inf = std::numeric_limits<double>::infinity();
+  if (!p.size() || !q.size()) return inf;
+
+  std::vector<double> qx(q.size()), qy(q.size());
+  for (size_t j = 0; j < q.size(); j++) {
+    qx[j] = q[j].getX();
+    qy[j] = q[j].getY();
+  }
 
-  std::vector<std::vector<double>> ca(p.size(),
-                                      std::vector<double>(q.size(), 0));
+  if (p.size() == 1) return q.size() == 1 ? 0 : inf;
 
-  for (size_t i = 0; i < p.size(); i++)
-    ca[i][0] = std::numeric_limits<double>::infinity();
-  for (size_t j = 0; j < q.size(); j++)
-    ca[0][j] = std::numeric_limits<double>::infinity();
-  ca[0][0] = 0;
+  std::vector<double> prev(q.size(), inf), cur(q.size(), inf);
+  std::vector<double> dists(q.size()), mins(q.size());
+  prev[0] = 0;
+
+  // the finite columns [lo, hi) of the rows in prev and cur, everything
+  // else is infinite
+  size_t prevLo = 0, prevHi = 1, curLo = 0, curHi = 0;
+  double slope = (q.size() - 1.0) / (p.size() - 1.0);
 
   for (size_t i = 1; i < p.size(); i++) {
-    for (size_t j = 1; j < q.size(); j++) {
-      double d = util::geo::dist(p[i], q[j]) * util::geo::dist(p[i], p[i - 1]);
-      ca[i][j] =
-          d + std::min(ca[i - 1][j], std::min(ca[i][j - 1], ca[i - 1][j - 1]));
+    double diag = i * slope;
+    size_t lo = diag > band ? static_cast<size_t>(diag - band) : 0;
+    size_t hi = std::min<double>(q.size(), diag + band + 1);
+    if (i == p.size() - 1) hi = q.size();
+    // stay connected to the previous row, column 0 is always infinite
+    lo = std::max<size_t>(std::min(lo, prevHi), 1);
+    hi = std::max(hi, lo);
+
+    std::fill(cur.begin() + curLo, cur.begin() + curHi, inf);
+
+    double w = dist(p[i], p[i - 1]);
+    frechetRowDists(p[i], qx, qy, lo, hi, &dists[0]);
+    for (size_t j = lo; j < hi; j++) {
+      dists[j] *= w;
+      mins[j] = std::min(prev[j], prev[j - 1]);
     }
+
+    double rowMin = inf;
+    for (size_t j = lo; j < hi; j++) {
+      cur[j] = dists[j] + std::min(mins[j], cur[j - 1]);
+      rowMin = std::min(rowMin, cur[j]);
+    }
+
+    // all costs are positive and every coupling passes through this row
+    if (rowMin > maxD) return inf;
+
+    std::swap(prev, cur);
+    curLo = prevLo;
+    curHi = prevHi;
+    prevLo = lo;
+    prevHi = hi;
   }
 
-  return ca[p.size() - 1][q.size() - 1];
+  return prev.back();
+}
+
+// _____________________________________________________________________________
+template <typename T>
+inline double accFrechetDistC(const Line<T>& a, const Line<T>& b, double d,
+                              double maxD) {
+  return accFrechetDistCBand(a, b, d, std::numeric_limits<size_t>::max() / 2,
+                             maxD);
+}
+
+// _____________________________________________________________________________
+template <typename T>
+inline double accFrechetDistC(const Line<T>& a, const Line<T>& b, double d) {
+  return accFrechetDistC(a, b, d, std::numeric_limits<double>::infinity());
 }
 
 // _____________________________________________________________________________
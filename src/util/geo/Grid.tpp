@@ -57,6 +57,9 @@ Grid<V, G, T>::Grid(double w, double h, const Box<T>& bbox, bool bValIdx)
 // _____________________________________________________________________________
 template <typename V, template <typename> class G, typename T>
 void Grid<V, G, T>::add(G<T> geom, V val) {
+  // the value may re-use the address of a removed one
+  if (!_hasValIdx) _removed.erase(val);
+
   Box<T> box = getBoundingBox(geom);
   size_t swX = getCellXFromX(box.getLowerLeft().getX());
   size_t swY = getCellYFromY(box.getLowerLeft().getY());
@@ -4,4 +4,6 @@
 
 #include "util/graph/Dijkstra.h"
 
-size_t util::graph::Dijkstra::ITERS = 0;
+util::Counter util::graph::Dijkstra::ITERS(
+    "dijkstra_iterations",
+    "Labels settled by node-based shortest path searches");
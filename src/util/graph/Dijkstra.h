@@ -11,6 +11,7 @@
 #include <set>
 #include <set>
 #include <unordered_map>
+#include "util/Counter.h"
 #include "util/graph/Edge.h"
 #include "util/graph/Graph.h"
 #include "util/graph/Node.h"
@@ -103,7 +104,7 @@ class Dijkstra : public ShortestPath<Dijkstra> {
   static void buildPath(Node<N, E>* curN, Settled<N, E, C>& settled,
                         NList<N, E>* resNodes, EList<N, E>* resEdges);
 
-  static size_t ITERS;
+  static util::Counter ITERS;
 };
 
 #include "util/graph/Dijkstra.tpp"
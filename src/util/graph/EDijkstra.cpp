@@ -4,4 +4,6 @@
 
 #include "util/graph/EDijkstra.h"
 
-size_t util::graph::EDijkstra::ITERS = 0;
+util::Counter util::graph::EDijkstra::ITERS(
+    "edijkstra_iterations",
+    "Labels settled by edge-based shortest path searches");
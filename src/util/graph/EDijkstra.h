@@ -10,6 +10,7 @@
 #include <queue>
 #include <set>
 #include <unordered_map>
+#include "util/Counter.h"
 #include "util/graph/Edge.h"
 #include "util/graph/Graph.h"
 #include "util/graph/Node.h"
@@ -129,7 +130,7 @@ class EDijkstra : public ShortestPath<EDijkstra> {
                       const ShortestPath::CostFunc<N, E, C>& costFunc,
                       PQ<N, E, C>& pq);
 
-  static size_t ITERS;
+  static util::Counter ITERS;
 };
 
 #include "util/graph/EDijkstra.tpp"
@@ -2,10 +2,16 @@
 // Author: Patrick Brosi
 //
 
+#include <sstream>
 #include <string>
+#include "pfaedle/trgraph/Normalizer.h"
+#include "util/Counter.h"
+#include "util/Interner.h"
 #include "util/Misc.h"
 #include "util/Nullable.h"
+#include "util/Profiler.h"
 #include "util/String.h"
+#include "util/WorkPool.h"
 #include "util/geo/Geo.h"
 #include "util/geo/Grid.h"
 #include "util/graph/Algorithm.h"
@@ -62,6 +68,194 @@ int main(int argc, char** argv) {
 	UNUSED(argc);
 	UNUSED(argv);
 
+  // ___________________________________________________________________________
+  {
+    std::vector<double> costs;
+    for (size_t i = 0; i < 1000; i++) costs.push_back((i * 7919) % 100);
+
+    std::vector<size_t> runs(costs.size(), 0);
+    util::WorkPool pool(4);
+    pool.run(costs, [&runs](size_t i) {
+#pragma omp atomic
+      runs[i]++;
+    });
+
+    for (auto r : runs) assert(r == 1);
+
+    size_t tasks = 0;
+    for (const auto& st : pool.getStats()) tasks += st.tasks;
+    assert(tasks == costs.size());
+    assert(pool.getStats().size() == 4);
+
+    pool.run(std::vector<double>(), [](size_t i) { UNUSED(i); assert(false); });
+    for (const auto& st : pool.getStats()) assert(st.tasks == 0);
+  }
+
+  // ___________________________________________________________________________
+  {
+    util::Counter a("test_cnt", "a test counter");
+    util::Counter b("test_cnt", "a test counter");
+    util::Counter unnamed;
+
+#pragma omp parallel for num_threads(8)
+    for (size_t i = 0; i < 10000; i++) {
+      a++;
+      unnamed += 2;
+    }
+    b += 5;
+
+    assert(a.get() == 10000);
+    assert(unnamed.get() == 20000);
+
+    auto& l = util::Counter::named("test_lbl", "labeled", "phase", "x");
+    assert(&l == &util::Counter::named("test_lbl", "labeled", "phase", "x"));
+    assert(&l != &util::Counter::named("test_lbl", "labeled", "phase", "y"));
+    l += 3;
+
+    size_t found = 0;
+    for (const auto& c : util::Counter::snapshot()) {
+      if (c.first == "test_cnt") {
+        assert(c.second == 10005);
+        found++;
+      }
+      if (c.first == "test_lbl{phase=x}") {
+        assert(c.second == 3);
+        found++;
+      }
+    }
+    assert(found == 2);
+
+    // a name used both with and without a label gives one JSON key
+    util::Counter mixed("test_mix", "mixed");
+    mixed += 2;
+    util::Counter::named("test_mix", "mixed", "phase", "x") += 4;
+
+    std::stringstream json;
+    util::Counter::writeJson(&json);
+    assert(json.str().find("\"test_cnt\": 10005") != std::string::npos);
+    assert(json.str().find("\"test_mix\"") ==
+           json.str().rfind("\"test_mix\""));
+    assert(json.str().find("\"test_mix\": {") != std::string::npos);
+    assert(json.str().find("\"\": 2") != std::string::npos);
+    assert(json.str().find("\"test_lbl\": {") != std::string::npos);
+    assert(json.str().find("\"x\": 3") != std::string::npos);
+
+    std::stringstream prom;
+    util::Counter::writePrometheus(&prom, "pf_");
+    assert(prom.str().find("# TYPE pf_test_cnt counter\n") !=
+           std::string::npos);
+    assert(prom.str().find("pf_test_cnt 10005\n") != std::string::npos);
+    assert(prom.str().find("pf_test_lbl{phase=\"x\"} 3\n") !=
+           std::string::npos);
+  }
+
+  // ___________________________________________________________________________
+  {
+    for (size_t i = 0; i < 2; i++) {
+      util::Profiler::Scope outer("test_outer");
+      {
+        util::Profiler::Scope inner("inner");
+        std::vector<char> buf(1 << 20, 1);
+        assert(inner.stop() >= 0);
+        assert(inner.stop() >= 0);
+      }
+    }
+
+    size_t found = 0;
+    for (const auto& e : util::Profiler::snapshot()) {
+      if (e.name == "test_outer") {
+        assert(found == 0);
+        assert(e.calls == 2);
+        found++;
+      }
+      if (e.name == "test_outer/inner") {
+        assert(found == 1);
+        assert(e.calls == 2);
+        assert(e.wallMs >= 0);
+        assert(e.peakRssKb > 0);
+        found++;
+      }
+    }
+    assert(found == 2);
+
+    {
+      // phases of worker threads are nested in the caller's phase
+      util::Profiler::Scope outer("test_pool");
+      util::WorkPool pool(4);
+      pool.run(std::vector<double>(64, 1), [](size_t i) {
+        UNUSED(i);
+        util::Profiler::Scope task("task");
+      });
+    }
+
+    bool nested = false;
+    for (const auto& e : util::Profiler::snapshot()) {
+      assert(e.name != "task");
+      if (e.name == "test_pool/task") nested = e.calls == 64;
+    }
+    assert(nested);
+    assert(util::Profiler::currentPath().empty());
+
+    std::stringstream json;
+    util::Profiler::writeJson(&json, {{"version", "test"}});
+    assert(json.str().find("\"version\": \"test\"") != std::string::npos);
+    assert(json.str().find("\"name\": \"test_outer/inner\"") !=
+           std::string::npos);
+  }
+
+  // ___________________________________________________________________________
+  {
+    using pfaedle::trgraph::Normalizer;
+    using pfaedle::trgraph::ReplRules;
+
+    assert(Normalizer::getNeedle("\\bstr\\.?\\b") == "str");
+    assert(Normalizer::getNeedle("\\x41bc") == "");
+    assert(Normalizer::getNeedle("\\u0041bc") == "");
+    assert(Normalizer::getNeedle("\\cJab") == "");
+    assert(Normalizer::getNeedle("ab\\cJ") == "");
+    assert(Normalizer::getNeedle("(a)\\1bcd") == "bcd");
+
+    assert(Normalizer(ReplRules{{"\\x41bc", "X"}}).norm("Abc") == "x");
+    assert(Normalizer(ReplRules{{"\\u0041bc", "X"}}).norm("Abc") == "x");
+    assert(Normalizer(ReplRules{{"str\\.", "strasse"}}).norm("Hauptstr.") ==
+           "hauptstrasse");
+  }
+
+  // ___________________________________________________________________________
+  {
+    util::Interner in;
+    assert(in.size() == 1);
+    assert(in.get(0) == "");
+    uint32_t a = in.intern("hauptbahnhof");
+    uint32_t b = in.intern("markt");
+    assert(a != b);
+    assert(in.intern("hauptbahnhof") == a);
+    assert(in.get(a) == "hauptbahnhof");
+    assert(in.get(b) == "markt");
+
+    // ids stay valid across block boundaries
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < 70000; i++) {
+      ids.push_back(in.intern(std::to_string(i)));
+    }
+    assert(in.size() == 70003);
+    assert(in.get(ids[12]) == "12");
+    assert(in.get(ids[69999]) == "69999");
+    assert(in.get(a) == "hauptbahnhof");
+
+    util::Sym s("gleis 1"), t(std::string("gleis 1")), u;
+    assert(s == t);
+    assert(s.id() == t.id());
+    assert(u.empty() && u.id() == 0 && u.str() == "");
+    assert(!s.empty() && s.size() == 7);
+    assert(util::Sym("a") < util::Sym("b"));
+    assert(!(util::Sym("b") < util::Sym("a")));
+    assert(!(s < t));
+    std::stringstream ss;
+    ss << s;
+    assert(ss.str() == "gleis 1");
+  }
+
   // ___________________________________________________________________________
   {
     assert(util::atof("45.534215") == approx(45.534215));
@@ -239,6 +433,21 @@ int main(int argc, char** argv) {
     g.getNeighbors(1, 0.55, &ret);
     assert(ret.size() == (size_t)2);
 
+    // without a value index, a removed value must be found again once it is
+    // re-added
+    Grid<int, Line, double> h(
+        .5, .5, Box<double>(Point<double>(0, 0), Point<double>(3, 3)), false);
+    h.add(l, 1);
+    h.remove(1);
+    ret.clear();
+    h.get(req, &ret);
+    assert(ret.size() == (size_t)0);
+
+    h.add(l2, 1);
+    ret.clear();
+    h.get(Box<double>(Point<double>(2, 1), Point<double>(3, 2)), &ret);
+    assert(ret.size() == (size_t)1);
+
     // TODO: more test cases
   }
 
@@ -268,6 +477,23 @@ int main(int argc, char** argv) {
 
     dense = util::geo::simplify(dense, 0.1);
     assert(dense.size() == (size_t)3);
+
+    Line<double> c;
+    c.push_back(Point<double>(0, 0));
+    c.push_back(Point<double>(1, 0.05));
+    c.push_back(Point<double>(2, 0));
+    c.push_back(Point<double>(3, 5));
+    c.push_back(Point<double>(4, 0));
+
+    auto simple = util::geo::simplify(c, 0.1);
+    assert(simple.size() == (size_t)4);
+    assert(simple[1].getX() == approx(2));
+    assert(simple[2].getX() == approx(3));
+    assert(simple[3].getX() == approx(4));
+
+    Line<double> d;
+    d.push_back(Point<double>(1, 1));
+    assert(util::geo::simplify(d, 0.1).size() == (size_t)2);
   }
 
   // ___________________________________________________________________________
@@ -292,6 +518,21 @@ int main(int argc, char** argv) {
 
     double fd = util::geo::accFrechetDistC(a, b, 0.1);
     assert(fd == approx(2));
+
+    // early exit once the bound is exceeded
+    assert(util::geo::accFrechetDistC(a, b, 0.1, 3) == approx(2));
+    assert(util::geo::accFrechetDistC(a, b, 0.1, 1) ==
+           std::numeric_limits<double>::infinity());
+
+    // a band wide enough for the detour gives the exact result, a narrower
+    // one never a smaller one
+    assert(util::geo::accFrechetDistCBand(a, b, 0.1, 20, 100) == approx(2));
+    assert(util::geo::accFrechetDistCBand(a, b, 0.1, 1, 100) >= fd - 0.0001);
+
+    assert(util::geo::frechetDist(a, b, 0.1) == approx(1));
+    assert(util::geo::frechetDist(a, b, 0.1, 2) == approx(1));
+    assert(util::geo::frechetDist(a, b, 0.1, 0.5) ==
+           std::numeric_limits<double>::infinity());
   }
 
   // ___________________________________________________________________________